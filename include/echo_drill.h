@@ -0,0 +1,225 @@
+#pragma once
+// Echo drill: one random character is played, the operator keys it back, and
+// the time from the end of its last tone to the first key-down of the answer
+// is the recognition latency. Both ends are edge timestamps in ms (the
+// scheduled tone edge and the debounced press), so loop and display time do
+// not show up in the result.
+//
+// Per character a 16-bin latency histogram with counts, best and worst and a
+// moving average, all fixed (EchoCharStats, 45 bytes on the wire). The
+// moving average drives the next pick: a character is drawn in proportion to
+// it, so slow ones come back more often, and misses pull it toward
+// ECHO_MISS_MS. Untried characters weigh as much as the slowest one (at
+// least half a miss), so each gets tried early.
+//
+// The character set is the Koch order (koch_trainer.h), all of it or the
+// first n.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "koch_trainer.h"
+#include "session_log.h"
+#include "train_rng.h"
+
+const size_t ECHO_CHARS = KOCH_CHARS;
+const size_t ECHO_BINS = 16;
+// Lower bin edges in ms; the last bin is open-ended
+const uint16_t ECHO_BIN_MS[ECHO_BINS] = {0, 150, 200, 250, 300, 350, 400, 450, 500, 600, 700, 800, 1000, 1250, 1500, 2000};
+const uint16_t ECHO_MISS_MS = 3000;    // a miss counts as this slow in the average
+const uint16_t ECHO_AVG_FLOOR_MS = 50; // keeps a fast character in the draw
+const size_t ECHO_RECORD_SIZE = 1 + 6 * 2 + ECHO_BINS * 2;
+
+struct EchoCharStats
+{
+  uint16_t tries;
+  uint16_t correct;
+  uint16_t misses; // wrong letter or no answer
+  uint16_t avgMs;  // moving average (1/4 per try), misses as ECHO_MISS_MS; 0 = untried
+  uint16_t minMs;  // over correct answers
+  uint16_t maxMs;
+  uint16_t bins[ECHO_BINS];
+};
+
+inline size_t echoBin(uint32_t ms)
+{
+  size_t b = ECHO_BINS - 1;
+  while (b > 0 && ms < ECHO_BIN_MS[b])
+    b--;
+  return b;
+}
+
+// ================= Export =================
+// One record: u8 character, u16 tries / correct / misses / avg / min / max,
+// u16 bins[ECHO_BINS], little-endian
+inline size_t echoEncodeStats(char c, const EchoCharStats &s, uint8_t *out)
+{
+  out[0] = (uint8_t)c;
+  const uint16_t head[6] = {s.tries, s.correct, s.misses, s.avgMs, s.minMs, s.maxMs};
+  for (size_t i = 0; i < 6; i++)
+    logPut16(out + 1 + 2 * i, head[i]);
+  for (size_t i = 0; i < ECHO_BINS; i++)
+    logPut16(out + 13 + 2 * i, s.bins[i]);
+  return ECHO_RECORD_SIZE;
+}
+
+inline bool echoDecodeStats(const uint8_t *p, size_t len, char &c, EchoCharStats &s)
+{
+  if (len < ECHO_RECORD_SIZE)
+    return false;
+  c = (char)p[0];
+  s.tries = logGet16(p + 1);
+  s.correct = logGet16(p + 3);
+  s.misses = logGet16(p + 5);
+  s.avgMs = logGet16(p + 7);
+  s.minMs = logGet16(p + 9);
+  s.maxMs = logGet16(p + 11);
+  for (size_t i = 0; i < ECHO_BINS; i++)
+    s.bins[i] = logGet16(p + 13 + 2 * i);
+  return true;
+}
+
+enum EchoState : uint8_t
+{
+  ECHO_IDLE,    // nothing asked
+  ECHO_SENDING, // next() is being played
+  ECHO_ANSWER,  // waiting for it to be keyed back
+};
+
+class EchoDrill
+{
+public:
+  EchoDrill() { reset(); }
+
+  void reset()
+  {
+    memset(stats_, 0, sizeof(stats_));
+    state_ = ECHO_IDLE;
+  }
+
+  // Drill the first `count` characters (0 or too many = all)
+  void start(uint32_t seed, size_t count)
+  {
+    rng_.seed(seed);
+    count_ = count == 0 || count > ECHO_CHARS ? ECHO_CHARS : count;
+    state_ = ECHO_IDLE;
+  }
+
+  // Pick the next character, weighted by average latency
+  char next()
+  {
+    uint16_t slowest = ECHO_MISS_MS / 2;
+    for (size_t i = 0; i < count_; i++)
+      if (stats_[i].avgMs > slowest)
+        slowest = stats_[i].avgMs;
+    uint32_t total = 0;
+    for (size_t i = 0; i < count_; i++)
+      total += weight(i, slowest);
+    uint32_t r = rng_.below(total);
+    size_t i = 0;
+    while (r >= weight(i, slowest))
+      r -= weight(i++, slowest);
+    target_ = i;
+    state_ = ECHO_SENDING;
+    return KOCH_ORDER[i];
+  }
+
+  // The character has been played; toneEndMs is the end of its last tone
+  void played(uint32_t toneEndMs)
+  {
+    state_ = ECHO_ANSWER;
+    refMs_ = toneEndMs;
+    pressMs_ = 0;
+    pressed_ = false;
+  }
+
+  // DOT/DASH press while answering: the first one is the reaction
+  void keyDown(uint32_t now)
+  {
+    if (state_ != ECHO_ANSWER || pressed_)
+      return;
+    pressed_ = true;
+    pressMs_ = now;
+  }
+
+  bool pressed() const { return pressed_; }
+
+  // The letter the answer committed to; scores the try
+  void letter(char c)
+  {
+    if (state_ != ECHO_ANSWER)
+      return;
+    answer_ = c;
+    if (c == KOCH_ORDER[target_] && pressed_)
+    {
+      int32_t ms = (int32_t)(pressMs_ - refMs_);
+      score(true, ms < 0 ? 0u : (uint32_t)ms); // keyed over the end of the tone
+    }
+    else
+      score(false, 0);
+  }
+
+  // No answer in time
+  void timeout()
+  {
+    if (state_ != ECHO_ANSWER)
+      return;
+    answer_ = '\0';
+    score(false, 0);
+  }
+
+  EchoState state() const { return state_; }
+  char target() const { return KOCH_ORDER[target_]; }
+  char answer() const { return answer_; }
+  bool lastCorrect() const { return lastCorrect_; }
+  uint32_t lastMs() const { return lastMs_; }
+  uint32_t answerStartMs() const { return refMs_; }
+  size_t count() const { return count_; }
+  const EchoCharStats &stats(size_t i) const { return stats_[i]; }
+
+private:
+  uint32_t weight(size_t i, uint16_t slowest) const
+  {
+    uint16_t avg = stats_[i].avgMs;
+    return avg == 0 ? slowest : avg < ECHO_AVG_FLOOR_MS ? ECHO_AVG_FLOOR_MS : avg;
+  }
+
+  void score(bool correct, uint32_t ms)
+  {
+    EchoCharStats &s = stats_[target_];
+    uint16_t v = ECHO_MISS_MS;
+    s.tries++;
+    lastCorrect_ = correct;
+    lastMs_ = ms;
+    if (correct)
+    {
+      v = ms < 0xFFFF ? (uint16_t)ms : 0xFFFF;
+      s.correct++;
+      s.bins[echoBin(ms)]++;
+      if (s.correct == 1 || v < s.minMs)
+        s.minMs = v;
+      if (v > s.maxMs)
+        s.maxMs = v;
+    }
+    else
+      s.misses++;
+    s.avgMs = s.avgMs == 0 ? v : (uint16_t)(s.avgMs + ((int32_t)v - s.avgMs) / 4);
+    if (s.avgMs == 0)
+      s.avgMs = 1; // 0 means untried
+    state_ = ECHO_IDLE;
+  }
+
+  EchoCharStats stats_[ECHO_CHARS];
+  TrainRng rng_;
+  size_t count_ = ECHO_CHARS;
+  EchoState state_ = ECHO_IDLE;
+  size_t target_ = 0;
+  uint32_t refMs_ = 0;
+  uint32_t pressMs_ = 0;
+  bool pressed_ = false;
+  char answer_ = '\0';
+  bool lastCorrect_ = false;
+  uint32_t lastMs_ = 0;
+};
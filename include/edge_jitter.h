@@ -0,0 +1,99 @@
+#pragma once
+// Edge-timing jitter: how late each playback tone edge reaches the buzzer
+// compared with the ideal Morse timeline. The keyer schedules every stage at
+// an exact millisecond (previous start + duration); the device records the
+// microsecond clock when the edge is actually driven. Lateness goes into a
+// fixed-bin histogram from which percentiles are read, so recording never
+// allocates and costs a few instructions per edge.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+
+const size_t EDGE_JITTER_BINS = 64;      // plus one overflow bin
+const uint32_t EDGE_JITTER_BIN_US = 250; // 0..16 ms in 250 us steps by default
+
+class EdgeJitter
+{
+public:
+  // binUs = width of one histogram bin; everything past BINS*binUs lands in
+  // the overflow bin (max() still reports the real value)
+  void configure(uint32_t binUs)
+  {
+    binUs_ = binUs ? binUs : 1;
+    reset();
+  }
+
+  void reset()
+  {
+    for (size_t i = 0; i <= EDGE_JITTER_BINS; i++)
+      bins_[i] = 0;
+    count_ = early_ = 0;
+    sumUs_ = 0;
+    minUs_ = INT32_MAX;
+    maxUs_ = INT32_MIN;
+  }
+
+  // scheduledMs = ideal edge time (millis()), actualUs = when it was driven
+  // (micros() of the same clock). Both wrap, but their difference mod 2^32
+  // is still right. A schedule in whole ms means an edge driven within that
+  // millisecond reads 0..999 us; early edges are counted apart and binned as 0.
+  void record(uint32_t scheduledMs, uint32_t actualUs) { recordUs((int32_t)(actualUs - scheduledMs * 1000u)); }
+
+  void recordUs(int32_t lateUs)
+  {
+    if (lateUs < minUs_)
+      minUs_ = lateUs;
+    if (lateUs > maxUs_)
+      maxUs_ = lateUs;
+    sumUs_ += lateUs;
+    count_++;
+    if (lateUs < 0)
+    {
+      early_++;
+      lateUs = 0;
+    }
+    size_t b = (uint32_t)lateUs / binUs_;
+    bins_[b < EDGE_JITTER_BINS ? b : EDGE_JITTER_BINS]++;
+  }
+
+  // Upper edge of the bin holding the p-th percentile (0..100), in us; the
+  // observed maximum when that lands in the overflow bin. 0 with no samples.
+  int32_t percentileUs(uint8_t p) const
+  {
+    if (count_ == 0)
+      return 0;
+    uint32_t rank = (uint32_t)(((uint64_t)count_ * p + 99) / 100); // 1-based
+    if (rank == 0)
+      rank = 1;
+    uint32_t seen = 0;
+    for (size_t i = 0; i < EDGE_JITTER_BINS; i++)
+    {
+      seen += bins_[i];
+      if (seen >= rank)
+      {
+        int32_t upper = (int32_t)((i + 1) * binUs_);
+        return upper < maxUs_ ? upper : maxUs_;
+      }
+    }
+    return maxUs_;
+  }
+
+  uint32_t count() const { return count_; }
+  uint32_t early() const { return early_; }
+  int32_t minUs() const { return count_ ? minUs_ : 0; }
+  int32_t maxUs() const { return count_ ? maxUs_ : 0; }
+  int32_t meanUs() const { return count_ ? (int32_t)(sumUs_ / (int64_t)count_) : 0; }
+  uint32_t binUs() const { return binUs_; }
+  uint32_t bin(size_t i) const { return i <= EDGE_JITTER_BINS ? bins_[i] : 0; } // [BINS] = overflow
+
+private:
+  uint32_t binUs_ = EDGE_JITTER_BIN_US;
+  uint32_t bins_[EDGE_JITTER_BINS + 1] = {};
+  uint32_t count_ = 0;
+  uint32_t early_ = 0;
+  int64_t sumUs_ = 0;
+  int32_t minUs_ = INT32_MAX;
+  int32_t maxUs_ = INT32_MIN;
+};
@@ -0,0 +1,327 @@
+#pragma once
+// Multi-channel CW receiver: a bank of Goertzel bins spread across a pitch
+// range, each bin followed by its own timing classifier and letter decoder.
+//
+// Portable (no Arduino dependencies). The filter state is kept as
+// structure-of-arrays so the per-sample update is one straight loop over bins:
+// GCC vectorizes it on the host, and SSE/NEON builds take an explicit 4-wide
+// path. On the ESP32 it runs scalar, so cost grows linearly with bin count.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "morse_trie.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define GOERTZEL_SIMD_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GOERTZEL_SIMD_NEON 1
+#endif
+
+// ================= Goertzel filter bank =================
+// MaxBins is rounded up to a multiple of 4 so the SIMD path never needs a tail.
+// Each block is Hann-windowed so a strong station does not leak into the
+// sidelobe bins of its neighbours.
+template <size_t MaxBins>
+class GoertzelBank
+{
+public:
+  static const size_t CAPACITY = (MaxBins + 3) & ~(size_t)3;
+  static const size_t MAX_BLOCK = 512;
+
+  // Spread `bins` centre frequencies linearly over [lowHz, highHz].
+  // `blockLen` samples make one detection block (bin width = rate / blockLen).
+  void configure(float sampleRate, float lowHz, float highHz, size_t bins, size_t blockLen)
+  {
+    if (bins == 0)
+      bins = 1;
+    if (bins > MaxBins)
+      bins = MaxBins;
+    nBins_ = bins;
+    nPadded_ = (bins + 3) & ~(size_t)3;
+    blockLen_ = blockLen == 0 ? 1 : (blockLen > MAX_BLOCK ? MAX_BLOCK : blockLen);
+    for (size_t i = 0; i < blockLen_; i++)
+      window_[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * (float)i / (float)blockLen_);
+    float step = bins > 1 ? (highHz - lowHz) / (float)(bins - 1) : 0.0f;
+    for (size_t b = 0; b < CAPACITY; b++)
+    {
+      if (b < bins)
+      {
+        freq_[b] = lowHz + step * (float)b;
+        coeff_[b] = 2.0f * cosf(2.0f * (float)M_PI * freq_[b] / sampleRate);
+      }
+      else
+      {
+        freq_[b] = 0.0f;
+        coeff_[b] = 0.0f; // padding lanes: harmless, never reported
+      }
+    }
+    reset();
+  }
+
+  void reset()
+  {
+    for (size_t b = 0; b < CAPACITY; b++)
+    {
+      s1_[b] = 0.0f;
+      s2_[b] = 0.0f;
+      power_[b] = 0.0f;
+    }
+    filled_ = 0;
+  }
+
+  // Push samples; calls onBlock(power, nBins) each time a block completes.
+  // Returns the number of completed blocks.
+  template <typename OnBlock>
+  size_t process(const float *x, size_t n, OnBlock onBlock)
+  {
+    size_t blocks = 0;
+    while (n > 0)
+    {
+      size_t take = blockLen_ - filled_;
+      if (take > n)
+        take = n;
+      accumulate(x, &window_[filled_], take);
+      x += take;
+      n -= take;
+      filled_ += take;
+      if (filled_ == blockLen_)
+      {
+        finishBlock();
+        onBlock(power_, nBins_);
+        blocks++;
+      }
+    }
+    return blocks;
+  }
+
+  size_t bins() const { return nBins_; }
+  float binHz(size_t b) const { return freq_[b]; }
+
+private:
+  void accumulate(const float *x, const float *w, size_t n)
+  {
+    const size_t nb = nPadded_;
+#if defined(GOERTZEL_SIMD_SSE)
+    for (size_t i = 0; i < n; i++)
+    {
+      const __m128 v = _mm_set1_ps(x[i] * w[i]);
+      for (size_t b = 0; b < nb; b += 4)
+      {
+        __m128 s1 = _mm_load_ps(&s1_[b]);
+        __m128 s0 = _mm_sub_ps(_mm_add_ps(v, _mm_mul_ps(_mm_load_ps(&coeff_[b]), s1)), _mm_load_ps(&s2_[b]));
+        _mm_store_ps(&s2_[b], s1);
+        _mm_store_ps(&s1_[b], s0);
+      }
+    }
+#elif defined(GOERTZEL_SIMD_NEON)
+    for (size_t i = 0; i < n; i++)
+    {
+      const float32x4_t v = vdupq_n_f32(x[i] * w[i]);
+      for (size_t b = 0; b < nb; b += 4)
+      {
+        float32x4_t s1 = vld1q_f32(&s1_[b]);
+        float32x4_t s0 = vsubq_f32(vmlaq_f32(v, vld1q_f32(&coeff_[b]), s1), vld1q_f32(&s2_[b]));
+        vst1q_f32(&s2_[b], s1);
+        vst1q_f32(&s1_[b], s0);
+      }
+    }
+#else
+    float *__restrict s1 = s1_;
+    float *__restrict s2 = s2_;
+    const float *__restrict c = coeff_;
+    for (size_t i = 0; i < n; i++)
+    {
+      const float v = x[i] * w[i];
+      for (size_t b = 0; b < nb; b++)
+      {
+        float s0 = v + c[b] * s1[b] - s2[b];
+        s2[b] = s1[b];
+        s1[b] = s0;
+      }
+    }
+#endif
+  }
+
+  void finishBlock()
+  {
+    // Hann window halves the coherent gain; normalise so a full-scale tone reads ~0.25
+    const float norm = 4.0f / ((float)blockLen_ * (float)blockLen_);
+    for (size_t b = 0; b < nPadded_; b++)
+    {
+      power_[b] = (s1_[b] * s1_[b] + s2_[b] * s2_[b] - coeff_[b] * s1_[b] * s2_[b]) * norm;
+      s1_[b] = 0.0f;
+      s2_[b] = 0.0f;
+    }
+    filled_ = 0;
+  }
+
+  alignas(16) float coeff_[CAPACITY] = {};
+  alignas(16) float s1_[CAPACITY] = {};
+  alignas(16) float s2_[CAPACITY] = {};
+  alignas(16) float power_[CAPACITY] = {};
+  float freq_[CAPACITY] = {};
+  float window_[MAX_BLOCK] = {};
+  size_t nBins_ = 0;
+  size_t nPadded_ = 0;
+  size_t blockLen_ = 1;
+  size_t filled_ = 0;
+};
+
+// ================= Per-channel timing classifier =================
+// Works in block units: marks shorter than 2 units are dots, longer are dashes;
+// silence of 2 units ends the letter, 5 units ends the word. The unit tracks
+// the sender's speed from every classified mark.
+class CwChannelDecoder
+{
+public:
+  static const uint8_t MAX_SYMBOLS = (uint8_t)MORSE_PATTERN_MAX; // HH, 8 dots
+
+  void reset(float unitBlocks)
+  {
+    unit_ = unitBlocks;
+    noise_ = 0.0f;
+    peak_ = 0.0f;
+    on_ = false;
+    run_ = 0;
+    symLen_ = 0;
+    overlong_ = false;
+    wordOpen_ = false;
+  }
+
+  // Feed one block. `isPeak` is false when a neighbouring bin is louder, which
+  // keeps one station from being decoded on every bin it leaks into.
+  // Returns a decoded character ('?' for a pattern no table has, including one
+  // longer than MAX_SYMBOLS), ' ' at word end, or 0 when nothing completed.
+  char step(float power, bool isPeak)
+  {
+    // Noise floor follows the quiet minimum (fast down, slow up); peak tracks
+    // the keyed level so the release threshold adapts to signal strength
+    if (noise_ == 0.0f)
+      noise_ = power;
+    if (!on_)
+      noise_ += (power - noise_) * (power < noise_ ? 0.2f : 0.01f);
+    else
+      peak_ += (power - peak_) * 0.2f;
+
+    float thrOn = noise_ * SNR_ON + MIN_POWER;
+    float thrOff = on_ ? (peak_ * 0.25f > thrOn * 0.5f ? peak_ * 0.25f : thrOn * 0.5f) : thrOn;
+    bool key = isPeak && power > (on_ ? thrOff : thrOn);
+
+    char out = 0;
+    if (key != on_)
+    {
+      if (on_)
+        classifyMark();
+      else
+        peak_ = power;
+      on_ = key;
+      run_ = 0;
+    }
+    run_++;
+
+    if (!on_)
+    {
+      if (symLen_ > 0 && (float)run_ >= 2.0f * unit_)
+        out = finishLetter();
+      else if (wordOpen_ && (float)run_ >= 5.0f * unit_)
+      {
+        wordOpen_ = false;
+        out = ' ';
+      }
+    }
+    return out;
+  }
+
+  float unitBlocks() const { return unit_; }
+
+private:
+  static constexpr float SNR_ON = 20.0f;
+  static constexpr float MIN_POWER = 1e-6f;
+
+  void classifyMark()
+  {
+    float len = (float)run_;
+    if (len < 0.5f * unit_)
+      return; // glitch: too short to be a dot at the current speed
+    bool dash = len >= 2.0f * unit_;
+    if (symLen_ < MAX_SYMBOLS)
+      sym_[symLen_++] = dash ? '-' : '.';
+    else
+      overlong_ = true;
+    float est = dash ? len / 3.0f : len;
+    unit_ += (est - unit_) * 0.25f;
+    if (unit_ < 1.0f)
+      unit_ = 1.0f;
+  }
+
+  char finishLetter()
+  {
+    sym_[symLen_] = '\0';
+    symLen_ = 0;
+    wordOpen_ = true;
+    if (overlong_)
+    {
+      overlong_ = false;
+      return '?';
+    }
+    return morseTrieDecode(sym_);
+  }
+
+  float unit_ = 4.0f;
+  float noise_ = 0.0f;
+  float peak_ = 0.0f;
+  bool on_ = false;
+  uint32_t run_ = 0;
+  char sym_[MAX_SYMBOLS + 1] = {};
+  uint8_t symLen_ = 0;
+  bool overlong_ = false; // elements past MAX_SYMBOLS were dropped
+  bool wordOpen_ = false;
+};
+
+// ================= Receiver: bank + one decoder per bin =================
+template <size_t MaxBins>
+class CwReceiver
+{
+public:
+  // onChar(channel, ch) receives every decoded character tagged by bin.
+  typedef void (*CharSink)(uint8_t channel, char ch, void *ctx);
+
+  void configure(float sampleRate, float lowHz, float highHz, size_t bins, size_t blockLen, float initialWpm)
+  {
+    bank_.configure(sampleRate, lowHz, highHz, bins, blockLen);
+    // 1 unit = 1.2 s / WPM, expressed in blocks
+    float unitBlocks = (1.2f / initialWpm) * sampleRate / (float)blockLen;
+    for (size_t b = 0; b < MaxBins; b++)
+      dec_[b].reset(unitBlocks);
+  }
+
+  void setSink(CharSink sink, void *ctx)
+  {
+    sink_ = sink;
+    ctx_ = ctx;
+  }
+
+  void feed(const float *x, size_t n)
+  {
+    bank_.process(x, n, [this](const float *p, size_t nb)
+                  {
+      for (size_t b = 0; b < nb; b++)
+      {
+        bool isPeak = (b == 0 || p[b] >= p[b - 1]) && (b + 1 == nb || p[b] >= p[b + 1]);
+        char c = dec_[b].step(p[b], isPeak);
+        if (c && sink_)
+          sink_((uint8_t)b, c, ctx_);
+      } });
+  }
+
+  const GoertzelBank<MaxBins> &bank() const { return bank_; }
+
+private:
+  GoertzelBank<MaxBins> bank_;
+  CwChannelDecoder dec_[MaxBins];
+  CharSink sink_ = nullptr;
+  void *ctx_ = nullptr;
+};
@@ -0,0 +1,139 @@
+#pragma once
+// Heap and fragmentation monitor: allocation counters per subsystem plus
+// low-water tracking and threshold warnings over periodic heap samples.
+// The device glue (main.cpp) feeds the counters from its malloc wrappers and
+// takes samples from heap_caps; nothing here allocates.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Who asked for the memory: the main loop tags its sections, background tasks
+// are told apart by task handle, anything else lands in OTHER
+enum HeapSubsystem : uint8_t
+{
+  HEAP_SUB_BOOT,   // setup() and core start-up
+  HEAP_SUB_KEYER,  // buttons, keyer, playback
+  HEAP_SUB_UI,     // OLED
+  HEAP_SUB_SERIAL, // command parsing and replies
+  HEAP_SUB_MEMORY, // memory slots (NVS)
+  HEAP_SUB_LOG,    // session log, writer task, dumps
+  HEAP_SUB_AUDIO,  // I2S audio task
+  HEAP_SUB_RX,     // CW receiver
+  HEAP_SUB_OTHER,  // other tasks (IDF, timers, Wi-Fi ...)
+  HEAP_SUB_COUNT
+};
+
+inline const char *heapSubsystemName(uint8_t sub)
+{
+  static const char *const NAMES[HEAP_SUB_COUNT] = {"boot", "keyer", "ui", "serial", "memory", "log", "audio", "rx", "other"};
+  return sub < HEAP_SUB_COUNT ? NAMES[sub] : "?";
+}
+
+// ================= Allocation counters =================
+// Bumped from any task, so the adds are atomic; reads are a snapshot.
+struct HeapAllocCounters
+{
+  uint32_t count[HEAP_SUB_COUNT];
+  uint32_t bytes[HEAP_SUB_COUNT];
+  uint32_t frees;
+
+  void noteAlloc(uint8_t sub, size_t n)
+  {
+    if (sub >= HEAP_SUB_COUNT)
+      sub = HEAP_SUB_OTHER;
+    __atomic_fetch_add(&count[sub], 1u, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bytes[sub], (uint32_t)n, __ATOMIC_RELAXED);
+  }
+
+  void noteFree() { __atomic_fetch_add(&frees, 1u, __ATOMIC_RELAXED); }
+
+  uint32_t total() const
+  {
+    uint32_t n = 0;
+    for (size_t i = 0; i < HEAP_SUB_COUNT; i++)
+      n += count[i];
+    return n;
+  }
+};
+
+// ================= Samples / warnings =================
+struct HeapSample
+{
+  uint32_t freeBytes;    // total free
+  uint32_t largestBlock; // largest single allocation that would succeed
+  uint32_t minFreeEver;  // allocator's own low-water mark
+};
+
+enum HeapWarning : uint8_t
+{
+  HEAP_WARN_FRAGMENTED = 1, // fragmentation crossed the threshold
+  HEAP_WARN_LOW = 2,        // free heap fell below the floor
+};
+
+class HeapMonitor
+{
+public:
+  // Warn when fragmentation reaches fragWarnPct or free heap drops below
+  // lowWarnBytes. Each warning re-arms once the value is back HYSTERESIS
+  // clear of its threshold, so a value sitting on the line warns once.
+  void configure(uint8_t fragWarnPct, uint32_t lowWarnBytes)
+  {
+    fragWarnPct_ = fragWarnPct;
+    lowWarnBytes_ = lowWarnBytes;
+  }
+
+  // Fragmentation = share of free memory that is not in the largest block
+  static uint8_t fragmentationPct(const HeapSample &s)
+  {
+    if (s.freeBytes == 0 || s.largestBlock >= s.freeBytes)
+      return 0;
+    return (uint8_t)(100u - (uint32_t)((uint64_t)s.largestBlock * 100u / s.freeBytes));
+  }
+
+  // Returns the HeapWarning bits raised by this sample
+  uint8_t sample(const HeapSample &s)
+  {
+    last_ = s;
+    if (samples_ == 0 || s.freeBytes < minFree_)
+      minFree_ = s.freeBytes;
+    if (samples_ == 0 || s.largestBlock < minLargest_)
+      minLargest_ = s.largestBlock;
+    uint8_t frag = fragmentationPct(s);
+    if (frag > maxFragPct_)
+      maxFragPct_ = frag;
+    samples_++;
+
+    uint8_t raised = 0;
+    if (fragWarnPct_ && frag >= fragWarnPct_ && !(active_ & HEAP_WARN_FRAGMENTED))
+      raised |= HEAP_WARN_FRAGMENTED;
+    else if (frag + FRAG_HYSTERESIS_PCT < fragWarnPct_)
+      active_ &= (uint8_t)~HEAP_WARN_FRAGMENTED;
+    if (lowWarnBytes_ && s.freeBytes < lowWarnBytes_ && !(active_ & HEAP_WARN_LOW))
+      raised |= HEAP_WARN_LOW;
+    else if (s.freeBytes >= lowWarnBytes_ + lowWarnBytes_ / 8)
+      active_ &= (uint8_t)~HEAP_WARN_LOW;
+    active_ |= raised;
+    return raised;
+  }
+
+  const HeapSample &last() const { return last_; }
+  uint8_t lastFragmentationPct() const { return fragmentationPct(last_); }
+  uint32_t minFree() const { return minFree_; }       // lowest free seen by sampling
+  uint32_t minLargest() const { return minLargest_; } // smallest largest-block seen
+  uint8_t maxFragmentationPct() const { return maxFragPct_; }
+  uint32_t samples() const { return samples_; }
+
+private:
+  static const uint8_t FRAG_HYSTERESIS_PCT = 5;
+
+  uint8_t fragWarnPct_ = 0;
+  uint32_t lowWarnBytes_ = 0;
+  HeapSample last_ = {};
+  uint32_t minFree_ = 0;
+  uint32_t minLargest_ = 0;
+  uint8_t maxFragPct_ = 0;
+  uint32_t samples_ = 0;
+  uint8_t active_ = 0;
+};
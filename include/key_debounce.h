@@ -0,0 +1,67 @@
+#pragma once
+// Vertical-counter debouncer: all keys are debounced together, one bit per
+// key, from a single input word per sample. Each bit has a 2-bit counter kept
+// bit-sliced across two words, so one sample is a handful of bitwise ops no
+// matter how many keys there are. A key changes state after DEBOUNCE_SAMPLES
+// consecutive samples disagreeing with it; any agreeing sample restarts the
+// count.
+//
+// The device feeds it the GPIO input register (pins as bits); adding paddles,
+// memory or menu buttons only widens the mask.
+//
+// Portable (no Arduino dependencies).
+
+#include <stdint.h>
+
+class VerticalDebouncer
+{
+public:
+  static const uint8_t DEBOUNCE_SAMPLES = 4;
+
+  // pressed = bits held at start-up; they start out debounced
+  void reset(uint32_t pressed)
+  {
+    state_ = pressed;
+    cnt0_ = cnt1_ = ~0u;
+    pressEvents_ = releaseEvents_ = 0;
+  }
+
+  // One sample; pressed = 1 bits for keys down right now (caller masks and
+  // inverts active-LOW inputs). Returns the bits that changed state.
+  uint32_t sample(uint32_t pressed)
+  {
+    uint32_t diff = state_ ^ pressed;
+    // agreeing bits reload their counter, disagreeing ones count down; a
+    // counter that rolls over has disagreed for DEBOUNCE_SAMPLES samples
+    cnt0_ = ~(cnt0_ & diff);
+    cnt1_ = cnt0_ ^ (cnt1_ & diff);
+    uint32_t toggled = diff & cnt0_ & cnt1_;
+    state_ ^= toggled;
+    pressEvents_ |= toggled & state_;
+    releaseEvents_ |= toggled & ~state_;
+    return toggled;
+  }
+
+  uint32_t state() const { return state_; } // debounced: 1 = down
+
+  // Edges since the last take, so samples may run more often than the reader
+  uint32_t takePressed()
+  {
+    uint32_t e = pressEvents_;
+    pressEvents_ = 0;
+    return e;
+  }
+  uint32_t takeReleased()
+  {
+    uint32_t e = releaseEvents_;
+    releaseEvents_ = 0;
+    return e;
+  }
+
+private:
+  uint32_t state_ = 0;
+  uint32_t cnt0_ = ~0u;
+  uint32_t cnt1_ = ~0u;
+  uint32_t pressEvents_ = 0;
+  uint32_t releaseEvents_ = 0;
+};
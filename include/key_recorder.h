@@ -0,0 +1,148 @@
+#pragma once
+// Session recorder and replayer. The recorder keeps a key_trace.h stream in a
+// fixed RAM buffer (key edges plus whatever else the caller traces, such as
+// commits); the replayer feeds the recorded edges back as updateButton()-style
+// results at their original offsets, so a Keyer (keyer.h) reproduces the
+// session: same tones, same gaps, same commits.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include "key_trace.h"
+
+// ================= Recorder =================
+template <size_t Cap>
+class KeyRecorder
+{
+public:
+  // Starts a new stream; event times count from `now`
+  void start(uint32_t now, uint16_t unitMs)
+  {
+    len_ = TraceWriter::header(buf_, unitMs);
+    writer_.reset(now);
+    startMs_ = now;
+    active_ = true;
+    full_ = false;
+  }
+
+  // Lets go of a held press, so a key still down at the end is in the stream
+  void stop()
+  {
+    if (active_)
+      len_ += writer_.flush(buf_ + len_);
+    active_ = false;
+  }
+
+  // Stops (and reports full()) once the buffer cannot take another event
+  bool add(uint32_t now, uint8_t type, uint8_t arg = 0, uint8_t payload = 0)
+  {
+    if (!active_)
+      return false;
+    if (len_ + TRACE_EVENT_MAX + TRACE_FLUSH_MAX > Cap)
+    {
+      full_ = true;
+      stop();
+      return false;
+    }
+    len_ += writer_.event(buf_ + len_, now, type, arg, payload);
+    return true;
+  }
+
+  bool active() const { return active_; }
+  bool full() const { return full_; }
+  uint32_t startMs() const { return startMs_; }
+  const uint8_t *data() const { return buf_; }
+  size_t size() const { return len_; }
+  static constexpr size_t capacity() { return Cap; }
+
+private:
+  uint8_t buf_[Cap];
+  size_t len_ = 0;
+  uint32_t startMs_ = 0;
+  bool active_ = false;
+  bool full_ = false;
+  TraceWriter writer_;
+};
+
+// ================= Replayer =================
+// Edges per key, in the shape the keyer takes: 0, +1 pressed, -1 released
+struct KeyEdges
+{
+  int8_t ev[3];
+};
+
+class KeyReplayer
+{
+public:
+  // Reads the stream header; false if the bytes are not a trace stream
+  bool begin(const uint8_t *p, size_t n, uint32_t now)
+  {
+    reader_ = TraceReader(p, n, 0);
+    active_ = reader_.readHeader(unitMs_);
+    startMs_ = now;
+    hasNext_ = false;
+    if (active_)
+      advance();
+    return active_;
+  }
+
+  void stop() { active_ = false; }
+
+  // Edges due at `now`, at most one per key per call so a press and release of
+  // the same key always land in separate passes. False once the stream ends.
+  bool poll(uint32_t now, KeyEdges &out)
+  {
+    out.ev[0] = out.ev[1] = out.ev[2] = 0;
+    while (hasNext_ && (int32_t)(now - (startMs_ + next_.timeMs)) >= 0)
+    {
+      uint8_t key = next_.arg;
+      if (key < 3)
+      {
+        if (out.ev[key] != 0)
+          break;
+        out.ev[key] = next_.type == TRACE_PRESS ? +1 : -1;
+      }
+      advance();
+    }
+    if (!hasNext_)
+      active_ = false;
+    return active_ || out.ev[0] || out.ev[1] || out.ev[2];
+  }
+
+  // Absolute time of the next edge; false when none is left
+  bool nextTime(uint32_t &at) const
+  {
+    if (!hasNext_)
+      return false;
+    at = startMs_ + next_.timeMs;
+    return true;
+  }
+
+  bool active() const { return active_; }
+  uint16_t unitMs() const { return unitMs_; }
+
+private:
+  // Skip to the next key edge; everything else in the stream is output
+  void advance()
+  {
+    hasNext_ = false;
+    TraceEvent ev;
+    while (reader_.next(ev))
+    {
+      if (ev.type == TRACE_PRESS || ev.type == TRACE_RELEASE)
+      {
+        next_ = ev;
+        hasNext_ = true;
+        return;
+      }
+    }
+  }
+
+  TraceReader reader_ = TraceReader(nullptr, 0);
+  TraceEvent next_ = {};
+  bool hasNext_ = false;
+  bool active_ = false;
+  uint16_t unitMs_ = 0;
+  uint32_t startMs_ = 0;
+};
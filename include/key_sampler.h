@@ -0,0 +1,91 @@
+#pragma once
+// Timer-driven key sampling for high-speed keying. A periodic timer feeds raw
+// key readings into the vertical-counter debouncer (key_debounce.h) and every
+// debounced change goes into a small queue with the time it was seen. The
+// main loop drains the queue and applies each edge at its own time, so
+// neither the loop period nor an OLED refresh shifts the gaps the keyer
+// measures.
+//
+// One producer (the timer) and one consumer (the loop), on different cores:
+// the queue indices are published with release/acquire and nothing locks.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include "key_debounce.h"
+
+struct KeySample
+{
+  uint32_t timeMs;   // when the debouncer accepted the change
+  uint32_t pressed;  // keys that went down
+  uint32_t released; // keys that went up
+};
+
+// Debounce window = unitMs / debounceDiv, capped at maxDebounceMs, and the
+// sample period is a DEBOUNCE_SAMPLES-th of that, floored at minPeriodUs.
+// 60 WPM (20 ms unit) with div 4: 5 ms window sampled every 1250 us.
+inline uint32_t keySamplePeriodUs(uint16_t unitMs, uint8_t debounceDiv, uint16_t maxDebounceMs, uint32_t minPeriodUs)
+{
+  uint32_t windowUs = (uint32_t)unitMs * 1000u / (debounceDiv ? debounceDiv : 1);
+  if (windowUs > (uint32_t)maxDebounceMs * 1000u)
+    windowUs = (uint32_t)maxDebounceMs * 1000u;
+  uint32_t periodUs = windowUs / VerticalDebouncer::DEBOUNCE_SAMPLES;
+  return periodUs < minPeriodUs ? minPeriodUs : periodUs;
+}
+
+template <size_t Cap>
+class KeySampler
+{
+  static_assert((Cap & (Cap - 1)) == 0, "capacity must be a power of two");
+
+public:
+  // Not while the timer runs; held = keys down at start-up
+  void reset(uint32_t held)
+  {
+    debounce_.reset(held);
+    head_ = tail_ = 0;
+    dropped_ = 0;
+  }
+
+  // ---- Producer (timer) ----
+  void sample(uint32_t pressed, uint32_t nowMs)
+  {
+    uint32_t toggled = debounce_.sample(pressed);
+    if (toggled == 0)
+      return;
+    uint32_t head = head_;
+    if (head - __atomic_load_n(&tail_, __ATOMIC_ACQUIRE) >= Cap)
+    {
+      dropped_++; // only if the loop stalls for Cap edges
+      return;
+    }
+    KeySample &s = queue_[head & (Cap - 1)];
+    s.timeMs = nowMs;
+    s.pressed = toggled & debounce_.state();
+    s.released = toggled & ~debounce_.state();
+    __atomic_store_n(&head_, head + 1, __ATOMIC_RELEASE);
+  }
+
+  // ---- Consumer (loop) ----
+  bool peek(KeySample &out) const
+  {
+    uint32_t tail = tail_;
+    if (tail == __atomic_load_n(&head_, __ATOMIC_ACQUIRE))
+      return false;
+    out = queue_[tail & (Cap - 1)];
+    return true;
+  }
+
+  void pop() { __atomic_store_n(&tail_, tail_ + 1, __ATOMIC_RELEASE); }
+
+  uint32_t state() const { return debounce_.state(); } // debounced: 1 = down
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  VerticalDebouncer debounce_;
+  KeySample queue_[Cap];
+  uint32_t head_ = 0; // written by the producer only
+  uint32_t tail_ = 0; // written by the consumer only
+  uint32_t dropped_ = 0;
+};
@@ -0,0 +1,271 @@
+#pragma once
+// Compact binary trace of keyer activity: key edges, commits, gaps and
+// playback events, each stamped with a varint millisecond delta.
+//
+// Stream = header + events.
+//   Header: 'M' 'K' 'T' version(2), varint unit ms
+//   Event:  tag byte (low nibble = type, high nibble = arg),
+//           varint ms since the previous event (first: since stream start),
+//           then a type-specific payload (COMMIT: 1 byte character;
+//           MARK: varint hold time).
+// The writer folds a press and its release into one MARK (delta to the press,
+// then how long the key was held) unless something else happened while the
+// key was down; events at the press's own millisecond, such as the commit a
+// key-down causes, are written ahead of it. The reader hands a MARK back as
+// the PRESS / RELEASE pair, so nothing downstream sees the difference. A
+// keyed element costs 3-5 bytes, a commit 3. Version 1 streams (no MARK)
+// still read.
+//
+// The same event bytes travel inside session-log records (LOG_REC_TRACE in
+// session_log.h), so serial streams and flash logs decode with one reader.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+
+const uint8_t TRACE_VERSION = 2;
+const size_t TRACE_HEADER_MAX = 4 + 5;
+const size_t TRACE_FLUSH_MAX = 1 + 5;               // a held press written as a PRESS
+const size_t TRACE_EVENT_MAX = TRACE_FLUSH_MAX + 7; // one event(): held press + tag, varint, payload
+
+enum TraceEventType : uint8_t
+{
+  TRACE_PRESS = 0,      // arg = key
+  TRACE_RELEASE = 1,    // arg = key
+  TRACE_COMMIT = 2,     // arg = TraceCommitReason, payload = character
+  TRACE_SPACE = 3,      // word space inserted
+  TRACE_PLAY_START = 4, // arg = TracePlaySource
+  TRACE_PLAY_STOP = 5,  // playback stopped
+  TRACE_CLEAR = 6,      // long-press clear
+  TRACE_MARK = 7,       // arg = key, payload = varint hold ms; a PRESS + RELEASE (v2)
+};
+
+enum TraceKey : uint8_t
+{
+  TRACE_KEY_DOT = 0,
+  TRACE_KEY_DASH = 1,
+  TRACE_KEY_OK = 2,
+};
+
+enum TraceCommitReason : uint8_t
+{
+  TRACE_COMMIT_OK = 0,         // OK short press
+  TRACE_COMMIT_GAP_LETTER = 1, // auto, letter gap
+  TRACE_COMMIT_GAP_WORD = 2,   // auto, word gap
+  TRACE_COMMIT_COMPLETE = 3,   // auto, no longer pattern possible
+};
+
+enum TracePlaySource : uint8_t
+{
+  TRACE_PLAY_TEXT = 0,   // committed text / current letter
+  TRACE_PLAY_MEMORY = 1, // memory slot
+  // 2: reserved, unused
+  TRACE_PLAY_SERIAL = 3, // queued over the serial protocol
+  TRACE_PLAY_BEACON = 4, // memory slot looping as a beacon
+  TRACE_PLAY_KOCH = 5,   // Koch trainer group
+  TRACE_PLAY_ECHO = 6,   // echo drill character
+};
+
+// ================= Varint (LEB128, unsigned) =================
+inline size_t tracePutVarint(uint8_t *out, uint32_t v)
+{
+  size_t n = 0;
+  while (v >= 0x80)
+  {
+    out[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t)v;
+  return n;
+}
+
+// Returns bytes consumed, 0 if truncated or over-long
+inline size_t traceGetVarint(const uint8_t *p, const uint8_t *end, uint32_t &v)
+{
+  v = 0;
+  for (size_t i = 0; i < 5 && p + i < end; i++)
+  {
+    v |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+    if ((p[i] & 0x80) == 0)
+      return i + 1;
+  }
+  return 0;
+}
+
+inline bool traceHasPayload(uint8_t type) { return type == TRACE_COMMIT; }
+
+// ================= Writer =================
+class TraceWriter
+{
+public:
+  // Header for a standalone stream; returns bytes written to out
+  static size_t header(uint8_t *out, uint16_t unitMs)
+  {
+    out[0] = 'M';
+    out[1] = 'K';
+    out[2] = 'T';
+    out[3] = TRACE_VERSION;
+    return 4 + tracePutVarint(out + 4, unitMs);
+  }
+
+  // Deltas count from here (stream start or record start). Any held press
+  // must have been flushed first.
+  void reset(uint32_t nowMs)
+  {
+    lastMs_ = nowMs;
+    holding_ = false;
+  }
+
+  // Encode one event into out (TRACE_EVENT_MAX bytes); returns bytes written.
+  // A PRESS is held back (0 bytes) until its release shows whether it can
+  // go out as a MARK.
+  size_t event(uint8_t *out, uint32_t nowMs, uint8_t type, uint8_t arg = 0, uint8_t payload = 0)
+  {
+    size_t n = 0;
+    if (holding_)
+    {
+      if (type == TRACE_RELEASE && arg == heldKey_)
+      {
+        n = put(out, heldMs_, TRACE_MARK, arg);
+        n += tracePutVarint(out + n, nowMs - heldMs_);
+        holding_ = false;
+        lastMs_ = nowMs;
+        return n;
+      }
+      if (nowMs != heldMs_ || type == TRACE_PRESS || type == TRACE_RELEASE)
+        n = flush(out);
+    }
+    if (type == TRACE_PRESS && !holding_)
+    {
+      holding_ = true;
+      heldKey_ = arg;
+      heldMs_ = nowMs;
+      return n;
+    }
+    n += put(out + n, nowMs, type, arg);
+    if (traceHasPayload(type))
+      out[n++] = payload;
+    return n;
+  }
+
+  // Write a held press as a plain PRESS (TRACE_FLUSH_MAX bytes), e.g. at the
+  // end of a stream; returns bytes written
+  size_t flush(uint8_t *out)
+  {
+    if (!holding_)
+      return 0;
+    holding_ = false;
+    return put(out, heldMs_, TRACE_PRESS, heldKey_);
+  }
+
+  bool holding() const { return holding_; }
+  uint32_t lastMs() const { return lastMs_; } // the next delta counts from here
+
+private:
+  size_t put(uint8_t *out, uint32_t atMs, uint8_t type, uint8_t arg)
+  {
+    out[0] = (uint8_t)((type & 0x0F) | (arg << 4));
+    size_t n = 1 + tracePutVarint(out + 1, atMs - lastMs_);
+    lastMs_ = atMs;
+    return n;
+  }
+
+  uint32_t lastMs_ = 0;
+  bool holding_ = false;
+  uint8_t heldKey_ = 0;
+  uint32_t heldMs_ = 0;
+};
+
+// ================= Reader =================
+struct TraceEvent
+{
+  uint32_t timeMs; // absolute: base + sum of deltas
+  uint8_t type;
+  uint8_t arg;
+  uint8_t payload;
+};
+
+class TraceReader
+{
+public:
+  TraceReader(const uint8_t *p, size_t n, uint32_t baseMs = 0) : p_(p), end_(p + n), timeMs_(baseMs) {}
+
+  // Consume a stream header if present; false if the bytes are not one
+  bool readHeader(uint16_t &unitMs)
+  {
+    if (end_ - p_ < 5 || p_[0] != 'M' || p_[1] != 'K' || p_[2] != 'T' || p_[3] == 0 || p_[3] > TRACE_VERSION)
+      return false;
+    uint32_t v;
+    size_t used = traceGetVarint(p_ + 4, end_, v);
+    if (used == 0)
+      return false;
+    unitMs = (uint16_t)v;
+    p_ += 4 + used;
+    return true;
+  }
+
+  // False at end of data or on a truncated event. A MARK comes back as its
+  // PRESS, then its RELEASE on the next call.
+  bool next(TraceEvent &ev)
+  {
+    if (releasePending_)
+    {
+      releasePending_ = false;
+      ev = release_;
+      return true;
+    }
+    if (p_ >= end_)
+      return false;
+    uint8_t tag = *p_;
+    uint32_t delta, hold = 0;
+    size_t used = traceGetVarint(p_ + 1, end_, delta);
+    if (used == 0)
+      return false;
+    const uint8_t *q = p_ + 1 + used;
+    ev.type = tag & 0x0F;
+    ev.arg = tag >> 4;
+    ev.payload = 0;
+    if (traceHasPayload(ev.type))
+    {
+      if (q >= end_)
+        return false;
+      ev.payload = *q++;
+    }
+    else if (ev.type == TRACE_MARK)
+    {
+      used = traceGetVarint(q, end_, hold);
+      if (used == 0)
+        return false;
+      q += used;
+    }
+    timeMs_ += delta;
+    ev.timeMs = timeMs_;
+    p_ = q;
+    if (ev.type == TRACE_MARK)
+    {
+      ev.type = TRACE_PRESS;
+      timeMs_ += hold;
+      release_ = {timeMs_, TRACE_RELEASE, ev.arg, 0};
+      releasePending_ = true;
+    }
+    return true;
+  }
+
+  size_t remaining() const { return (size_t)(end_ - p_); }
+  uint32_t timeMs() const { return timeMs_; } // the next delta counts from here
+
+private:
+  const uint8_t *p_;
+  const uint8_t *end_;
+  uint32_t timeMs_;
+  TraceEvent release_ = {};
+  bool releasePending_ = false;
+};
+
+// Short name for printing
+inline const char *traceTypeName(uint8_t type)
+{
+  static const char *const NAMES[] = {"PRESS", "RELEASE", "COMMIT", "SPACE", "PLAY", "STOP", "CLEAR", "MARK"};
+  return type < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[type] : "?";
+}
@@ -0,0 +1,686 @@
+#pragma once
+// The keyer: everything the main loop does between reading the buttons and
+// drawing the screen. It takes debounced key edges plus the clock and decides
+// what sounds, which letters commit, when a word space goes in and when
+// playback runs. Sound, logging and memory slots hang off a KeyerListener, so
+// the device and the host replay tool (tools/keyer_replay.cpp) run the same
+// gap and commit logic.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "morse_table.h"
+#include "morse_stages.h"
+#include "morse_trie.h"
+#include "morse_nearest.h"
+#include "morse_codec.h"
+#include "morse_dict.h"
+#include "key_trace.h"
+
+const size_t KEYER_TEXT_MAX = 120;   // committed text kept; the oldest is trimmed
+const size_t KEYER_SYMBOLS_MAX = 15; // elements kept for the letter being keyed
+const uint8_t KEYER_MEM_SLOTS = 4;   // memory chords (see step())
+
+struct KeyerTiming
+{
+  uint16_t letterGapMs;       // silence before a key-down that commits a letter
+  uint16_t wordGapMs;         // ... that also inserts a word space
+  uint16_t clearHoldMs;       // OK long-press clears
+  uint16_t okMultiWindowMs;   // triple-tap window
+  uint16_t memRecordHoldMs;   // memory chord held this long records
+  MorseTiming play;           // playback stage durations and loop gap
+  bool earlyCommit;           // commit as soon as no longer pattern can follow
+  uint8_t guessMinConfidence; // an unknown pattern commits its nearest character if at least
+                              // this sure (0..100, morse_nearest.h), else '?'; 101 = never
+  uint16_t wordFixMaxCost;    // a closed word not in the dictionary is replaced by the nearest
+                              // one within this cost (morse_dict.h); 0 = off
+};
+
+// The firmware defaults (main.cpp Timing section) for a given unit
+inline KeyerTiming keyerTimingForUnit(uint16_t unitMs)
+{
+  KeyerTiming t;
+  t.letterGapMs = (uint16_t)(3 * unitMs);
+  t.wordGapMs = (uint16_t)(7 * unitMs);
+  t.clearHoldMs = 2000;
+  t.okMultiWindowMs = 600;
+  t.memRecordHoldMs = 1500;
+  t.play = morseTimingForUnit(unitMs);
+  t.earlyCommit = true;
+  t.guessMinConfidence = 0;
+  t.wordFixMaxCost = 4;
+  return t;
+}
+
+// Why a commit was checked (one readable event line each on the device)
+enum KeyerCommitPoint : uint8_t
+{
+  KEYER_AT_GAP_LETTER, // key-down after a letter gap
+  KEYER_AT_GAP_WORD,   // key-down after a word gap
+  KEYER_AT_OK,         // OK tap window ran out
+  KEYER_AT_OK_LATE,    // next OK tap arrived after the window
+  KEYER_AT_COMPLETE,   // the letter cannot grow any more (earlyCommit)
+};
+
+enum KeyerStopReason : uint8_t
+{
+  KEYER_STOP_INPUT,  // any key went down
+  KEYER_STOP_TOGGLE, // triple tap while playing
+  KEYER_STOP_CLEAR,  // OK long-press
+  KEYER_STOP_DONE,   // the requested number of passes has played
+  KEYER_STOP_REMOTE, // stop command over serial
+  KEYER_STOP_YIELD,  // gave way to another message at a letter boundary
+};
+
+// Callbacks run synchronously from Keyer::update(); all default to no-ops
+class KeyerListener
+{
+public:
+  virtual ~KeyerListener() {}
+  virtual void onTone(bool /*on*/) {}                               // sidetone or playback edge
+  virtual void onSymbol(char /*s*/) {}                              // '.' or '-' added to the letter
+  virtual void onLetter(const char * /*pattern*/, char /*c*/, uint8_t /*reason*/) {} // TraceCommitReason
+  virtual void onSpace() {}                                         // word space added
+  virtual void onWordFixed(const char * /*keyed*/, const char * /*fixed*/) {} // dictionary correction
+  virtual void onWordErased(const char * /*word*/) {}               // error prosign took it back
+  virtual void onCommitPoint(uint8_t /*at*/) {}                     // KeyerCommitPoint
+  virtual void onClear() {}
+  virtual void onPlayStart(const char * /*stages*/, uint8_t /*source*/) {} // TracePlaySource
+  virtual void onPlayStop(uint8_t /*reason*/) {}                    // KeyerStopReason
+  virtual void onPlayEmpty() {}                                     // triple tap with nothing to play
+  virtual void onMemory(uint8_t /*slot*/, bool /*record*/, uint32_t /*now*/) {} // 0..KEYER_MEM_SLOTS-1, see step()
+};
+
+class Keyer
+{
+public:
+  void configure(const KeyerTiming &timing, KeyerListener *listener)
+  {
+    timing_ = timing;
+    listener_ = listener ? listener : &silent_;
+  }
+
+  // Decode and play back in another alphabet (morse_codec.h). A letter being
+  // keyed is dropped: its trie node belongs to the old table.
+  void setCodec(const MorseCodec &codec)
+  {
+    codec_ = &codec;
+    symbolsLen_ = 0;
+    symbols_[0] = '\0';
+    trieNode_ = MORSE_TRIE_ROOT;
+  }
+  const MorseCodec &codec() const { return *codec_; }
+
+  // Back to power-on state: no text, nothing playing, tone off
+  void reset(uint32_t now, bool dotDown = false, bool dashDown = false, bool okDown = false)
+  {
+    keys_[TRACE_KEY_DOT] = {dotDown, now};
+    keys_[TRACE_KEY_DASH] = {dashDown, now};
+    keys_[TRACE_KEY_OK] = {okDown, now};
+    prevAnyPressed_ = dotDown || dashDown;
+    lastSilenceStartMs_ = now;
+    okMultiCount_ = 0;
+    okMultiStartMs_ = 0;
+    okClearLatched_ = false;
+    okChordUsed_ = dotChord_ = dashChord_ = chordRecorded_ = false;
+    text_[0] = symbols_[0] = lastPattern_[0] = '\0';
+    lastGuess_ = {};
+    wordLen_ = wordStart_ = prevWordStart_ = 0;
+    textLen_ = symbolsLen_ = 0;
+    trieNode_ = MORSE_TRIE_ROOT;
+    textWasTrimmed_ = false;
+    playActive_ = false;
+    setTone(false);
+  }
+
+  // Forget held keys without acting on them (e.g. when a replay is cut short)
+  void releaseKeys(uint32_t now)
+  {
+    for (Key &k : keys_)
+      k.down = false;
+    okChordUsed_ = dotChord_ = dashChord_ = chordRecorded_ = false;
+    okClearLatched_ = false;
+    prevAnyPressed_ = false;
+    lastSilenceStartMs_ = now;
+    if (!playActive_)
+      setTone(false);
+  }
+
+  // One pass of the main loop. ev* are updateButton() results for this pass:
+  // 0 = no edge, +1 = pressed, -1 = released.
+  // Deadlines that fell between passes (tap window, long-press, next playback
+  // stage) are applied first, at their own times, so what the keyer decides
+  // depends only on edge times and not on how often the loop gets round. That
+  // is what makes a recorded session replay to the same result.
+  void update(uint32_t now, int8_t evDot, int8_t evDash, int8_t evOk)
+  {
+    uint32_t due;
+    for (int i = 0; i < MAX_CATCH_UP && nextDeadline(due) && (int32_t)(due - now) < 0; i++)
+      step(due, 0, 0, 0);
+    step(now, evDot, evDash, evOk);
+  }
+
+  // Earliest time at which update() would act without a new edge: a stage
+  // boundary, the tap window closing, or a long-press/record threshold.
+  // Returns false when nothing is pending. Lets a replay jump straight there.
+  bool nextDeadline(uint32_t &at) const
+  {
+    bool any = false;
+    auto consider = [&](uint32_t t) {
+      if (!any || (int32_t)(t - at) < 0)
+        at = t;
+      any = true;
+    };
+    const Key &ok = keys_[TRACE_KEY_OK];
+    if (playActive_)
+      consider(playStageStart_ + playStageDur_);
+    if (okMultiCount_ > 0)
+      consider(okMultiStartMs_ + timing_.okMultiWindowMs + 1);
+    if (ok.down && !okClearLatched_ && !okChordUsed_)
+      consider(ok.pressStartMs + timing_.clearHoldMs);
+    if (!chordRecorded_ && (dotChord_ || dashChord_))
+      consider(chordPressMs_ + timing_.memRecordHoldMs);
+    return any;
+  }
+
+  // ---- Playback ----
+  // Play a finished stage program in place (RAM or flash); nothing is copied.
+  // It loops until stopped, or ends after `passes` passes (each followed by
+  // the loop gap) if that is nonzero. `from` resumes at a stage index taken
+  // from playResumeIndex().
+  void startPlaybackStages(const char *stages, size_t len, uint32_t now, uint8_t source, uint8_t passes = 0,
+                           size_t from = 0)
+  {
+    playStages_ = stages;
+    playLen_ = len;
+    playIndex_ = from < len ? from : len;
+    playPassesLeft_ = passes;
+    playActive_ = true;
+    playInLoopGap_ = false;
+    playYield_ = false;
+    startStageFromIndex(now);
+    listener_->onPlayStart(playStages_, source);
+  }
+
+  // Current letter if one is being keyed, else the committed text; nothing
+  // (onPlayEmpty) when there is neither
+  void startPlayback(uint32_t now)
+  {
+    size_t n;
+    if (symbolsLen_ > 0)
+    {
+      n = morseBuildStagesForPattern(symbols_, playBuf_, sizeof(playBuf_));
+    }
+    else
+    {
+      char msg[KEYER_TEXT_MAX + 1];
+      size_t len = textLen_;
+      while (len > 0 && text_[len - 1] == ' ')
+        len--;
+      memcpy(msg, text_, len);
+      msg[len] = '\0';
+      n = morseBuildStagesFromText(msg, playBuf_, sizeof(playBuf_), *codec_->alphabet);
+    }
+    if (n == 0)
+      listener_->onPlayEmpty();
+    else
+      startPlaybackStages(playBuf_, n, now, TRACE_PLAY_TEXT);
+  }
+
+  // Stop at the next letter boundary (KEYER_STOP_YIELD) instead of mid-letter
+  void yieldPlayback() { playYield_ = playActive_; }
+
+  void stopPlayback(uint8_t reason)
+  {
+    bool was = playActive_;
+    playActive_ = false;
+    setTone(false);
+    if (was)
+      listener_->onPlayStop(reason);
+  }
+
+  // ---- Text ----
+  void clearText()
+  {
+    textLen_ = symbolsLen_ = 0;
+    trieNode_ = MORSE_TRIE_ROOT;
+    text_[0] = symbols_[0] = lastPattern_[0] = '\0';
+    lastGuess_ = {};
+    wordLen_ = wordStart_ = prevWordStart_ = 0;
+    textWasTrimmed_ = false;
+    listener_->onClear();
+  }
+
+  const char *text() const { return text_; }
+  size_t textLen() const { return textLen_; }
+  bool textWasTrimmed() const { return textWasTrimmed_; }
+  const char *symbols() const { return symbols_; }
+  const char *lastPattern() const { return lastPattern_; }
+  // Live decode of the letter being keyed (morse_trie.h): its trie node (0 =
+  // no character can match any more) and the character it already spells
+  MorseTrieNode trieNode() const { return trieNode_; }
+  char currentMatch() const { return morseTrieChar(*codec_->trie, trieNode_); }
+  // How the last committed letter was read: confidence 100 for a table
+  // pattern, otherwise the nearest-match guess (ch is '?' if it was too unsure)
+  const MorseGuess &lastGuess() const { return lastGuess_; }
+
+  // ---- State ----
+  bool keyDown(uint8_t key) const { return key < 3 && keys_[key].down; }
+  bool playing() const { return playActive_; }
+  // Where the playing (or last stopped) message picks up again: the gap before
+  // the letter in progress, so a resumed letter is always whole
+  size_t playResumeIndex() const { return playResumeIndex_; }
+  // Program playing and the stage it is on (== playLen() during the loop gap)
+  const char *playStages() const { return playStages_; }
+  size_t playLen() const { return playLen_; }
+  size_t playIndex() const { return playIndex_; }
+  uint8_t playPassesLeft() const { return playPassesLeft_; }
+  // Nothing playing, no key down, no OK taps pending, keys quiet for quietMs
+  bool idle(uint32_t now, uint32_t quietMs) const
+  {
+    return !playActive_ && okMultiCount_ == 0 && !anyPressed() && now - lastSilenceStartMs_ >= quietMs;
+  }
+  bool toneOn() const { return tone_; }
+  // Ideal start of the current playback stage (previous start + its duration),
+  // i.e. the scheduled time of the tone edge it caused
+  uint32_t playStageStartMs() const { return playStageStart_; }
+  // In the loop gap after the last pass: every tone of the program has played
+  bool playTonesDone() const { return playActive_ && playInLoopGap_ && playPassesLeft_ == 1; }
+  const KeyerTiming &timing() const { return timing_; }
+
+private:
+  struct Key
+  {
+    bool down;
+    uint32_t pressStartMs;
+  };
+
+  static const int MAX_CATCH_UP = 64; // deadlines applied per update(), at most
+
+  // The loop body proper, at one instant
+  void step(uint32_t now, int8_t evDot, int8_t evDash, int8_t evOk)
+  {
+    applyEdge(keys_[TRACE_KEY_DOT], evDot, now);
+    applyEdge(keys_[TRACE_KEY_DASH], evDash, now);
+    applyEdge(keys_[TRACE_KEY_OK], evOk, now);
+    const Key &ok = keys_[TRACE_KEY_OK];
+
+    // DOT/DASH pressed while OK is held select a memory slot instead of keying:
+    // DOT 1, DASH 2, DOT then DASH 3, DASH then DOT 4
+    if (evDot == +1 && ok.down)
+      chordPress(dotChord_, 0, now);
+    if (evDash == +1 && ok.down)
+      chordPress(dashChord_, 1, now);
+
+    // Cancel playback on any input
+    if (playActive_ && (evDot == +1 || evDash == +1 || evOk == +1))
+      stopPlayback(KEYER_STOP_INPUT);
+
+    if (playActive_)
+    {
+      servicePlayback(now); // playback drives the tone
+    }
+    else
+    {
+      bool nowAnyPressed = anyPressed();
+      setTone(nowAnyPressed);
+
+      // Auto-commit/space based on the idle gap before this key-down
+      if (!prevAnyPressed_ && nowAnyPressed)
+      {
+        uint32_t gap = now - lastSilenceStartMs_;
+        if (gap >= timing_.wordGapMs)
+        {
+          commitLetterIfAny(TRACE_COMMIT_GAP_WORD);
+          pushSpaceIfNeeded();
+          listener_->onCommitPoint(KEYER_AT_GAP_WORD);
+        }
+        else if (gap >= timing_.letterGapMs)
+        {
+          commitLetterIfAny(TRACE_COMMIT_GAP_LETTER);
+          listener_->onCommitPoint(KEYER_AT_GAP_LETTER);
+        }
+      }
+      if (prevAnyPressed_ && !nowAnyPressed)
+        lastSilenceStartMs_ = now;
+      prevAnyPressed_ = nowAnyPressed;
+    }
+
+    // Memory chord held long enough: record the committed text into that slot
+    if (!chordRecorded_ && (dotChord_ || dashChord_) && now - chordPressMs_ >= timing_.memRecordHoldMs)
+    {
+      listener_->onMemory(chordSlot_, true, now);
+      chordRecorded_ = true;
+    }
+
+    // Append symbols on release (a short memory chord plays its slot instead)
+    if (evDot == -1)
+    {
+      if (dotChord_)
+        chordRelease(dotChord_, now);
+      else
+        pushSymbol('.');
+    }
+    if (evDash == -1)
+    {
+      if (dashChord_)
+        chordRelease(dashChord_, now);
+      else
+        pushSymbol('-');
+    }
+
+    // OK long-press = clear
+    if (ok.down && !okClearLatched_ && !okChordUsed_ && (now - ok.pressStartMs >= timing_.clearHoldMs))
+    {
+      clearText();
+      okClearLatched_ = true;
+      stopPlayback(KEYER_STOP_CLEAR);
+      okMultiCount_ = 0;
+    }
+    if (!ok.down)
+      okClearLatched_ = false;
+
+    // OK short-press with triple-tap detection (not when it was part of a chord)
+    if (evOk == -1 && okChordUsed_)
+      okChordUsed_ = false;
+    else if (evOk == -1 && now - ok.pressStartMs < timing_.clearHoldMs)
+    {
+      if (okMultiCount_ == 0)
+      {
+        okMultiCount_ = 1;
+        okMultiStartMs_ = now;
+      }
+      else if (now - okMultiStartMs_ <= timing_.okMultiWindowMs)
+      {
+        okMultiCount_++;
+      }
+      else
+      {
+        if (okMultiCount_ < 3)
+        {
+          commitLetterIfAny(TRACE_COMMIT_OK);
+          listener_->onCommitPoint(KEYER_AT_OK_LATE);
+        }
+        okMultiCount_ = 1;
+        okMultiStartMs_ = now;
+      }
+
+      // Triple tap: start/stop playback of the current letter or the whole text
+      if (okMultiCount_ >= 3)
+      {
+        if (playActive_)
+          stopPlayback(KEYER_STOP_TOGGLE);
+        else
+          startPlayback(now);
+        okMultiCount_ = 0;
+      }
+    }
+
+    // Commit after single/double tap when the window ends
+    if (okMultiCount_ > 0 && (now - okMultiStartMs_ > timing_.okMultiWindowMs))
+    {
+      if (okMultiCount_ < 3)
+      {
+        commitLetterIfAny(TRACE_COMMIT_OK);
+        listener_->onCommitPoint(KEYER_AT_OK);
+      }
+      okMultiCount_ = 0;
+    }
+  }
+
+  static void applyEdge(Key &k, int8_t ev, uint32_t now)
+  {
+    if (ev == +1)
+    {
+      k.down = true;
+      k.pressStartMs = now;
+    }
+    else if (ev == -1)
+      k.down = false;
+  }
+
+  // DOT/DASH only, and not while they are part of a memory chord
+  bool anyPressed() const
+  {
+    return (keys_[TRACE_KEY_DOT].down && !dotChord_) || (keys_[TRACE_KEY_DASH].down && !dashChord_);
+  }
+
+  // A chord key went down: the first one picks slot 1 or 2, the other one
+  // joining while it is held moves the chord to 3 or 4
+  void chordPress(bool &chord, uint8_t slot, uint32_t now)
+  {
+    if (!dotChord_ && !dashChord_)
+      chordSlot_ = slot;
+    else if (chordSlot_ < 2)
+      chordSlot_ += 2;
+    chord = okChordUsed_ = true;
+    chordPressMs_ = now;
+  }
+
+  // A chord key came up; the chord plays its slot once the last one is up,
+  // unless it was held long enough to record
+  void chordRelease(bool &chord, uint32_t now)
+  {
+    chord = false;
+    if (dotChord_ || dashChord_)
+      return;
+    if (!chordRecorded_)
+      listener_->onMemory(chordSlot_, false, now);
+    chordRecorded_ = false;
+  }
+
+  void setTone(bool on)
+  {
+    if (on == tone_)
+      return;
+    tone_ = on;
+    listener_->onTone(on);
+  }
+
+  void pushSymbol(char s)
+  {
+    if (symbolsLen_ < KEYER_SYMBOLS_MAX)
+    {
+      symbols_[symbolsLen_++] = s;
+      symbols_[symbolsLen_] = '\0';
+    }
+    trieNode_ = morseTrieNext(*codec_->trie, trieNode_, s);
+    listener_->onSymbol(s);
+    // The error prosign is often sent with more than eight dots: let it run on
+    if (timing_.earlyCommit && morseTrieComplete(*codec_->trie, trieNode_) && currentMatch() != MORSE_PROSIGN_ERROR)
+    {
+      commitLetterIfAny(TRACE_COMMIT_COMPLETE);
+      listener_->onCommitPoint(KEYER_AT_COMPLETE);
+    }
+  }
+
+  void pushChar(char c)
+  {
+    text_[textLen_++] = c;
+    if (textLen_ > KEYER_TEXT_MAX)
+    {
+      memmove(text_, text_ + 1, KEYER_TEXT_MAX);
+      textLen_ = KEYER_TEXT_MAX;
+      textWasTrimmed_ = true;
+      wordStart_ -= wordStart_ > 0;
+      prevWordStart_ -= prevWordStart_ > 0;
+    }
+    text_[textLen_] = '\0';
+  }
+
+  void pushSpaceIfNeeded()
+  {
+    if (textLen_ == 0 || text_[textLen_ - 1] == ' ')
+      return;
+    fixWord();
+    pushChar(' ');
+    prevWordStart_ = wordStart_;
+    wordStart_ = textLen_;
+    listener_->onSpace();
+  }
+
+  // Error prosign: drop the open word, or the one before it if nothing has
+  // been keyed since the space. Both starts are tracked, so this is a cut, not
+  // a scan; a second error right after has no earlier word to go back to.
+  void eraseWord()
+  {
+    size_t to = textLen_ > wordStart_ ? wordStart_ : prevWordStart_;
+    wordLen_ = 0;
+    if (to >= textLen_)
+      return;
+    listener_->onWordErased(text_ + to);
+    textLen_ = wordStart_ = prevWordStart_ = to;
+    text_[to] = '\0';
+  }
+
+  // The word just closed, if it is all still in text_ and short enough
+  void fixWord()
+  {
+    size_t len = wordLen_;
+    wordLen_ = 0;
+    if (timing_.wordFixMaxCost == 0 || len < 2 || len > MORSE_DICT_WORD_MAX || len > textLen_ ||
+        (len < textLen_ && text_[textLen_ - len - 1] != ' '))
+      return;
+    char *word = text_ + textLen_ - len;
+    char fixed[MORSE_DICT_WORD_MAX + 1];
+    if (!morseDictCorrect(word, wordConfidence_, len, timing_.wordFixMaxCost, fixed))
+      return;
+    char keyed[MORSE_DICT_WORD_MAX + 1];
+    memcpy(keyed, word, len);
+    keyed[len] = '\0';
+    memcpy(word, fixed, len);
+    listener_->onWordFixed(keyed, fixed);
+  }
+
+  void commitLetterIfAny(uint8_t reason)
+  {
+    if (symbolsLen_ == 0)
+      return;
+    if (trieNode_ && currentMatch())
+      lastGuess_ = {currentMatch(), '\0', 0, 100}; // = morseDecode(symbols_)
+    else if (symbolsLen_ > MORSE_TRIE_DEPTH && strspn(symbols_, ".") == symbolsLen_)
+      lastGuess_ = {MORSE_PROSIGN_ERROR, '\0', MORSE_COST_INDEL, 100}; // nobody counts the error's dots
+    else
+    {
+      lastGuess_ = morseNearest(*codec_->nearest, symbols_);
+      if (lastGuess_.confidence < timing_.guessMinConfidence)
+        lastGuess_.ch = '?';
+    }
+    char c = lastGuess_.ch;
+    if (c != MORSE_PROSIGN_ERROR)
+    {
+      if (wordLen_ < MORSE_DICT_WORD_MAX)
+        wordConfidence_[wordLen_] = lastGuess_.confidence;
+      wordLen_++;
+      pushChar(c);
+    }
+    memcpy(lastPattern_, symbols_, symbolsLen_ + 1);
+    listener_->onLetter(symbols_, c, reason);
+    if (c == MORSE_PROSIGN_ERROR)
+      eraseWord();
+    symbolsLen_ = 0;
+    symbols_[0] = '\0';
+    trieNode_ = MORSE_TRIE_ROOT;
+  }
+
+  void startStageFromIndex(uint32_t now)
+  {
+    playStageStart_ = now;
+    char s = playIndex_ < playLen_ ? playStages_[playIndex_] : '\0';
+    if (playIndex_ == 0 || s == '\0' || s == '|' || s == '/')
+    {
+      // letter boundary
+      playResumeIndex_ = playIndex_;
+      if (playYield_)
+      {
+        stopPlayback(KEYER_STOP_YIELD);
+        return;
+      }
+    }
+    if (s == '\0')
+    {
+      // end of message -> loop gap
+      playInLoopGap_ = true;
+      playToneOn_ = false;
+      playStageDur_ = timing_.play.loopMs;
+      setTone(false);
+      return;
+    }
+    playToneOn_ = morseStageIsTone(s);
+    playStageDur_ = morseStageMs(s, timing_.play);
+    setTone(playToneOn_);
+  }
+
+  void servicePlayback(uint32_t now)
+  {
+    if (now - playStageStart_ < playStageDur_)
+      return;
+    if (playInLoopGap_)
+    {
+      // loop gap finished: restart from the beginning, or stop after the last pass
+      playInLoopGap_ = false;
+      if (playPassesLeft_ != 0 && --playPassesLeft_ == 0)
+      {
+        stopPlayback(KEYER_STOP_DONE);
+        return;
+      }
+      playIndex_ = 0;
+    }
+    else
+    {
+      playIndex_++;
+    }
+    startStageFromIndex(now);
+  }
+
+  KeyerTiming timing_ = {};
+  const MorseCodec *codec_ = &MORSE_CODEC;
+  KeyerListener silent_;
+  KeyerListener *listener_ = &silent_;
+
+  Key keys_[3] = {};
+  bool prevAnyPressed_ = false;
+  uint32_t lastSilenceStartMs_ = 0;
+  bool tone_ = false;
+
+  // OK multi-click and memory chords
+  uint8_t okMultiCount_ = 0;
+  uint32_t okMultiStartMs_ = 0;
+  bool okClearLatched_ = false;
+  bool okChordUsed_ = false;   // suppresses commit/clear for this OK press
+  bool dotChord_ = false;      // DOT went down while OK was held
+  bool dashChord_ = false;     // DASH went down while OK was held
+  bool chordRecorded_ = false; // the chord was held long enough to record
+  uint8_t chordSlot_ = 0;      // slot the chord selects (0-based)
+  uint32_t chordPressMs_ = 0;  // latest chord key-down; recording times from here
+
+  // Text
+  char text_[KEYER_TEXT_MAX + 2] = {}; // room for one char past the cap before trimming
+  size_t textLen_ = 0;
+  bool textWasTrimmed_ = false;
+  char symbols_[KEYER_SYMBOLS_MAX + 1] = {}; // uncommitted pattern for the current letter
+  size_t symbolsLen_ = 0;
+  MorseTrieNode trieNode_ = MORSE_TRIE_ROOT; // symbols_ walked down the trie
+  MorseGuess lastGuess_ = {};
+  uint8_t wordConfidence_[MORSE_DICT_WORD_MAX] = {}; // per letter of the open word
+  size_t wordLen_ = 0;                               // letters since the last space
+  size_t wordStart_ = 0;                             // text_ index of the open word
+  size_t prevWordStart_ = 0;                         // ... and of the word before it
+  char lastPattern_[KEYER_SYMBOLS_MAX + 1] = {};
+
+  // Playback
+  bool playActive_ = false;
+  const char *playStages_ = ""; // playBuf_ or a program owned elsewhere
+  size_t playLen_ = 0;
+  size_t playIndex_ = 0;
+  uint32_t playStageStart_ = 0;
+  uint16_t playStageDur_ = 0;
+  bool playToneOn_ = false;
+  bool playInLoopGap_ = false;
+  uint8_t playPassesLeft_ = 0; // 0 = loop until stopped
+  size_t playResumeIndex_ = 0;
+  bool playYield_ = false;
+  char playBuf_[KEYER_TEXT_MAX * MORSE_STAGES_PER_CHAR + 1];
+};
@@ -0,0 +1,239 @@
+#pragma once
+// Koch-method trainer. Characters are learned in a fixed order, at full speed
+// from the start: groups of KOCH_GROUP_LEN random characters from the first
+// `level` of KOCH_ORDER are played, the operator keys each group back, and a
+// session of KOCH_SESSION_GROUPS groups at KOCH_ADVANCE_PCT or better adds
+// the next character. The newest character is drawn twice as often.
+//
+// The trainer only deals in text and times: the caller plays nextGroup(),
+// reports when it has been sent, and forwards key-downs, key-ups and
+// committed letters. Per character it keeps how often it was sent, how often
+// it came back right, and the response time: from the end of the group (or
+// the release that ended the previous letter) to the first key-down of the
+// letter. All of it is one fixed KochProgress, saved as it is.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "morse_table.h"
+#include "train_rng.h"
+
+const char KOCH_ORDER[] = "KMURESNAPTLWI.JZ=FOY,VG5/Q92H38B?47C1D60X";
+const size_t KOCH_CHARS = sizeof(KOCH_ORDER) - 1;
+const uint8_t KOCH_START_LEVEL = 2; // K and M
+const size_t KOCH_GROUP_LEN = 5;
+const uint8_t KOCH_SESSION_GROUPS = 10;
+const uint8_t KOCH_ADVANCE_PCT = 90;
+const uint16_t KOCH_LATENCY_MAX_MS = 10000; // longer waits are counted as this
+const uint8_t KOCH_PROGRESS_VERSION = 1;
+
+struct KochCharStats
+{
+  uint16_t sent;
+  uint16_t correct;
+  uint32_t latencySumMs; // over `timed` correct answers
+  uint16_t timed;
+  uint16_t latencyMaxMs;
+};
+
+struct KochProgress
+{
+  uint8_t version;
+  uint8_t level;     // characters in use, KOCH_START_LEVEL..KOCH_CHARS
+  uint16_t sessions; // completed
+  KochCharStats chars[KOCH_CHARS];
+};
+
+// Position in KOCH_ORDER, -1 if not a Koch character
+inline int kochIndex(char c)
+{
+  const char *p = c ? strchr(KOCH_ORDER, c) : nullptr;
+  return p ? (int)(p - KOCH_ORDER) : -1;
+}
+
+enum KochState : uint8_t
+{
+  KOCH_IDLE,    // between groups
+  KOCH_SENDING, // nextGroup() is being played
+  KOCH_ANSWER,  // waiting for it to be keyed back
+};
+
+class KochTrainer
+{
+public:
+  KochTrainer() { reset(); }
+
+  // Saved progress; anything that does not look like it starts over
+  void load(const KochProgress &p)
+  {
+    if (p.version != KOCH_PROGRESS_VERSION || p.level < KOCH_START_LEVEL || p.level > KOCH_CHARS)
+      reset();
+    else
+      progress_ = p;
+  }
+
+  void reset()
+  {
+    memset(&progress_, 0, sizeof(progress_));
+    progress_.version = KOCH_PROGRESS_VERSION;
+    progress_.level = KOCH_START_LEVEL;
+  }
+
+  void setLevel(uint8_t level)
+  {
+    progress_.level = level < KOCH_START_LEVEL ? KOCH_START_LEVEL : level > KOCH_CHARS ? (uint8_t)KOCH_CHARS : level;
+  }
+
+  // A new session of KOCH_SESSION_GROUPS groups
+  void start(uint32_t seed)
+  {
+    rng_.seed(seed);
+    state_ = KOCH_IDLE;
+    groups_ = sessionSent_ = sessionCorrect_ = 0;
+    advanced_ = false;
+  }
+
+  // Draw the next group (NUL-terminated) and wait for sent()
+  const char *nextGroup()
+  {
+    uint8_t level = progress_.level;
+    for (size_t i = 0; i < KOCH_GROUP_LEN; i++)
+    {
+      uint32_t r = rng_.below(level + 1u); // one extra draw for the newest character
+      group_[i] = KOCH_ORDER[r < level ? r : level - 1u];
+    }
+    group_[KOCH_GROUP_LEN] = '\0';
+    answerLen_ = 0;
+    answer_[0] = '\0';
+    state_ = KOCH_SENDING;
+    return group_;
+  }
+
+  // The group has been played: the answer is timed from endMs, the end of
+  // its last tone (or the key-down that cut it short)
+  void sent(uint32_t endMs)
+  {
+    state_ = KOCH_ANSWER;
+    refMs_ = lastMs_ = endMs;
+    letterOpen_ = false;
+    for (size_t i = 0; i < KOCH_GROUP_LEN; i++)
+      latency_[i] = KOCH_LATENCY_MAX_MS;
+  }
+
+  // DOT/DASH edges while answering; call after the keyer has seen the edge,
+  // so a letter committed by this key-down has already been reported
+  void keyDown(uint32_t now)
+  {
+    if (state_ != KOCH_ANSWER)
+      return;
+    lastMs_ = now;
+    if (letterOpen_)
+      return;
+    letterOpen_ = true;
+    if (answerLen_ < KOCH_GROUP_LEN)
+    {
+      uint32_t ms = now - refMs_;
+      latency_[answerLen_] = ms < KOCH_LATENCY_MAX_MS ? (uint16_t)ms : KOCH_LATENCY_MAX_MS;
+    }
+  }
+
+  void keyUp(uint32_t now)
+  {
+    if (state_ == KOCH_ANSWER)
+      refMs_ = lastMs_ = now;
+  }
+
+  // A letter the keyer committed. The error signal (HH) starts the answer
+  // over. True once the group has been keyed back and scored.
+  bool letter(char c, uint32_t now)
+  {
+    if (state_ != KOCH_ANSWER)
+      return false;
+    lastMs_ = now;
+    letterOpen_ = false;
+    if (c == MORSE_PROSIGN_ERROR)
+    {
+      answerLen_ = 0;
+      answer_[0] = '\0';
+      return false;
+    }
+    answer_[answerLen_++] = c;
+    answer_[answerLen_] = '\0';
+    if (answerLen_ < KOCH_GROUP_LEN)
+      return false;
+    score();
+    return true;
+  }
+
+  // End the answer early (word gap, timeout): missing letters are wrong
+  void close()
+  {
+    if (state_ == KOCH_ANSWER)
+      score();
+  }
+
+  KochState state() const { return state_; }
+  const char *group() const { return group_; }
+  const char *answer() const { return answer_; }
+  size_t answerLen() const { return answerLen_; }
+  uint32_t lastActivityMs() const { return lastMs_; }
+  uint8_t lastCorrect() const { return lastCorrect_; }
+  uint8_t groups() const { return groups_; }
+  bool sessionDone() const { return groups_ >= KOCH_SESSION_GROUPS; }
+  uint8_t sessionPct() const { return sessionSent_ ? (uint8_t)(sessionCorrect_ * 100u / sessionSent_) : 0; }
+  bool advanced() const { return advanced_; } // the finished session added a character
+  uint8_t level() const { return progress_.level; }
+  const KochProgress &progress() const { return progress_; }
+
+private:
+  void score()
+  {
+    lastCorrect_ = 0;
+    for (size_t i = 0; i < KOCH_GROUP_LEN; i++)
+    {
+      int k = kochIndex(group_[i]);
+      if (k < 0)
+        continue;
+      KochCharStats &st = progress_.chars[k];
+      st.sent++;
+      if (i >= answerLen_ || answer_[i] != group_[i])
+        continue;
+      st.correct++;
+      lastCorrect_++;
+      st.latencySumMs += latency_[i];
+      st.timed++;
+      if (latency_[i] > st.latencyMaxMs)
+        st.latencyMaxMs = latency_[i];
+    }
+    sessionSent_ += KOCH_GROUP_LEN;
+    sessionCorrect_ += lastCorrect_;
+    state_ = KOCH_IDLE;
+    if (++groups_ == KOCH_SESSION_GROUPS)
+    {
+      progress_.sessions++;
+      if (sessionPct() >= KOCH_ADVANCE_PCT && progress_.level < KOCH_CHARS)
+      {
+        progress_.level++;
+        advanced_ = true;
+      }
+    }
+  }
+
+  KochProgress progress_;
+  TrainRng rng_;
+  KochState state_ = KOCH_IDLE;
+  char group_[KOCH_GROUP_LEN + 1] = {};
+  char answer_[KOCH_GROUP_LEN + 1] = {};
+  size_t answerLen_ = 0;
+  uint16_t latency_[KOCH_GROUP_LEN] = {};
+  uint32_t refMs_ = 0;  // latency is measured from here: group sent, or last key-up
+  uint32_t lastMs_ = 0; // last answer activity, for the caller's timeout
+  bool letterOpen_ = false;
+  uint8_t lastCorrect_ = 0;
+  uint8_t groups_ = 0;
+  uint16_t sessionSent_ = 0;
+  uint16_t sessionCorrect_ = 0;
+  bool advanced_ = false;
+};
@@ -0,0 +1,46 @@
+#pragma once
+// Everything decoding and encoding needs for one alphabet, as three pointers
+// into flash: the table, its trie and its nearest-guess index. The keyer reads
+// through a MorseCodec, so switching alphabets while running is swapping one
+// pointer; the lookups themselves are the same code for every table.
+//
+// MORSE_CODEC is the MORSE_ALPHABET build. morseCodec() has all of them; the
+// extra tables are only built (and only take flash) if something calls it.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include "morse_table.h"
+#include "morse_trie.h"
+#include "morse_nearest.h"
+
+struct MorseCodec
+{
+  const MorseAlphabet *alphabet;
+  const MorseTrie *trie;
+  const MorseNearestIndex *nearest;
+};
+
+constexpr MorseCodec MORSE_CODEC = {&MORSE_DEFAULT_ALPHABET, &MORSE_TRIE, &MORSE_NEAREST};
+
+// Codec of MORSE_ALPHABETS[i]; the build's own for an unknown index
+inline const MorseCodec &morseCodec(size_t i)
+{
+  static constexpr MorseCodec CODECS[] = {
+      {&MORSE_ALPHABETS[0], &MORSE_TRIE_OF<0>, &MORSE_NEAREST_OF<0>},
+      {&MORSE_ALPHABETS[1], &MORSE_TRIE_OF<1>, &MORSE_NEAREST_OF<1>},
+      {&MORSE_ALPHABETS[2], &MORSE_TRIE_OF<2>, &MORSE_NEAREST_OF<2>},
+      {&MORSE_ALPHABETS[3], &MORSE_TRIE_OF<3>, &MORSE_NEAREST_OF<3>},
+  };
+  static_assert(sizeof(CODECS) / sizeof(CODECS[0]) == MORSE_ALPHABET_COUNT, "one codec per alphabet");
+  return CODECS[i < MORSE_ALPHABET_COUNT ? i : MORSE_ALPHABET];
+}
+
+// Alphabet index by name (case as in MORSE_ALPHABETS), MORSE_ALPHABET_COUNT if none
+inline size_t morseAlphabetIndex(const char *name)
+{
+  size_t i = 0;
+  while (i < MORSE_ALPHABET_COUNT && strcmp(name, MORSE_ALPHABETS[i].name) != 0)
+    i++;
+  return i;
+}
@@ -0,0 +1,312 @@
+#pragma once
+// Word dictionary for correcting keyed words, as a DAWG (directed acyclic word
+// graph) built at compile time and kept in flash.
+//
+// The word list becomes a letter trie, then equal edge lists are merged from
+// the leaves up, so shared endings (-ING, -S, -ED, QR?) are stored once. Each
+// node is a run of edges, one uint32_t each: letter, "a word ends here",
+// "last edge of this node" and the index of the child's run. Walking a word
+// needs only the current run index; there is nothing in RAM.
+//
+// Correction: a closed word that is not in the dictionary is matched against
+// the dictionary words of the same length. Each changed letter costs the edit
+// distance between the two Morse codes (morse_nearest.h), weighted by how
+// sure the keyer was of that letter, so a low-confidence guess gives way
+// more easily than a clean code. The cheapest word under a limit wins if it
+// is the only one at that cost.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "morse_table.h"
+#include "morse_nearest.h"
+
+// Upper case, single spaces. Common English, plus the abbreviations and Q
+// codes of a typical CW contact.
+constexpr char MORSE_DICT_WORDS[] =
+    "A ABOUT AFTER AGAIN ALL ALSO AM AN AND ANY ARE AS AT BACK BE BECAUSE BEEN BEFORE BUT BY CALL CAME CAN "
+    "CODE COME COULD DAY DID DO DOWN EACH EVEN FIND FIRST FOR FROM GET GIVE GO GOOD GREAT HAD HAS HAVE HE "
+    "HELLO HER HERE HIM HIS HOME HOW I IF IN INTO IS IT ITS JUST KEY KNOW LIKE LITTLE LONG LOOK MADE MAKE "
+    "MANY ME MORE MORSE MOST MUCH MUST MY NAME NEW NEXT NO NOT NOW NUMBER OF OFF OLD ON ONE ONLY OR OTHER "
+    "OUR OUT OVER PARIS PEOPLE PLEASE RADIO RIGHT SAID SAME SEE SHE SHOULD SIGNAL SO SOME SOS SOUND STILL "
+    "SUCH TAKE TELL TEST THAN THANK THANKS THAT THE THEIR THEM THEN THERE THESE THEY THING THINK THIS TIME "
+    "TO TODAY TWO UP US USE VERY WANT WAS WATER WAY WE WELL WENT WERE WHAT WHEN WHERE WHICH WHILE WHO WILL "
+    "WITH WORD WORDS WORK WORLD WOULD WRITE YEAR YES YOU YOUR "
+    "ABT AGN ANT BK CFM CL CPY CQ CUL DE DX ES FB FER GA GB GE GL GM GN HI HPE HR HW K KN OM OP PSE PWR "
+    "QRL QRM QRN QRO QRP QRQ QRS QRT QRU QRV QRX QRZ QSB QSL QSO QSY QTH R RIG RPT RR RST SK SRI TKS TNX "
+    "TU UR VY WX XYL YL 5NN 599 73 88";
+
+const size_t MORSE_DICT_WORD_MAX = 12;    // longer words are never looked up
+const uint16_t MORSE_DICT_NONE = 0xFFFF; // no edge run (no child, no match)
+
+// Edge word: bits 0-7 letter, bit 8 word ends, bit 9 last edge, 16-31 child run
+const uint32_t MORSE_DICT_END = 1u << 8;
+const uint32_t MORSE_DICT_LAST = 1u << 9;
+
+// ---- Build (compile time only) ----
+
+const size_t MORSE_DICT_TRIE_MAX = 1024; // trie nodes for the word list
+
+struct MorseDictTrie
+{
+  char letter[MORSE_DICT_TRIE_MAX];
+  bool final[MORSE_DICT_TRIE_MAX];
+  uint16_t child[MORSE_DICT_TRIE_MAX];   // first child, letters ascending
+  uint16_t sibling[MORSE_DICT_TRIE_MAX]; // next child of the same parent
+  size_t nodes;
+};
+
+constexpr MorseDictTrie morseDictBuildTrie(const char *words)
+{
+  MorseDictTrie t = {};
+  t.child[0] = t.sibling[0] = MORSE_DICT_NONE;
+  t.nodes = 1; // root
+  for (const char *p = words; *p;)
+  {
+    uint16_t node = 0;
+    for (; *p && *p != ' '; p++)
+    {
+      // find or insert *p among node's children, kept sorted
+      uint16_t *link = &t.child[node];
+      while (*link != MORSE_DICT_NONE && t.letter[*link] < *p)
+        link = &t.sibling[*link];
+      if (*link == MORSE_DICT_NONE || t.letter[*link] != *p)
+      {
+        if (t.nodes >= MORSE_DICT_TRIE_MAX)
+        {
+          t.nodes = MORSE_DICT_TRIE_MAX + 1; // caught by the static_assert below
+          return t;
+        }
+        uint16_t n = (uint16_t)t.nodes++;
+        t.letter[n] = *p;
+        t.child[n] = MORSE_DICT_NONE;
+        t.sibling[n] = *link;
+        *link = n;
+      }
+      node = *link;
+    }
+    t.final[node] = true;
+    while (*p == ' ')
+      p++;
+  }
+  return t;
+}
+
+// Which node's edge run each node reuses, and where each run starts
+struct MorseDictLayout
+{
+  uint16_t rep[MORSE_DICT_TRIE_MAX];   // node whose run this node shares
+  uint16_t start[MORSE_DICT_TRIE_MAX]; // run index of a representative
+  size_t edges;
+};
+
+constexpr bool morseDictSameRun(const MorseDictTrie &t, const MorseDictLayout &l, uint16_t a, uint16_t b)
+{
+  uint16_t x = t.child[a], y = t.child[b];
+  for (; x != MORSE_DICT_NONE && y != MORSE_DICT_NONE; x = t.sibling[x], y = t.sibling[y])
+    if (t.letter[x] != t.letter[y] || t.final[x] != t.final[y] || l.start[l.rep[x]] != l.start[l.rep[y]])
+      return false;
+  return x == y;
+}
+
+// Children are always numbered after their parent, so walking the nodes
+// backwards sees every child's run before the parent's. Equal runs are found
+// through a hash of (letter, ends, child run) over the edges.
+constexpr MorseDictLayout morseDictLayout(const MorseDictTrie &t)
+{
+  MorseDictLayout l = {};
+  const size_t HASH = 2 * MORSE_DICT_TRIE_MAX;
+  uint16_t table[HASH] = {};
+  for (size_t i = 0; i < HASH; i++)
+    table[i] = MORSE_DICT_NONE;
+  for (size_t n = t.nodes; n-- > 0;)
+  {
+    l.rep[n] = (uint16_t)n;
+    l.start[n] = MORSE_DICT_NONE;
+    if (t.child[n] == MORSE_DICT_NONE)
+      continue;
+    uint32_t h = 0, degree = 0;
+    for (uint16_t c = t.child[n]; c != MORSE_DICT_NONE; c = t.sibling[c], degree++)
+      h = (h * 31u + (uint8_t)t.letter[c]) * 31u + t.final[c] * 7u + l.start[l.rep[c]];
+    size_t slot = h % HASH;
+    while (table[slot] != MORSE_DICT_NONE && !morseDictSameRun(t, l, table[slot], (uint16_t)n))
+      slot = (slot + 1) % HASH;
+    if (table[slot] != MORSE_DICT_NONE)
+    {
+      l.rep[n] = table[slot];
+      continue;
+    }
+    table[slot] = (uint16_t)n;
+    l.start[n] = (uint16_t)l.edges;
+    l.edges += degree;
+  }
+  return l;
+}
+
+template <size_t Edges>
+struct MorseDawg
+{
+  uint32_t edge[Edges];
+  uint16_t root; // run of the first letters
+};
+
+template <size_t Edges>
+constexpr MorseDawg<Edges> morseDictPack(const MorseDictTrie &t, const MorseDictLayout &l)
+{
+  MorseDawg<Edges> d = {};
+  for (size_t n = 0; n < t.nodes; n++)
+  {
+    if (l.rep[n] != n || l.start[n] == MORSE_DICT_NONE)
+      continue;
+    size_t e = l.start[n];
+    for (uint16_t c = t.child[n]; c != MORSE_DICT_NONE; c = t.sibling[c], e++)
+      d.edge[e] = (uint32_t)(uint8_t)t.letter[c] | (t.final[c] ? MORSE_DICT_END : 0) |
+                  (t.sibling[c] == MORSE_DICT_NONE ? MORSE_DICT_LAST : 0) | ((uint32_t)l.start[l.rep[c]] << 16);
+  }
+  d.root = l.start[0];
+  return d;
+}
+
+constexpr MorseDictTrie MORSE_DICT_TRIE = morseDictBuildTrie(MORSE_DICT_WORDS);
+static_assert(MORSE_DICT_TRIE.nodes <= MORSE_DICT_TRIE_MAX, "MORSE_DICT_TRIE_MAX too small for the word list");
+constexpr MorseDictLayout MORSE_DICT_LAYOUT = morseDictLayout(MORSE_DICT_TRIE);
+constexpr auto MORSE_DICT = morseDictPack<MORSE_DICT_LAYOUT.edges>(MORSE_DICT_TRIE, MORSE_DICT_LAYOUT);
+
+// ---- Lookup ----
+
+// Edge for letter c in the run starting at `run`, MORSE_DICT_NONE if absent
+inline uint16_t morseDictEdge(uint16_t run, char c)
+{
+  if (run == MORSE_DICT_NONE)
+    return MORSE_DICT_NONE;
+  for (uint16_t e = run;; e++)
+  {
+    uint32_t w = MORSE_DICT.edge[e];
+    char l = (char)(w & 0xFF);
+    if (l == c)
+      return e;
+    if (l > c || (w & MORSE_DICT_LAST))
+      return MORSE_DICT_NONE;
+  }
+}
+
+inline uint16_t morseDictChild(uint16_t edge) { return (uint16_t)(MORSE_DICT.edge[edge] >> 16); }
+
+inline bool morseDictContains(const char *word, size_t len)
+{
+  uint16_t run = MORSE_DICT.root, e = MORSE_DICT_NONE;
+  for (size_t i = 0; i < len; i++)
+  {
+    e = morseDictEdge(run, word[i]);
+    if (e == MORSE_DICT_NONE)
+      return false;
+    run = morseDictChild(e);
+  }
+  return e != MORSE_DICT_NONE && (MORSE_DICT.edge[e] & MORSE_DICT_END);
+}
+
+// ---- Correction ----
+
+constexpr char MORSE_DICT_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+const size_t MORSE_DICT_ALPHABET_LEN = sizeof(MORSE_DICT_ALPHABET) - 1;
+
+constexpr int morseDictLetterIndex(char c)
+{
+  return c >= 'A' && c <= 'Z' ? c - 'A' : c >= '0' && c <= '9' ? 26 + (c - '0') : -1;
+}
+
+// Morse edit cost between any two dictionary letters
+struct MorseLetterCost
+{
+  uint8_t cost[MORSE_DICT_ALPHABET_LEN][MORSE_DICT_ALPHABET_LEN];
+};
+
+constexpr MorseLetterCost morseBuildLetterCost()
+{
+  MorseLetterCost m = {};
+  for (size_t i = 0; i < MORSE_DICT_ALPHABET_LEN; i++)
+    for (size_t j = 0; j < MORSE_DICT_ALPHABET_LEN; j++)
+      m.cost[i][j] = morseEditCost(morseEncode(MORSE_DICT_ALPHABET[i], MORSE_ALPHABETS[MORSE_ALPHABET_LATIN]),
+                                   morseEncode(MORSE_DICT_ALPHABET[j], MORSE_ALPHABETS[MORSE_ALPHABET_LATIN]));
+  return m;
+}
+
+constexpr MorseLetterCost MORSE_LETTER_COST = morseBuildLetterCost();
+
+// Cost of reading `keyed` (decoded with `confidence`, 0..100) as `cand`. A
+// clean code costs three times what a zero-confidence guess does, so with a
+// small limit only words holding a guess get corrected; an unresolved '?'
+// can be any letter for one substitution.
+inline uint16_t morseDictSubstCost(char keyed, uint8_t confidence, char cand)
+{
+  if (keyed == cand)
+    return 0;
+  int k = morseDictLetterIndex(keyed), c = morseDictLetterIndex(cand);
+  if (c < 0)
+    return 0xFFFF;
+  if (k < 0)
+    return keyed == '?' ? MORSE_COST_SUBST : 0xFFFF;
+  return (uint16_t)(MORSE_LETTER_COST.cost[k][c] * (100u + 2u * confidence) / 100u);
+}
+
+struct MorseDictSearch
+{
+  const char *word;
+  const uint8_t *confidence;
+  size_t len;
+  uint16_t maxCost;
+  uint16_t best;
+  uint8_t tiesAtBest; // words at that cost, saturating at 2 (only "one" matters)
+  char path[MORSE_DICT_WORD_MAX];
+  char *out;
+};
+
+inline void morseDictWalk(MorseDictSearch &s, uint16_t run, size_t depth, uint16_t cost)
+{
+  if (run == MORSE_DICT_NONE)
+    return;
+  for (uint16_t e = run;; e++)
+  {
+    uint32_t w = MORSE_DICT.edge[e];
+    char l = (char)(w & 0xFF);
+    uint16_t sub = morseDictSubstCost(s.word[depth], s.confidence[depth], l);
+    uint32_t c = (uint32_t)cost + sub;
+    if (c <= s.maxCost && c <= s.best)
+    {
+      s.path[depth] = l;
+      if (depth + 1 < s.len)
+        morseDictWalk(s, (uint16_t)(w >> 16), depth + 1, (uint16_t)c);
+      else if (w & MORSE_DICT_END)
+      {
+        if (c < s.best)
+        {
+          s.best = (uint16_t)c;
+          s.tiesAtBest = 0;
+          memcpy(s.out, s.path, s.len);
+          s.out[s.len] = '\0';
+        }
+        if (s.tiesAtBest < 2)
+          s.tiesAtBest++;
+      }
+    }
+    if (w & MORSE_DICT_LAST)
+      break;
+  }
+}
+
+// Best dictionary word for word[len] (confidence[i] per letter) within
+// maxCost into out[len + 1]. False if the word is already in the dictionary,
+// nothing is close enough or two words tie for the best cost.
+inline bool morseDictCorrect(const char *word, const uint8_t *confidence, size_t len, uint16_t maxCost, char *out,
+                             uint16_t *costOut = nullptr)
+{
+  if (len == 0 || len > MORSE_DICT_WORD_MAX || morseDictContains(word, len))
+    return false;
+  MorseDictSearch s = {word, confidence, len, maxCost, 0xFFFF, 0, {}, out};
+  morseDictWalk(s, MORSE_DICT.root, 0, 0);
+  if (costOut)
+    *costOut = s.best;
+  return s.best <= maxCost && s.tiesAtBest == 1;
+}
@@ -0,0 +1,328 @@
+#pragma once
+// Streaming HMM decoder for hand-sent Morse with irregular timing. Instead of
+// fixed gap thresholds it finds the most likely reading of a whole run of
+// mark and space durations.
+//
+// Hidden state per observation = (element class, sender speed). A mark is a
+// dot (1u) or a dash (3u), a space an element gap (1u), a letter gap (3u) or
+// a word gap (7u). The speed is one of MORSE_HMM_SPEEDS unit lengths, log
+// spaced, and may drift one step between observations. A duration d under
+// class k at unit u scores as a log-normal around k*u, so a 2u gap is weighed
+// between "long element gap" and "short letter gap" by the speed the rest of
+// the run implies.
+//
+// Viterbi with a fixed lag: backpointers live in a ring of Window
+// observations, and once it is full the oldest observation is settled by
+// tracing back from the current best state. A long silence flushes the rest.
+// Memory is fixed (about Window * 48 bytes); a step is a few hundred float
+// operations.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "morse_nearest.h"
+
+const size_t MORSE_HMM_SPEEDS = 16;         // unit lengths from ..._MIN_UNIT_MS to ..._MAX_UNIT_MS
+const float MORSE_HMM_MIN_UNIT_MS = 20.0f;  // 60 WPM
+const float MORSE_HMM_MAX_UNIT_MS = 240.0f; // 5 WPM
+const float MORSE_HMM_FLUSH_UNITS = 10.0f;  // silence that ends a transmission
+
+enum MorseHmmClass : uint8_t
+{
+  MORSE_HMM_DOT = 0, // marks
+  MORSE_HMM_DASH = 1,
+  MORSE_HMM_GAP_ELEMENT = 0, // spaces
+  MORSE_HMM_GAP_LETTER = 1,
+  MORSE_HMM_GAP_WORD = 2,
+};
+
+struct MorseHmmModel
+{
+  float units;    // nominal length in units
+  float sigma;    // spread of ln(duration)
+  float logPrior; // how common the class is
+};
+
+// Marks: dot, dash. Spaces: element, letter, word gap. Hand senders stretch
+// and squeeze gaps more than marks.
+const MorseHmmModel MORSE_HMM_MARKS[2] = {{1, 0.30f, -0.6f}, {3, 0.30f, -0.8f}};
+const MorseHmmModel MORSE_HMM_SPACES[3] = {{1, 0.40f, -0.5f}, {3, 0.40f, -1.1f}, {7, 0.45f, -2.3f}};
+const float MORSE_HMM_SPEED_STEP = -3.0f; // log cost of moving one speed bin
+const float MORSE_HMM_HINT_MISS = -12.0f; // mark class disagrees with the key that sent it
+
+template <size_t Window = 32>
+class MorseHmm
+{
+public:
+  static const size_t CLASSES = 3; // most classes per observation
+  static const size_t STATES = CLASSES * MORSE_HMM_SPEEDS;
+  static const size_t OUT_CAP = 32; // decoded characters waiting to be read
+
+  // Start over, expecting a sender near unitMs
+  void reset(float unitMs)
+  {
+    for (size_t s = 0; s < MORSE_HMM_SPEEDS; s++)
+      lnUnit_[s] = logf(MORSE_HMM_MIN_UNIT_MS) +
+                   (logf(MORSE_HMM_MAX_UNIT_MS) - logf(MORSE_HMM_MIN_UNIT_MS)) * (float)s / (MORSE_HMM_SPEEDS - 1);
+    // per-class log means and constant terms, so a step needs one logf()
+    for (size_t k = 0; k < 2 + 3; k++)
+    {
+      const MorseHmmModel &m = k < 2 ? MORSE_HMM_MARKS[k] : MORSE_HMM_SPACES[k - 2];
+      invSigma_[k] = 1.0f / m.sigma;
+      bias_[k] = m.logPrior - logf(m.sigma);
+      for (size_t s = 0; s < MORSE_HMM_SPEEDS; s++)
+        mean_[k][s] = lnUnit_[s] + logf(m.units);
+    }
+    bestSpeed_ = nearestSpeed(unitMs);
+    pending_ = 0;
+    symLen_ = 0;
+    outHead_ = outTail_ = 0;
+    keysDown_ = 0;
+    markOpen_ = silenceOpen_ = false;
+    observations_ = 0;
+  }
+
+  // Letters are read through this alphabet's index (the keyer's codec)
+  void setNearest(const MorseNearestIndex &idx) { nearest_ = &idx; }
+
+  // ---- Key edges (times in ms). hint: MORSE_HMM_DOT/DASH for the key that
+  // went down, -1 if the key does not say (straight key, audio) ----
+  void keyDown(uint32_t t, int8_t hint)
+  {
+    if (keysDown_++ > 0)
+    {
+      if (hint != markHint_)
+        markHint_ = -1; // both paddles in one mark
+      return;
+    }
+    if (silenceOpen_)
+      observe(false, t - edgeMs_, -1);
+    markOpen_ = true;
+    silenceOpen_ = false;
+    markHint_ = hint;
+    edgeMs_ = t;
+  }
+
+  void keyUp(uint32_t t)
+  {
+    if (keysDown_ == 0 || --keysDown_ > 0)
+      return;
+    observe(true, t - edgeMs_, markHint_);
+    markOpen_ = false;
+    silenceOpen_ = true;
+    edgeMs_ = t;
+  }
+
+  // Settles everything once the key has been up for MORSE_HMM_FLUSH_UNITS
+  void poll(uint32_t now)
+  {
+    if (silenceOpen_ && (float)(now - edgeMs_) >= MORSE_HMM_FLUSH_UNITS * unitMs())
+      flush(now);
+  }
+
+  // End of transmission: the open silence counts as a word gap candidate and
+  // every pending observation is decided
+  void flush(uint32_t now)
+  {
+    if (silenceOpen_)
+      observe(false, now - edgeMs_, -1);
+    silenceOpen_ = false;
+    if (pending_ == 0)
+      return;
+    uint8_t path[Window];
+    traceBack(bestState(), pending_, path);
+    for (size_t i = pending_; i-- > 0;)
+      emit(kind_[slot(i)], path[i]);
+    if (kind_[slot(0)]) // ended on a mark: close the letter
+      emitClass(false, MORSE_HMM_GAP_LETTER);
+    pending_ = 0;
+  }
+
+  // ---- Raw durations, alternating mark, space, mark... ----
+  void observe(bool isMark, uint32_t durMs, int8_t hint)
+  {
+    float lnd = logf(durMs > 0 ? (float)durMs : 1.0f);
+    size_t classes = isMark ? 2 : 3;
+    size_t model = isMark ? 0 : 2; // first row of mean_ / bias_
+
+    // best predecessor per speed, any class
+    float prevBest[MORSE_HMM_SPEEDS];
+    uint8_t prevArg[MORSE_HMM_SPEEDS];
+    for (size_t s = 0; s < MORSE_HMM_SPEEDS; s++)
+    {
+      if (pending_ == 0)
+      {
+        // first observation: prior around the last known speed
+        int d = (int)s - (int)bestSpeed_;
+        prevBest[s] = MORSE_HMM_SPEED_STEP * 0.5f * (float)(d < 0 ? -d : d);
+        prevArg[s] = 0xFF;
+        continue;
+      }
+      prevBest[s] = score_[s];
+      prevArg[s] = (uint8_t)s;
+      for (size_t c = 1; c < CLASSES; c++)
+        if (score_[c * MORSE_HMM_SPEEDS + s] > prevBest[s])
+        {
+          prevBest[s] = score_[c * MORSE_HMM_SPEEDS + s];
+          prevArg[s] = (uint8_t)(c * MORSE_HMM_SPEEDS + s);
+        }
+    }
+
+    // free the oldest ring slot first: it is settled now
+    if (pending_ == Window)
+    {
+      uint8_t path[Window];
+      traceBack(bestState(), Window, path);
+      emit(kind_[slot(Window - 1)], path[Window - 1]);
+      pending_--;
+    }
+    head_ = (head_ + 1) % Window;
+    kind_[head_] = isMark;
+    uint8_t *bp = back_[head_];
+
+    float next[STATES];
+    float top = -INFINITY;
+    for (size_t s = 0; s < MORSE_HMM_SPEEDS; s++)
+    {
+      // stay or drift one bin
+      float from = prevBest[s];
+      uint8_t arg = prevArg[s];
+      if (s > 0 && prevBest[s - 1] + MORSE_HMM_SPEED_STEP > from)
+      {
+        from = prevBest[s - 1] + MORSE_HMM_SPEED_STEP;
+        arg = prevArg[s - 1];
+      }
+      if (s + 1 < MORSE_HMM_SPEEDS && prevBest[s + 1] + MORSE_HMM_SPEED_STEP > from)
+      {
+        from = prevBest[s + 1] + MORSE_HMM_SPEED_STEP;
+        arg = prevArg[s + 1];
+      }
+      for (size_t c = 0; c < CLASSES; c++)
+      {
+        size_t j = c * MORSE_HMM_SPEEDS + s;
+        bp[j] = arg;
+        if (c >= classes)
+        {
+          next[j] = -INFINITY;
+          continue;
+        }
+        float x = (lnd - mean_[model + c][s]) * invSigma_[model + c];
+        float v = from + bias_[model + c] - 0.5f * x * x;
+        if (isMark && hint >= 0 && hint != (int8_t)c)
+          v += MORSE_HMM_HINT_MISS;
+        next[j] = v;
+        if (v > top)
+          top = v;
+      }
+    }
+    for (size_t j = 0; j < STATES; j++)
+      score_[j] = next[j] - top; // keep the best at 0
+    pending_++;
+    observations_++;
+    bestSpeed_ = (uint8_t)(bestState() % MORSE_HMM_SPEEDS);
+  }
+
+  // ---- Output ----
+  bool read(char &c)
+  {
+    if (outTail_ == outHead_)
+      return false;
+    c = out_[outTail_ % OUT_CAP];
+    outTail_++;
+    return true;
+  }
+
+  // Current best speed estimate
+  float unitMs() const { return expf(lnUnit_[bestSpeed_]); }
+  uint32_t observations() const { return observations_; }
+  size_t pending() const { return pending_; }
+  bool markOpen() const { return markOpen_; }
+
+private:
+  // Ring slot of the observation `age` steps before the newest
+  size_t slot(size_t age) const { return (head_ + Window - age) % Window; }
+
+  size_t bestState() const
+  {
+    size_t best = 0;
+    for (size_t j = 1; j < STATES; j++)
+      if (score_[j] > score_[best])
+        best = j;
+    return best;
+  }
+
+  // path[age] = state of the observation `age` steps back, for age < n
+  void traceBack(size_t state, size_t n, uint8_t *path) const
+  {
+    for (size_t age = 0; age < n; age++)
+    {
+      path[age] = (uint8_t)state;
+      state = back_[slot(age)][state];
+    }
+  }
+
+  uint8_t nearestSpeed(float unitMs) const
+  {
+    float ln = logf(unitMs > 1.0f ? unitMs : 1.0f);
+    uint8_t best = 0;
+    for (size_t s = 1; s < MORSE_HMM_SPEEDS; s++)
+      if (fabsf(lnUnit_[s] - ln) < fabsf(lnUnit_[best] - ln))
+        best = (uint8_t)s;
+    return best;
+  }
+
+  void emit(bool isMark, uint8_t state) { emitClass(isMark, (uint8_t)(state / MORSE_HMM_SPEEDS)); }
+
+  void emitClass(bool isMark, uint8_t c)
+  {
+    if (isMark)
+    {
+      if (symLen_ < sizeof(sym_) - 1)
+        sym_[symLen_++] = c == MORSE_HMM_DASH ? '-' : '.';
+      return;
+    }
+    if (c == MORSE_HMM_GAP_ELEMENT || symLen_ == 0)
+      return;
+    sym_[symLen_] = '\0';
+    put(morseNearest(*nearest_, sym_).ch);
+    symLen_ = 0;
+    if (c == MORSE_HMM_GAP_WORD)
+      put(' ');
+  }
+
+  void put(char c)
+  {
+    if (outHead_ - outTail_ >= OUT_CAP)
+      outTail_++; // reader fell behind: drop the oldest
+    out_[outHead_ % OUT_CAP] = c;
+    outHead_++;
+  }
+
+  const MorseNearestIndex *nearest_ = &MORSE_NEAREST;
+  float lnUnit_[MORSE_HMM_SPEEDS] = {};
+  float mean_[2 + 3][MORSE_HMM_SPEEDS] = {}; // marks, then spaces
+  float invSigma_[2 + 3] = {};
+  float bias_[2 + 3] = {};
+  float score_[STATES] = {};
+  uint8_t back_[Window][STATES] = {}; // best previous state, per slot and state
+  bool kind_[Window] = {};            // slot holds a mark (else a space)
+  size_t head_ = 0;
+  size_t pending_ = 0; // observations not yet emitted
+  uint8_t bestSpeed_ = 0;
+  uint32_t observations_ = 0;
+
+  // key edges -> durations
+  uint8_t keysDown_ = 0;
+  int8_t markHint_ = -1;
+  bool markOpen_ = false;
+  bool silenceOpen_ = false;
+  uint32_t edgeMs_ = 0;
+
+  // letter being assembled from settled marks
+  char sym_[16] = {};
+  size_t symLen_ = 0;
+  char out_[OUT_CAP] = {};
+  uint32_t outHead_ = 0, outTail_ = 0;
+};
@@ -0,0 +1,59 @@
+#pragma once
+// Compile-time Morse messages: a string literal becomes a finished stage
+// program (see morse_stages.h) during compilation. The result is a constexpr
+// object, so on the ESP32 it lands in flash (.rodata) and the player reads it
+// in place: no encoding at runtime and no RAM.
+//
+//   constexpr auto CQ = MORSE_PROGRAM("CQ CQ DE JRCSRG K");
+//   const auto &SOS = "SOS"_morse;  // one shared flash copy per literal
+//
+// Both forms run the same morseBuildStagesFromText() the device uses, so a
+// baked message plays exactly like the same text typed in.
+
+#include <stddef.h>
+#include "morse_stages.h"
+
+// ================= Compiled program =================
+template <size_t N>
+struct MorseProgram
+{
+  char stages[N + 1]; // NUL-terminated
+
+  constexpr const char *data() const { return stages; }
+  constexpr size_t size() const { return N; }
+};
+
+template <size_t N>
+constexpr MorseProgram<N> morseCompile(const char *msg)
+{
+  MorseProgram<N> p{};
+  morseBuildStagesFromText(msg, p.stages, N + 1);
+  return p;
+}
+
+// Stage count of a message, evaluated by the compiler
+#define MORSE_STAGE_COUNT(text) morseBuildStagesFromText(text, nullptr, (size_t)-1)
+
+#define MORSE_PROGRAM(text) morseCompile<MORSE_STAGE_COUNT(text)>(text)
+
+// ================= "..."_morse literal =================
+// String-literal operator templates are a GNU extension (GCC and Clang).
+template <char... Cs>
+struct MorseLiteral
+{
+  static constexpr char text[] = {Cs..., '\0'};
+  static constexpr size_t N = MORSE_STAGE_COUNT(text);
+  static constexpr MorseProgram<N> program = morseCompile<N>(text);
+};
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#if defined(__clang__)
+#pragma GCC diagnostic ignored "-Wgnu-string-literal-operator-template"
+#endif
+template <typename C, C... Cs>
+constexpr const auto &operator""_morse()
+{
+  return MorseLiteral<Cs...>::program;
+}
+#pragma GCC diagnostic pop
@@ -0,0 +1,230 @@
+#pragma once
+// Error-tolerant decoding. Every pattern of up to MORSE_NEAREST_DEPTH elements
+// has a slot (the trie's heap index: 2^len + elements as bits, dash = 1), and
+// the compiler fills each slot with the nearest table characters under a
+// weighted element edit distance. A miss is then one index computation and
+// one lookup, like a hit, instead of '?'.
+//
+// Costs: a dot read as a dash (or the reverse) is cheaper than an element
+// that was dropped or added, which shifts everything after it.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include "morse_table.h"
+#include "morse_trie.h"
+
+const uint8_t MORSE_COST_SUBST = 2;  // '.' <-> '-'
+const uint8_t MORSE_COST_INDEL = 3;  // element missing or extra
+
+// Guesses cover ordinary characters; the 8-element error prosign stays out so
+// the slots keep byte indices and the build stays within constexpr limits
+const size_t MORSE_NEAREST_DEPTH = 7;
+const size_t MORSE_NEAREST_NODES = 2u << MORSE_NEAREST_DEPTH; // 1..255
+
+struct MorseGuess
+{
+  char ch;            // best character ('?' with cost 0xFF: not Morse)
+  char alt;           // runner-up, '\0' if none
+  uint8_t cost;       // edit cost to ch (0 = exact)
+  uint8_t confidence; // 0..100: 100 exact, 0 = tie with alt
+};
+
+// Weighted edit cost between two patterns (a DP over at most
+// MORSE_TRIE_DEPTH elements each); for compile-time tables over a few entries
+constexpr uint8_t morseEditCost(const char *a, const char *b)
+{
+  uint8_t d[MORSE_TRIE_DEPTH + 1][MORSE_TRIE_DEPTH + 1] = {};
+  size_t la = 0, lb = 0;
+  while (a[la] && la < MORSE_TRIE_DEPTH)
+    la++;
+  while (b[lb] && lb < MORSE_TRIE_DEPTH)
+    lb++;
+  for (size_t i = 0; i <= la; i++)
+    d[i][0] = (uint8_t)(i * MORSE_COST_INDEL);
+  for (size_t j = 0; j <= lb; j++)
+    d[0][j] = (uint8_t)(j * MORSE_COST_INDEL);
+  for (size_t i = 1; i <= la; i++)
+    for (size_t j = 1; j <= lb; j++)
+    {
+      uint8_t best = (uint8_t)(d[i - 1][j - 1] + (a[i - 1] == b[j - 1] ? 0 : MORSE_COST_SUBST));
+      if (d[i - 1][j] + MORSE_COST_INDEL < best)
+        best = (uint8_t)(d[i - 1][j] + MORSE_COST_INDEL);
+      if (d[i][j - 1] + MORSE_COST_INDEL < best)
+        best = (uint8_t)(d[i][j - 1] + MORSE_COST_INDEL);
+      d[i][j] = best;
+    }
+  return d[la][lb];
+}
+
+struct MorseNearestIndex
+{
+  MorseGuess slot[MORSE_NEAREST_NODES];
+};
+
+// Two nearest distinct table entries of one node while the index is built
+struct MorseNearWork
+{
+  uint8_t cost[2];
+  uint8_t entry[2]; // table index, 0xFF = none
+};
+
+// Equal costs go to the character more likely to have been meant: the
+// alphabet's preference string (for Latin: letters by English frequency, then
+// digits), then everything else in table order. rank[] has one per entry.
+constexpr void morseNearRanks(const MorseAlphabet &a, uint8_t *rank)
+{
+  size_t preferLen = 0;
+  while (a.prefer[preferLen])
+    preferLen++;
+  for (size_t i = 0; i < a.len; i++)
+  {
+    rank[i] = (uint8_t)(preferLen + i);
+    for (size_t r = 0; r < preferLen; r++)
+      if (a.prefer[r] == a.table[i].ch)
+        rank[i] = (uint8_t)r;
+  }
+}
+
+// Keep (cost, entry) if it beats one of the two held. Returns true if
+// anything changed.
+constexpr bool morseNearOffer(MorseNearWork &w, uint8_t cost, uint8_t entry, const uint8_t *rank)
+{
+  auto better = [rank](uint8_t c1, uint8_t e1, uint8_t c2, uint8_t e2) {
+    return c1 < c2 || (c1 == c2 && (e2 == 0xFF || (e1 != 0xFF && rank[e1] < rank[e2])));
+  };
+  if (entry == w.entry[0])
+  {
+    if (cost >= w.cost[0])
+      return false;
+    w.cost[0] = cost;
+    return true;
+  }
+  if (entry == w.entry[1])
+  {
+    if (cost >= w.cost[1])
+      return false;
+    w.cost[1] = cost;
+    if (better(w.cost[1], w.entry[1], w.cost[0], w.entry[0]))
+    {
+      uint8_t c = w.cost[0], e = w.entry[0];
+      w.cost[0] = w.cost[1];
+      w.entry[0] = w.entry[1];
+      w.cost[1] = c;
+      w.entry[1] = e;
+    }
+    return true;
+  }
+  if (better(cost, entry, w.cost[0], w.entry[0]))
+  {
+    w.cost[1] = w.cost[0];
+    w.entry[1] = w.entry[0];
+    w.cost[0] = cost;
+    w.entry[0] = entry;
+    return true;
+  }
+  if (better(cost, entry, w.cost[1], w.entry[1]))
+  {
+    w.cost[1] = cost;
+    w.entry[1] = entry;
+    return true;
+  }
+  return false;
+}
+
+// Every table entry is a source at cost 0; costs then spread along single
+// element edits (substitute, delete, insert) until nothing improves. Deleting
+// before inserting never needs a pattern longer than both ends, so the
+// 255-node space is enough and the result is the true weighted edit distance.
+constexpr MorseNearestIndex morseBuildNearest(const MorseAlphabet &a)
+{
+  uint8_t rank[64] = {};
+  morseNearRanks(a, rank);
+  MorseNearWork work[MORSE_NEAREST_NODES] = {};
+  for (size_t n = 0; n < MORSE_NEAREST_NODES; n++)
+    work[n] = {{0xFF, 0xFF}, {0xFF, 0xFF}};
+  for (size_t i = 0; i < a.len; i++)
+  {
+    size_t node = MORSE_TRIE_ROOT;
+    for (const char *p = a.table[i].pattern; *p; p++)
+      node = node * 2 + (*p == '-');
+    if (node >= MORSE_NEAREST_NODES)
+      continue;
+    work[node].cost[0] = 0;
+    work[node].entry[0] = (uint8_t)i;
+  }
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t n = MORSE_TRIE_ROOT; n < MORSE_NEAREST_NODES; n++)
+    {
+      size_t len = 0;
+      while ((n >> (len + 1)) != 0)
+        len++;
+      size_t bits = n & ((1u << len) - 1);
+      auto pull = [&](size_t from, uint8_t step) {
+        for (int k = 0; k < 2; k++)
+          if (work[from].entry[k] != 0xFF && work[from].cost[k] + step < 0xFF)
+            changed |= morseNearOffer(work[n], (uint8_t)(work[from].cost[k] + step), work[from].entry[k], rank);
+      };
+      for (size_t k = 0; k < len; k++) // k counts elements from the end
+      {
+        pull(n ^ (1u << k), MORSE_COST_SUBST);
+        size_t high = bits >> (k + 1), low = bits & ((1u << k) - 1);
+        pull((1u << (len - 1)) | (high << k) | low, MORSE_COST_INDEL);
+      }
+      if (len < MORSE_NEAREST_DEPTH)
+        for (size_t k = 0; k <= len; k++)
+          for (size_t e = 0; e < 2; e++)
+          {
+            size_t high = bits >> k, low = bits & ((1u << k) - 1);
+            pull((1u << (len + 1)) | (high << (k + 1)) | (e << k) | low, MORSE_COST_INDEL);
+          }
+    }
+  }
+
+  MorseNearestIndex idx = {};
+  idx.slot[0] = {'?', '\0', 0xFF, 0};
+  idx.slot[MORSE_TRIE_ROOT] = idx.slot[0];
+  for (size_t n = MORSE_TRIE_ROOT + 1; n < MORSE_NEAREST_NODES; n++)
+  {
+    const MorseNearWork &w = work[n];
+    uint8_t c1 = w.cost[0], c2 = w.cost[1];
+    uint8_t conf = c1 == 0 ? 100 : (uint8_t)(100u * (c2 - c1) / c2);
+    idx.slot[n] = {a.table[w.entry[0]].ch, w.entry[1] != 0xFF ? a.table[w.entry[1]].ch : '\0', c1, conf};
+  }
+  return idx;
+}
+
+// One index per alphabet (morse_table.h), built only for the ones used
+template <size_t Alphabet>
+constexpr MorseNearestIndex MORSE_NEAREST_OF = morseBuildNearest(MORSE_ALPHABETS[Alphabet]);
+
+constexpr const MorseNearestIndex &MORSE_NEAREST = MORSE_NEAREST_OF<MORSE_ALPHABET>;
+
+// Heap index of any pattern up to MORSE_NEAREST_DEPTH elements, 0 if longer or
+// not made of '.' and '-'
+constexpr uint8_t morsePatternIndex(const char *pattern)
+{
+  size_t node = MORSE_TRIE_ROOT;
+  for (const char *p = pattern; *p; p++)
+  {
+    if ((*p != '.' && *p != '-') || node >= MORSE_NEAREST_NODES / 2)
+      return 0;
+    node = node * 2 + (*p == '-');
+  }
+  return (uint8_t)node;
+}
+
+// Exact match or nearest guess; ch == '?' with confidence 0 when the pattern
+// is empty, too long or not Morse
+constexpr MorseGuess morseNearest(const MorseNearestIndex &idx, const char *pattern)
+{
+  uint8_t node = morsePatternIndex(pattern);
+  return node > MORSE_TRIE_ROOT ? idx.slot[node] : idx.slot[0];
+}
+
+constexpr MorseGuess morseNearest(const char *pattern) { return morseNearest(MORSE_NEAREST, pattern); }
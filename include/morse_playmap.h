@@ -0,0 +1,124 @@
+#pragma once
+// Where playback is in its message, for the UI. A stage program carries no
+// text, so the map is read back out of the stages once when it starts to
+// play: one entry per character (the letter its elements decode to through
+// the trie, or ' ' for a word gap) with the stage index it starts at, 3
+// bytes each. Following the player is then comparing its stage index with
+// the next entry's start, done by whoever draws; the player does no extra
+// work per stage.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "morse_stages.h"
+#include "morse_trie.h"
+
+template <size_t Cap>
+class MorsePlayMap
+{
+public:
+  // Map a program (len stages, at most 64K); characters past Cap are left out
+  void build(const char *stages, size_t len, const MorseTrie &trie)
+  {
+    len_ = cur_ = 0;
+    MorseTrieNode node = MORSE_TRIE_ROOT;
+    size_t letterStart = len; // none open
+    auto closeLetter = [&]() {
+      if (letterStart == len)
+        return;
+      char c = node ? morseTrieChar(trie, node) : '\0';
+      add(c ? c : '?', letterStart);
+      node = MORSE_TRIE_ROOT;
+      letterStart = len;
+    };
+    for (size_t i = 0; i < len; i++)
+    {
+      char s = stages[i];
+      if (morseStageIsTone(s))
+      {
+        if (letterStart == len)
+          letterStart = i;
+        node = morseTrieNext(trie, node, s);
+      }
+      else if (s == '|' || s == '/')
+      {
+        closeLetter();
+        if (s == '/')
+          add(' ', i);
+      }
+    }
+    closeLetter();
+    text_[len_] = '\0';
+  }
+
+  // Move to the character playing at stage `at`; true if that is a different
+  // one. Usually one comparison; a loop back to the start rewinds.
+  bool follow(size_t at)
+  {
+    size_t c = cur_;
+    if (c > 0 && at < start_[c])
+      c = 0;
+    while (c + 1 < len_ && at >= start_[c + 1])
+      c++;
+    bool changed = c != cur_;
+    cur_ = c;
+    return changed;
+  }
+
+  const char *text() const { return text_; }
+  size_t size() const { return len_; }
+  size_t current() const { return cur_; }
+
+  // One display line of `width` columns around the current character, a
+  // third of it (more near the end) for what has been sent; prosigns as
+  // "<SK>". Returns the column and width of the current character in out.
+  size_t formatLine(char *out, size_t width, size_t &hiCol, size_t &hiLen) const
+  {
+    hiCol = hiLen = 0;
+    size_t n = 0;
+    if (len_ == 0)
+    {
+      out[0] = '\0';
+      return 0;
+    }
+    size_t ahead = 0;
+    for (size_t i = cur_; i < len_ && ahead < width; i++)
+      ahead += morseCharLabelLen(text_[i]);
+    size_t room = ahead < width - width / 3 ? width - ahead : width / 3; // near the end, fill the line
+    size_t from = cur_, back = 0;
+    while (from > 0 && back + morseCharLabelLen(text_[from - 1]) <= room)
+      back += morseCharLabelLen(text_[--from]);
+    char label[6];
+    for (size_t i = from; i < len_; i++)
+    {
+      size_t w = morseCharLabelLen(text_[i]);
+      if (n + w > width)
+        break;
+      if (i == cur_)
+      {
+        hiCol = n;
+        hiLen = w;
+      }
+      memcpy(out + n, morseCharLabel(text_[i], label), w);
+      n += w;
+    }
+    out[n] = '\0';
+    return n;
+  }
+
+private:
+  void add(char c, size_t at)
+  {
+    if (len_ == Cap)
+      return;
+    text_[len_] = c;
+    start_[len_++] = (uint16_t)at;
+  }
+
+  char text_[Cap + 1] = {};
+  uint16_t start_[Cap] = {};
+  size_t len_ = 0;
+  size_t cur_ = 0;
+};
@@ -0,0 +1,107 @@
+#pragma once
+// Offline renderer: turns a compiled stage program (see morse_stages.h) into
+// 16-bit mono PCM, plus the 44-byte WAV header the host tools write in front.
+//
+// Portable (no Arduino dependencies). PCM is produced in fixed blocks and
+// handed to a sink, so memory use does not depend on message length.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "morse_stages.h"
+#include "tone_synth.h"
+
+// ================= Renderer =================
+class MorseRenderer
+{
+public:
+  static const size_t BLOCK = 1024; // samples per sink call
+
+  void configure(uint32_t sampleRate, float pitchHz, float volume, float edgeMs, const MorseTiming &timing)
+  {
+    sampleRate_ = sampleRate;
+    timing_ = timing;
+    synth_.configure(sampleRate, pitchHz, volume, edgeMs);
+    carry_ = 0;
+  }
+
+  // Render `loops` passes of the program, separated by the loop gap, the way
+  // the player repeats a message. sink(const int16_t *pcm, size_t n) gets
+  // every block. Returns the number of samples produced.
+  template <typename Sink>
+  uint64_t render(const char *stages, size_t len, uint32_t loops, Sink sink)
+  {
+    uint64_t total = 0;
+    for (uint32_t l = 0; l < loops; l++)
+    {
+      for (size_t i = 0; i < len; i++)
+        total += stage(morseStageIsTone(stages[i]), morseStageMs(stages[i], timing_), sink);
+      total += stage(false, timing_.loopMs, sink);
+    }
+    return total;
+  }
+
+private:
+  // Stage lengths carry the fractional sample forward so long renders do not
+  // drift from the millisecond timeline.
+  template <typename Sink>
+  uint64_t stage(bool tone, uint16_t ms, Sink &sink)
+  {
+    uint64_t exact = (uint64_t)ms * sampleRate_ + carry_;
+    uint64_t samples = exact / 1000;
+    carry_ = (uint32_t)(exact % 1000);
+    synth_.setGate(tone);
+    uint64_t left = samples;
+    while (left > 0)
+    {
+      size_t n = left > BLOCK ? BLOCK : (size_t)left;
+      synth_.render(buf_, n);
+      sink((const int16_t *)buf_, n);
+      left -= n;
+    }
+    return samples;
+  }
+
+  ToneSynth synth_;
+  MorseTiming timing_ = morseTimingForUnit(120);
+  uint32_t sampleRate_ = 8000;
+  uint32_t carry_ = 0;
+  int16_t buf_[BLOCK];
+};
+
+// ================= WAV header =================
+// Canonical 44-byte PCM header, little-endian, 16-bit mono
+inline void wavWriteHeader(uint8_t hdr[44], uint32_t sampleRate, uint32_t dataBytes)
+{
+  struct
+  {
+    uint8_t *p;
+    void tag(const char *s)
+    {
+      memcpy(p, s, 4);
+      p += 4;
+    }
+    void u32(uint32_t v)
+    {
+      for (int i = 0; i < 4; i++)
+        *p++ = (uint8_t)(v >> (8 * i));
+    }
+    void u16(uint16_t v)
+    {
+      *p++ = (uint8_t)v;
+      *p++ = (uint8_t)(v >> 8);
+    }
+  } w = {hdr};
+  w.tag("RIFF");
+  w.u32(36 + dataBytes);
+  w.tag("WAVE");
+  w.tag("fmt ");
+  w.u32(16);
+  w.u16(1); // PCM
+  w.u16(1); // mono
+  w.u32(sampleRate);
+  w.u32(sampleRate * 2); // byte rate
+  w.u16(2);              // block align
+  w.u16(16);             // bits per sample
+  w.tag("data");
+  w.u32(dataBytes);
+}
@@ -0,0 +1,185 @@
+#pragma once
+// Playback stage programs: the compiled form of a message that the playback
+// engine (and the host renderer) walks one stage at a time.
+//
+// Stage symbols:
+// '.'  = dot tone (1u)
+// '-'  = dash tone (3u)
+// 'i'  = inter-element gap (1u)
+// '|'  = inter-letter gap (3u)
+// '/'  = inter-word gap (7u)
+
+#include <stddef.h>
+#include <stdint.h>
+#include "morse_table.h"
+
+// Longest stage run one character can produce: 8 elements (the error prosign)
+// + 7 gaps + 1 letter gap. "<HH>" markup spends 4 characters on the same run.
+const size_t MORSE_STAGES_PER_CHAR = 16;
+
+// ================= Stage timing =================
+struct MorseTiming
+{
+  uint16_t dotMs;    // '.'
+  uint16_t dashMs;   // '-'
+  uint16_t interMs;  // 'i'
+  uint16_t letterMs; // '|'
+  uint16_t wordMs;   // '/'
+  uint16_t loopMs;   // between full-message repeats
+};
+
+// Standard 1/3/1/3/7 ratios for a given unit, with a 3u loop gap
+inline MorseTiming morseTimingForUnit(uint16_t unitMs)
+{
+  MorseTiming t;
+  t.dotMs = unitMs;
+  t.dashMs = (uint16_t)(3 * unitMs);
+  t.interMs = unitMs;
+  t.letterMs = (uint16_t)(3 * unitMs);
+  t.wordMs = (uint16_t)(7 * unitMs);
+  t.loopMs = (uint16_t)(3 * unitMs);
+  return t;
+}
+
+inline bool morseStageIsTone(char s) { return s == '.' || s == '-'; }
+
+// Unknown symbols fall back to an inter-element gap, like the player always did
+inline uint16_t morseStageMs(char s, const MorseTiming &t)
+{
+  switch (s)
+  {
+  case '.':
+    return t.dotMs;
+  case '-':
+    return t.dashMs;
+  case '|':
+    return t.letterMs;
+  case '/':
+    return t.wordMs;
+  case 'i':
+  default:
+    return t.interMs;
+  }
+}
+
+// ================= Stage building =================
+// Both builders write a NUL-terminated program into out[cap] and return its
+// length. Output stops at the last whole letter that fits. With out == nullptr
+// they only count, which is how compile-time programs size themselves.
+// Everything here is constexpr: the same code runs on the device and inside
+// the compiler (see morse_literal.h).
+
+constexpr size_t morseStrLen(const char *s)
+{
+  size_t n = 0;
+  while (s[n] != '\0')
+    n++;
+  return n;
+}
+
+// Build stages for one Morse pattern (".-" etc.)
+constexpr size_t morseBuildStagesForPattern(const char *pat, char *out, size_t cap)
+{
+  size_t n = 0;
+  size_t len = morseStrLen(pat);
+  if (cap == 0)
+    return 0;
+  if (len * 2 > cap) // pattern needs at most 2*len-1 stages + NUL
+  {
+    if (out)
+      out[0] = '\0';
+    return 0;
+  }
+  for (size_t i = 0; i < len; ++i)
+  {
+    char s = pat[i];
+    if (s == '.' || s == '-')
+    {
+      if (out)
+        out[n] = s; // tone
+      n++;
+      if (i < len - 1)
+      {
+        if (out)
+          out[n] = 'i'; // inter-element gap (1u) except after last element
+        n++;
+      }
+    }
+  }
+  if (out)
+    out[n] = '\0';
+  return n;
+}
+
+// Build full play sequence from a text message (letters/spaces, prosigns as
+// their codes or "<SK>" markup) in the given alphabet
+constexpr size_t morseBuildStagesFromText(const char *msg, char *out, size_t cap,
+                                          const MorseAlphabet &alphabet = MORSE_DEFAULT_ALPHABET)
+{
+  size_t n = 0;
+  char last = '\0'; // last stage written; out may be null so track it here
+  if (cap == 0)
+    return 0;
+  size_t msgLen = morseStrLen(msg);
+  for (size_t i = 0; i < msgLen; ++i)
+  {
+    char ch = msg[i];
+    if (ch == ' ')
+    {
+      // collapse consecutive spaces into one word gap
+      if (n == 0 || last == '/')
+        continue;
+      // replace a trailing letter gap with word gap, if present
+      if (last == '|')
+        n--;
+      else if (n + 1 >= cap)
+        break; // no room for the gap and the NUL
+      if (out)
+        out[n] = '/'; // word gap (7u)
+      n++;
+      last = '/';
+      continue;
+    }
+    size_t markup = 0;
+    if (ch == '<' && (ch = morseParseProsign(msg + i, markup)) != '\0')
+      i += markup - 1;
+    const char *pat = morseEncode(ch, alphabet);
+    if (pat[0] == '\0')
+      continue; // skip unknown chars
+    size_t added = morseBuildStagesForPattern(pat, out ? out + n : nullptr, cap - n);
+    if (added == 0)
+      break; // out of room: stop at the last whole letter
+    n += added;
+    last = '.'; // a letter always ends on a tone
+    // add inter-letter gap unless next char is space or end
+    // look ahead to next non-space valid char
+    size_t j = i + 1;
+    while (j < msgLen && msg[j] == ' ')
+      j++;
+    if (j < msgLen)
+    {
+      // next is another letter/number/punct
+      if (n + 1 >= cap)
+        break;
+      if (out)
+        out[n] = '|';
+      n++;
+      last = '|';
+    }
+  }
+  // remove trailing letter gap if any
+  if (last == '|')
+    n--;
+  if (out)
+    out[n] = '\0';
+  return n;
+}
+
+// Total duration of one pass through a program (without the loop gap)
+inline uint32_t morseStagesDurationMs(const char *stages, size_t len, const MorseTiming &t)
+{
+  uint32_t ms = 0;
+  for (size_t i = 0; i < len; i++)
+    ms += morseStageMs(stages[i], t);
+  return ms;
+}
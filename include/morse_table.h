@@ -0,0 +1,255 @@
+#pragma once
+// Portable Morse tables shared by the firmware and host-side code.
+// No Arduino dependencies: patterns are plain C strings of '.' and '-'.
+// The tables and encoder are constexpr so messages can be compiled at build time.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ================= Prosigns =================
+// Prosigns that share a pattern with punctuation decode as that character
+// (AR = '+', BT = '=', KN = '(', AS = '&'). The rest have no character of
+// their own, so they get control codes 1..4 and sit in the tables like any
+// other entry: decode, trie and encode treat them the same way. Text shows
+// them as "<SK>" markup (morseCharLabel) and the encoder accepts it back.
+const char MORSE_PROSIGN_SK = '\x01';    // ...-.- end of contact
+const char MORSE_PROSIGN_CT = '\x02';    // -.-.- start of message (KA)
+const char MORSE_PROSIGN_VE = '\x03';    // ...-. understood (SN)
+const char MORSE_PROSIGN_ERROR = '\x04'; // ........ error (HH): the keyer erases the last word
+
+typedef struct
+{
+  const char *name;
+  char ch;
+} MorseProsign;
+// The first four are the codes in order, so a code's name is one index away
+constexpr MorseProsign MORSE_PROSIGNS[] = {{"SK", MORSE_PROSIGN_SK}, {"CT", MORSE_PROSIGN_CT}, {"VE", MORSE_PROSIGN_VE},
+                                           {"HH", MORSE_PROSIGN_ERROR}, {"AR", '+'}, {"BT", '='}, {"KN", '('},
+                                           {"AS", '&'}, {"KA", MORSE_PROSIGN_CT}, {"SN", MORSE_PROSIGN_VE}};
+constexpr size_t MORSE_PROSIGNS_LEN = sizeof(MORSE_PROSIGNS) / sizeof(MORSE_PROSIGNS[0]);
+
+static_assert(MORSE_PROSIGNS[MORSE_PROSIGN_ERROR - MORSE_PROSIGN_SK].ch == MORSE_PROSIGN_ERROR, "codes index names");
+
+constexpr bool morseIsProsign(char ch) { return ch >= MORSE_PROSIGN_SK && ch <= MORSE_PROSIGN_ERROR; }
+
+// ================= Morse table =================
+typedef struct
+{
+  const char *pattern;
+  char ch;
+} MorseEntry;
+
+// International (Latin) table
+constexpr MorseEntry MORSE_TABLE_LATIN[] = {
+    {".-", 'A'}, {"-...", 'B'}, {"-.-.", 'C'}, {"-..", 'D'}, {".", 'E'}, {"..-.", 'F'}, {"--.", 'G'}, {"....", 'H'}, {"..", 'I'}, {".---", 'J'}, {"-.-", 'K'}, {".-..", 'L'}, {"--", 'M'}, {"-.", 'N'}, {"---", 'O'}, {".--.", 'P'}, {"--.-", 'Q'}, {".-.", 'R'}, {"...", 'S'}, {"-", 'T'}, {"..-", 'U'}, {"...-", 'V'}, {".--", 'W'}, {"-..-", 'X'}, {"-.--", 'Y'}, {"--..", 'Z'}, {"-----", '0'}, {".----", '1'}, {"..---", '2'}, {"...--", '3'}, {"....-", '4'}, {".....", '5'}, {"-....", '6'}, {"--...", '7'}, {"---..", '8'}, {"----.", '9'}, {".-.-.-", '.'}, {"--..--", ','}, {"..--..", '?'}, {".----.", '\''}, {"-.-.--", '!'}, {"-..-.", '/'}, {"-.--.", '('}, {"-.--.-", ')'}, {".-...", '&'}, {"---...", ':'}, {"-.-.-.", ';'}, {"-...-", '='}, {".-.-.", '+'}, {"-....-", '-'}, {"..--.-", '_'}, {".-..-.", '"'}, {".--.-.", '@'},
+    {"...-.-", MORSE_PROSIGN_SK}, {"-.-.-", MORSE_PROSIGN_CT}, {"...-.", MORSE_PROSIGN_VE}, {"........", MORSE_PROSIGN_ERROR}};
+
+// ================= Other alphabets =================
+// Text stays one byte per character: each alphabet uses an 8-bit code page
+// (noted per table) for its letters and ASCII for everything else.
+
+// Latin plus the accented letters with codes of their own (ISO 8859-1). È
+// and the Icelandic letters are left out: the trie's reach masks hold 64.
+constexpr MorseEntry MORSE_TABLE_LATIN_EXT[] = {
+    {".-", 'A'}, {"-...", 'B'}, {"-.-.", 'C'}, {"-..", 'D'}, {".", 'E'}, {"..-.", 'F'}, {"--.", 'G'}, {"....", 'H'}, {"..", 'I'}, {".---", 'J'}, {"-.-", 'K'}, {".-..", 'L'}, {"--", 'M'}, {"-.", 'N'}, {"---", 'O'}, {".--.", 'P'}, {"--.-", 'Q'}, {".-.", 'R'}, {"...", 'S'}, {"-", 'T'}, {"..-", 'U'}, {"...-", 'V'}, {".--", 'W'}, {"-..-", 'X'}, {"-.--", 'Y'}, {"--..", 'Z'},
+    {".-.-", '\xC4'}, {".--.-", '\xC5'}, {"-.-..", '\xC7'}, {"..-..", '\xC9'}, {"--.--", '\xD1'}, {"---.", '\xD6'}, {"..--", '\xDC'}, // Ä Å Ç É Ñ Ö Ü
+    {"-----", '0'}, {".----", '1'}, {"..---", '2'}, {"...--", '3'}, {"....-", '4'}, {".....", '5'}, {"-....", '6'}, {"--...", '7'}, {"---..", '8'}, {"----.", '9'}, {".-.-.-", '.'}, {"--..--", ','}, {"..--..", '?'}, {".----.", '\''}, {"-.-.--", '!'}, {"-..-.", '/'}, {"-.--.", '('}, {"-.--.-", ')'}, {".-...", '&'}, {"---...", ':'}, {"-.-.-.", ';'}, {"-...-", '='}, {".-.-.", '+'}, {"-....-", '-'}, {"..--.-", '_'}, {".-..-.", '"'}, {".--.-.", '@'},
+    {"...-.-", MORSE_PROSIGN_SK}, {"-.-.-", MORSE_PROSIGN_CT}, {"...-.", MORSE_PROSIGN_VE}, {"........", MORSE_PROSIGN_ERROR}};
+
+// Russian (KOI8-R capitals). Six dots is the full stop here.
+constexpr MorseEntry MORSE_TABLE_CYRILLIC[] = {
+    {".-", '\xE1'}, {"-...", '\xE2'}, {".--", '\xF7'}, {"--.", '\xE7'}, {"-..", '\xE4'}, {".", '\xE5'}, {"...-", '\xF6'}, {"--..", '\xFA'}, // А Б В Г Д Е Ж З
+    {"..", '\xE9'}, {".---", '\xEA'}, {"-.-", '\xEB'}, {".-..", '\xEC'}, {"--", '\xED'}, {"-.", '\xEE'}, {"---", '\xEF'}, {".--.", '\xF0'}, // И Й К Л М Н О П
+    {".-.", '\xF2'}, {"...", '\xF3'}, {"-", '\xF4'}, {"..-", '\xF5'}, {"..-.", '\xE6'}, {"....", '\xE8'}, {"-.-.", '\xE3'}, {"---.", '\xFE'}, // Р С Т У Ф Х Ц Ч
+    {"----", '\xFB'}, {"--.-", '\xFD'}, {"--.--", '\xFF'}, {"-.--", '\xF9'}, {"-..-", '\xF8'}, {"..-..", '\xFC'}, {"..--", '\xE0'}, {".-.-", '\xF1'}, // Ш Щ Ъ Ы Ь Э Ю Я
+    {"-----", '0'}, {".----", '1'}, {"..---", '2'}, {"...--", '3'}, {"....-", '4'}, {".....", '5'}, {"-....", '6'}, {"--...", '7'}, {"---..", '8'}, {"----.", '9'}, {"......", '.'}, {".-.-.-", ','}, {"..--..", '?'}, {"--..--", '!'}, {"-....-", '-'}, {"-..-.", '/'}, {"---...", ':'}, {"-.-.-.", ';'}, {"-.--.-", '('}, {".----.", '\''}, {".-..-.", '"'}, {"-...-", '='}, {".--.-.", '@'},
+    {"...-.-", MORSE_PROSIGN_SK}, {"-.-.-", MORSE_PROSIGN_CT}, {"...-.", MORSE_PROSIGN_VE}, {"........", MORSE_PROSIGN_ERROR}};
+
+// Wabun kana in iroha order (JIS X 0201 half-width katakana). WI and WE have
+// no code point there and are left out; digits are sent after switching back
+// to the Latin table, as on the air. CT is missing because it is SA.
+constexpr MorseEntry MORSE_TABLE_WABUN[] = {
+    {".-", '\xB2'}, {".-.-", '\xDB'}, {"-...", '\xCA'}, {"-.-.", '\xC6'}, {"-..", '\xCE'}, {".", '\xCD'}, {"..-..", '\xC4'}, {"..-.", '\xC1'}, // i ro ha ni ho he to chi
+    {"--.", '\xD8'}, {"....", '\xC7'}, {"-.--.", '\xD9'}, {".---", '\xA6'}, {"-.-", '\xDC'}, {".-..", '\xB6'}, {"--", '\xD6'}, {"-.", '\xC0'}, // ri nu ru wo wa ka yo ta
+    {"---", '\xDA'}, {"---.", '\xBF'}, {".--.", '\xC2'}, {"--.-", '\xC8'}, {".-.", '\xC5'}, {"...", '\xD7'}, {"-", '\xD1'}, {"..-", '\xB3'}, // re so tsu ne na ra mu u
+    {"..--", '\xC9'}, {".-...", '\xB5'}, {"...-", '\xB8'}, {".--", '\xD4'}, {"-..-", '\xCF'}, {"-.--", '\xB9'}, {"--..", '\xCC'}, {"----", '\xBA'}, // no o ku ya ma ke fu ko
+    {"-.---", '\xB4'}, {".-.--", '\xC3'}, {"--.--", '\xB1'}, {"-.-.-", '\xBB'}, {"-.-..", '\xB7'}, {"-..--", '\xD5'}, {"-...-", '\xD2'}, {"..-.-", '\xD0'}, // e te a sa ki yu me mi
+    {"--.-.", '\xBC'}, {"--..-", '\xCB'}, {"-..-.", '\xD3'}, {".---.", '\xBE'}, {"---.-", '\xBD'}, {".-.-.", '\xDD'}, // shi hi mo se su n
+    {"..", '\xDE'}, {"..--.", '\xDF'}, {".--.-", '\xB0'}, {".-.-.-", '\xA4'}, {".-.-..", '\xA3'}, {"-.--.-", '('}, {".-..-.", ')'}, // dakuten handakuten long , close
+    {"...-.-", MORSE_PROSIGN_SK}, {"...-.", MORSE_PROSIGN_VE}, {"........", MORSE_PROSIGN_ERROR}};
+
+// ================= Alphabet selection =================
+// MORSE_ALPHABET picks the table everything is built from (trie, nearest
+// guesses, encoder). The choice is made by the compiler, so the decode path
+// is the same code whichever table it is. morse_codec.h has every table's
+// indexes side by side for switching while running.
+#define MORSE_ALPHABET_LATIN 0
+#define MORSE_ALPHABET_LATIN_EXT 1
+#define MORSE_ALPHABET_CYRILLIC 2
+#define MORSE_ALPHABET_WABUN 3
+#ifndef MORSE_ALPHABET
+#define MORSE_ALPHABET MORSE_ALPHABET_LATIN
+#endif
+
+// ================= Encode index =================
+// Character -> position in its table for every byte value, one 256-byte array
+// per table filled in by the compiler, so encoding is one load whichever
+// alphabet it is. ASCII lower case points at the capital.
+const uint8_t MORSE_NOT_ENCODED = 0xFF; // no code for this character
+
+struct MorseEncodeIndex
+{
+  uint8_t at[256];
+};
+
+template <size_t N>
+constexpr MorseEncodeIndex morseBuildEncodeIndex(const MorseEntry (&table)[N])
+{
+  static_assert(N < MORSE_NOT_ENCODED, "positions must fit a byte");
+  MorseEncodeIndex idx = {};
+  for (size_t c = 0; c < 256; c++)
+    idx.at[c] = MORSE_NOT_ENCODED;
+  for (size_t i = 0; i < N; i++)
+  {
+    uint8_t c = (uint8_t)table[i].ch;
+    idx.at[c] = (uint8_t)i;
+    if (c >= 'A' && c <= 'Z')
+      idx.at[c - 'A' + 'a'] = (uint8_t)i;
+  }
+  return idx;
+}
+
+template <const auto &Table>
+constexpr MorseEncodeIndex MORSE_ENCODE_INDEX_OF = morseBuildEncodeIndex(Table);
+
+typedef struct
+{
+  const char *name;
+  const MorseEntry *table;
+  size_t len;
+  const char *prefer;             // tie order for nearest guesses; characters not in it follow in table order
+  const MorseEncodeIndex *encode; // character -> table position
+} MorseAlphabet;
+
+#define MORSE_ALPHABET_ENTRY(name, table, prefer) \
+  {name, table, sizeof(table) / sizeof(table[0]), prefer, &MORSE_ENCODE_INDEX_OF<table>}
+constexpr MorseAlphabet MORSE_ALPHABETS[] = {
+    MORSE_ALPHABET_ENTRY("LATIN", MORSE_TABLE_LATIN, "ETAOINSHRDLUCMWFGYPBVKJXQZ0123456789"),
+    MORSE_ALPHABET_ENTRY("LATINX", MORSE_TABLE_LATIN_EXT, "ETAOINSHRDLUCMWFGYPBVKJXQZ0123456789"),
+    MORSE_ALPHABET_ENTRY("CYRILLIC", MORSE_TABLE_CYRILLIC, // О Е А И Н Т С Р В Л К М Д П У Я Ы Ь Г З Б Ч Й Х Ж Ш Ю Ц Щ Э Ф Ъ
+                         "\xEF\xE5\xE1\xE9\xEE\xF4\xF3\xF2\xF7\xEC\xEB\xED\xE4\xF0\xF5\xF1\xF9\xF8\xE7\xFA\xE2\xFE\xEA\xE8"
+                         "\xF6\xFB\xE0\xE3\xFD\xFC\xE6\xFF" "0123456789"),
+    MORSE_ALPHABET_ENTRY("WABUN", MORSE_TABLE_WABUN, ""),
+};
+#undef MORSE_ALPHABET_ENTRY
+constexpr size_t MORSE_ALPHABET_COUNT = sizeof(MORSE_ALPHABETS) / sizeof(MORSE_ALPHABETS[0]);
+static_assert(MORSE_ALPHABET < MORSE_ALPHABET_COUNT, "unknown MORSE_ALPHABET");
+
+const size_t MORSE_PATTERN_MAX = 8; // longest code in any table (HH)
+
+// Every pattern 1..MORSE_PATTERN_MAX elements of '.' and '-', no pattern or
+// character twice, at most 64 entries (one reach bit each in the trie)
+constexpr bool morseAlphabetValid(const MorseAlphabet &a)
+{
+  if (a.len > 64)
+    return false;
+  for (size_t i = 0; i < a.len; i++)
+  {
+    const char *p = a.table[i].pattern;
+    size_t n = 0;
+    for (; p[n]; n++)
+      if (p[n] != '.' && p[n] != '-')
+        return false;
+    if (n == 0 || n > MORSE_PATTERN_MAX)
+      return false;
+    for (size_t j = 0; j < i; j++)
+    {
+      if (a.table[j].ch == a.table[i].ch)
+        return false;
+      const char *q = a.table[j].pattern;
+      size_t k = 0;
+      while (p[k] && p[k] == q[k])
+        k++;
+      if (p[k] == q[k])
+        return false;
+    }
+  }
+  return true;
+}
+static_assert(morseAlphabetValid(MORSE_ALPHABETS[0]) && morseAlphabetValid(MORSE_ALPHABETS[1]) &&
+                  morseAlphabetValid(MORSE_ALPHABETS[2]) && morseAlphabetValid(MORSE_ALPHABETS[3]),
+              "bad Morse table");
+
+constexpr const MorseAlphabet &MORSE_DEFAULT_ALPHABET = MORSE_ALPHABETS[MORSE_ALPHABET];
+constexpr const MorseEntry *MORSE_TABLE = MORSE_DEFAULT_ALPHABET.table;
+constexpr size_t MORSE_TABLE_LEN = MORSE_DEFAULT_ALPHABET.len;
+
+// Pattern -> character, '?' when the pattern is unknown
+inline char morseDecode(const char *pattern, const MorseAlphabet &a = MORSE_DEFAULT_ALPHABET)
+{
+  for (size_t i = 0; i < a.len; i++)
+    if (strcmp(pattern, a.table[i].pattern) == 0)
+      return a.table[i].ch;
+  return '?';
+}
+
+// Character -> pattern (ASCII case-insensitive), "" when the character has no code
+constexpr const char *morseEncode(char ch, const MorseAlphabet &a = MORSE_DEFAULT_ALPHABET)
+{
+  uint8_t i = a.encode->at[(uint8_t)ch];
+  return i == MORSE_NOT_ENCODED ? "" : a.table[i].pattern;
+}
+
+// "<AR>" style markup at s (case-insensitive) -> the prosign's character, with
+// the markup length in len; '\0' if s does not start with a known prosign
+constexpr char morseParseProsign(const char *s, size_t &len)
+{
+  if (s[0] != '<')
+    return '\0';
+  for (size_t i = 0; i < MORSE_PROSIGNS_LEN; i++)
+  {
+    const char *name = MORSE_PROSIGNS[i].name;
+    size_t n = 0;
+    while (name[n] && (s[n + 1] == name[n] || s[n + 1] == name[n] - 'A' + 'a'))
+      n++;
+    if (name[n] == '\0' && s[n + 1] == '>')
+    {
+      len = n + 2;
+      return MORSE_PROSIGNS[i].ch;
+    }
+  }
+  return '\0';
+}
+
+// Printable form of one decoded character: "<SK>" for a prosign code, else the
+// character itself. out needs room for 6 bytes.
+inline const char *morseCharLabel(char ch, char *out)
+{
+  if (morseIsProsign(ch))
+  {
+    out[0] = '<';
+    strcpy(out + 1, MORSE_PROSIGNS[ch - MORSE_PROSIGN_SK].name);
+    strcat(out, ">");
+  }
+  else
+  {
+    out[0] = ch;
+    out[1] = '\0';
+  }
+  return out;
+}
+
+inline size_t morseCharLabelLen(char ch)
+{
+  return morseIsProsign(ch) ? strlen(MORSE_PROSIGNS[ch - MORSE_PROSIGN_SK].name) + 2 : 1;
+}
+
+// Where the last `width` printed columns of text[0..len) begin, whole labels only
+inline size_t morseTextTail(const char *text, size_t len, size_t width)
+{
+  size_t start = len, used = 0;
+  while (start > 0 && used + morseCharLabelLen(text[start - 1]) <= width)
+    used += morseCharLabelLen(text[--start]);
+  return start;
+}
@@ -0,0 +1,150 @@
+#pragma once
+// Prefix trie over a Morse table, built at compile time. Morse is binary, so the
+// trie is a heap-indexed binary tree: the root is node 1 and a node's dot and
+// dash children are 2n and 2n+1. Stepping one element is a shift and an add;
+// each node also carries the set of characters still reachable from it (one
+// bit per table entry), so the live candidates and "can this still grow?"
+// are single lookups. Node 0 means no character can match any more.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include "morse_table.h"
+
+const uint8_t MORSE_TRIE_ROOT = 1;
+const size_t MORSE_TRIE_DEPTH = MORSE_PATTERN_MAX;      // longest pattern it can hold (HH)
+const size_t MORSE_TRIE_NODES = 2u << MORSE_TRIE_DEPTH; // node indices 1..511
+
+typedef uint16_t MorseTrieNode;
+
+struct MorseTrie
+{
+  const MorseEntry *table;          // the table the reach bits refer to
+  char ch[MORSE_TRIE_NODES];        // character ending at this node, '\0' if none
+  uint64_t reach[MORSE_TRIE_NODES]; // table entries at or below this node
+};
+
+constexpr MorseTrie morseBuildTrie(const MorseAlphabet &a)
+{
+  MorseTrie t = {};
+  t.table = a.table;
+  for (size_t i = 0; i < a.len; i++) // morseAlphabetValid() keeps this in range
+  {
+    size_t node = MORSE_TRIE_ROOT;
+    for (const char *p = a.table[i].pattern; *p; p++)
+      node = node * 2 + (*p == '-');
+    t.ch[node] = a.table[i].ch;
+    for (size_t n = node; n >= MORSE_TRIE_ROOT; n /= 2)
+      t.reach[n] |= 1ull << i;
+  }
+  return t;
+}
+
+// One trie per alphabet (morse_table.h), built only for the ones used
+template <size_t Alphabet>
+constexpr MorseTrie MORSE_TRIE_OF = morseBuildTrie(MORSE_ALPHABETS[Alphabet]);
+
+constexpr const MorseTrie &MORSE_TRIE = MORSE_TRIE_OF<MORSE_ALPHABET>;
+
+// Next node after one element ('.' or '-'); 0 once nothing can match
+constexpr MorseTrieNode morseTrieNext(const MorseTrie &t, MorseTrieNode node, char s)
+{
+  if (node == 0 || node >= MORSE_TRIE_NODES / 2 || (s != '.' && s != '-'))
+    return 0;
+  MorseTrieNode next = (MorseTrieNode)(node * 2 + (s == '-'));
+  return t.reach[next] ? next : 0;
+}
+
+// Character keyed so far, '\0' for a prefix that is not a character yet
+constexpr char morseTrieChar(const MorseTrie &t, MorseTrieNode node) { return t.ch[node]; }
+
+// Table entries still reachable (bit i = table entry i)
+constexpr uint64_t morseTrieReach(const MorseTrie &t, MorseTrieNode node) { return t.reach[node]; }
+
+// A character that no longer pattern starts with: nothing left to wait for
+constexpr bool morseTrieComplete(const MorseTrie &t, MorseTrieNode node)
+{
+  return node != 0 && t.ch[node] != '\0' &&
+         (node >= MORSE_TRIE_NODES / 2 || (t.reach[node * 2] | t.reach[node * 2 + 1]) == 0);
+}
+
+// Characters reachable by keying more, in table order, into out[cap]
+// (NUL-terminated, cut short when full); returns how many were written
+inline size_t morseTrieCandidates(const MorseTrie &t, MorseTrieNode node, char *out, size_t cap)
+{
+  if (cap == 0)
+    return 0;
+  size_t n = 0;
+  uint64_t more = node && node < MORSE_TRIE_NODES / 2 ? t.reach[node * 2] | t.reach[node * 2 + 1] : 0;
+  for (size_t i = 0; more && n + 1 < cap; i++, more >>= 1)
+    if (more & 1)
+      out[n++] = t.table[i].ch;
+  out[n] = '\0';
+  return n;
+}
+
+// The same on the MORSE_ALPHABET trie
+constexpr MorseTrieNode morseTrieNext(MorseTrieNode node, char s) { return morseTrieNext(MORSE_TRIE, node, s); }
+constexpr char morseTrieChar(MorseTrieNode node) { return morseTrieChar(MORSE_TRIE, node); }
+constexpr uint64_t morseTrieReach(MorseTrieNode node) { return morseTrieReach(MORSE_TRIE, node); }
+constexpr bool morseTrieComplete(MorseTrieNode node) { return morseTrieComplete(MORSE_TRIE, node); }
+inline size_t morseTrieCandidates(MorseTrieNode node, char *out, size_t cap)
+{
+  return morseTrieCandidates(MORSE_TRIE, node, out, cap);
+}
+
+// Same result as morseDecode(), via the trie
+inline char morseTrieDecode(const char *pattern)
+{
+  MorseTrieNode node = MORSE_TRIE_ROOT;
+  for (const char *p = pattern; *p && node; p++)
+    node = morseTrieNext(node, *p);
+  char c = node ? MORSE_TRIE.ch[node] : '\0';
+  return c ? c : '?';
+}
+
+// One display line for the letter being keyed: the elements, "=X" for the
+// character they spell (or "~G" with the nearest guess once nothing can
+// match) and ">..." for what keying on can still reach, e.g. ".-. =R >L.&+\"".
+// Prosigns show as "<SK>". Cut to fit out[cap].
+inline size_t morseFormatLetterLine(const MorseTrie &t, const char *symbols, MorseTrieNode node, char *out, size_t cap,
+                                    char guess = '?')
+{
+  if (cap == 0)
+    return 0;
+  size_t n = 0;
+  auto put = [&](char c) {
+    if (n + 1 < cap)
+      out[n++] = c;
+  };
+  char label[6];
+  auto putLabel = [&](char c) {
+    for (const char *p = morseCharLabel(c, label); *p; p++)
+      put(*p);
+  };
+  for (const char *p = symbols; *p; p++)
+    put(*p);
+  char match = node ? t.ch[node] : guess;
+  if (match)
+  {
+    put(' ');
+    put(node ? '=' : '~');
+    putLabel(match);
+  }
+  char more[64 + 1];
+  if (n + 3 < cap && morseTrieCandidates(t, node, more, sizeof(more)) > 0) // nothing further: no marker
+  {
+    put(' ');
+    put('>');
+    for (const char *p = more; *p; p++)
+      putLabel(*p);
+  }
+  out[n] = '\0';
+  return n;
+}
+
+inline size_t morseFormatLetterLine(const char *symbols, MorseTrieNode node, char *out, size_t cap, char guess = '?')
+{
+  return morseFormatLetterLine(MORSE_TRIE, symbols, node, out, cap, guess);
+}
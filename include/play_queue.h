@@ -0,0 +1,183 @@
+#pragma once
+// Bounded queue of compiled stage programs for the keyer's player, by
+// priority. Entries point at programs owned elsewhere (memory slots, flash,
+// serial buffers), so queueing, switching and resuming never re-encode.
+//
+// Each priority is a FIFO threaded through one shared pool. The head of the
+// highest non-empty level plays; when something of higher priority arrives
+// it asks the keyer to yield at the next letter boundary, and the yielded
+// entry stays at the head of its level with its stage index and passes left,
+// so it resumes exactly there once the higher levels are empty.
+//
+// A key press stops playback as before. That ends the entry, except for a
+// beacon: keying only pauses it, and it picks up at the interrupted letter
+// once the keys have been quiet for the background hold-off.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include "keyer.h"
+
+enum PlayPriority : uint8_t
+{
+  PLAY_PRIO_BEACON = 0, // background loop, paused by keying
+  PLAY_PRIO_SERIAL = 1, // queued by a host
+  PLAY_PRIO_MEMORY = 2, // operator's memory chord
+  PLAY_PRIO_COUNT
+};
+
+struct PlayEntry
+{
+  const char *stages;
+  uint16_t len;
+  uint16_t resumeAt; // stage index to start from
+  uint8_t passes;    // left to play; 0 = loop until stopped
+  uint8_t source;    // TracePlaySource for the trace
+  uint8_t next;      // pool link
+};
+
+template <size_t Cap>
+class PlayQueue
+{
+  static_assert(Cap < 255, "pool links are uint8_t");
+
+public:
+  static const uint8_t NONE = 0xFF;
+
+  PlayQueue() { clear(); }
+
+  // Drop everything; the caller stops the keyer if an entry was playing
+  void clear()
+  {
+    for (uint8_t i = 0; i < Cap; i++)
+      pool_[i].next = (size_t)i + 1 < Cap ? (uint8_t)(i + 1) : NONE;
+    free_ = 0;
+    for (uint8_t p = 0; p < PLAY_PRIO_COUNT; p++)
+      head_[p] = tail_[p] = NONE;
+    count_ = 0;
+    playing_ = NONE;
+  }
+
+  // Queue a program at the back of its priority; false when the pool is full
+  bool push(const char *stages, size_t len, uint8_t priority, uint8_t passes, uint8_t source)
+  {
+    if (free_ == NONE || len == 0 || priority >= PLAY_PRIO_COUNT)
+      return false;
+    uint8_t i = free_;
+    free_ = pool_[i].next;
+    pool_[i] = {stages, (uint16_t)len, 0, passes, source, NONE};
+    if (tail_[priority] == NONE)
+      head_[priority] = i;
+    else
+      pool_[tail_[priority]].next = i;
+    tail_[priority] = i;
+    count_++;
+    return true;
+  }
+
+  // Remove every entry playing `stages` (its buffer is about to change)
+  void remove(const char *stages, Keyer &keyer)
+  {
+    for (uint8_t p = 0; p < PLAY_PRIO_COUNT; p++)
+    {
+      uint8_t prev = NONE;
+      for (uint8_t i = head_[p]; i != NONE;)
+      {
+        uint8_t next = pool_[i].next;
+        if (pool_[i].stages == stages)
+        {
+          if (i == playing_)
+          {
+            playing_ = NONE;
+            keyer.stopPlayback(KEYER_STOP_REMOTE);
+          }
+          unlink(p, prev, i);
+        }
+        else
+          prev = i;
+        i = next;
+      }
+    }
+  }
+
+  bool holds(const char *stages) const
+  {
+    for (uint8_t p = 0; p < PLAY_PRIO_COUNT; p++)
+      for (uint8_t i = head_[p]; i != NONE; i = pool_[i].next)
+        if (pool_[i].stages == stages)
+          return true;
+    return false;
+  }
+
+  // From the keyer listener's onPlayStop(): settles the entry that was playing
+  void stopped(uint8_t reason, const Keyer &keyer)
+  {
+    if (playing_ == NONE)
+      return;
+    PlayEntry &e = pool_[playing_];
+    uint8_t p = playingPrio_;
+    playing_ = NONE;
+    if (reason == KEYER_STOP_YIELD || (reason == KEYER_STOP_INPUT && p == PLAY_PRIO_BEACON))
+    {
+      e.resumeAt = (uint16_t)keyer.playResumeIndex();
+      e.passes = keyer.playPassesLeft();
+      return;
+    }
+    unlink(p, NONE, head_[p]); // the playing entry is always the head of its level
+  }
+
+  // Once per loop pass, after the keyer has been stepped to now. Operator
+  // entries start as soon as the keys are up; lower ones wait for quietMs
+  // of silence so they never start over someone keying.
+  void service(Keyer &keyer, uint32_t now, uint32_t quietMs)
+  {
+    uint8_t p = topPriority();
+    if (playing_ != NONE)
+    {
+      if (p != playingPrio_)
+        keyer.yieldPlayback();
+      return;
+    }
+    if (p == NONE || !keyer.idle(now, p >= PLAY_PRIO_MEMORY ? 0 : quietMs))
+      return;
+    const PlayEntry &e = pool_[head_[p]];
+    playing_ = head_[p];
+    playingPrio_ = p;
+    keyer.startPlaybackStages(e.stages, e.len, now, e.source, e.passes, e.resumeAt);
+  }
+
+  size_t size() const { return count_; }
+  bool full() const { return free_ == NONE; }
+  bool active() const { return playing_ != NONE; }
+
+private:
+  uint8_t topPriority() const
+  {
+    for (uint8_t p = PLAY_PRIO_COUNT; p-- > 0;)
+      if (head_[p] != NONE)
+        return p;
+    return NONE;
+  }
+
+  void unlink(uint8_t p, uint8_t prev, uint8_t i)
+  {
+    if (prev == NONE)
+      head_[p] = pool_[i].next;
+    else
+      pool_[prev].next = pool_[i].next;
+    if (tail_[p] == i)
+      tail_[p] = prev;
+    pool_[i].next = free_;
+    free_ = i;
+    count_--;
+  }
+
+  PlayEntry pool_[Cap];
+  uint8_t head_[PLAY_PRIO_COUNT];
+  uint8_t tail_[PLAY_PRIO_COUNT];
+  uint8_t free_ = NONE;
+  uint8_t count_ = 0;
+  uint8_t playing_ = NONE; // pool index the keyer is playing
+  uint8_t playingPrio_ = 0;
+};
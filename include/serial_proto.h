@@ -0,0 +1,253 @@
+#pragma once
+// Framed binary protocol on the command UART, beside the text commands.
+//
+// Wire: 0x00, COBS(body), 0x00. Text lines never contain a zero byte, so the
+// first zero switches the reader into a frame and the next one ends it; a
+// frame that stalls for PROTO_IDLE_MS is dropped and text mode resumes.
+//
+// Body = u8 type (ProtoType), u8 seq, payload, u32 CRC-32 (logCrc32) over
+// type, seq and payload. All fields little-endian. Every request gets one
+// reply carrying its seq; events carry seq 0.
+//
+// The reader takes one byte at a time into a fixed buffer and never waits
+// for the rest of a frame, so the loop can drain the UART and move on.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "key_trace.h"
+#include "session_log.h"
+
+const size_t PROTO_BODY_MAX = 200;                           // type + seq + payload + CRC
+const size_t PROTO_PAYLOAD_MAX = PROTO_BODY_MAX - 6;
+const size_t PROTO_WIRE_MAX = PROTO_BODY_MAX + PROTO_BODY_MAX / 254 + 3; // COBS + both zeros
+const uint32_t PROTO_IDLE_MS = 200;                          // a frame silent this long is dropped
+
+enum ProtoType : uint8_t
+{
+  // host -> device
+  PROTO_PING = 0x01,      // -> ACK
+  PROTO_PLAY = 0x02,      // u8 passes (0 = loop until stopped), text -> ACK (detail = messages queued);
+                          // BAD_ARG if nothing in it plays or it is too long for one message buffer
+  PROTO_SET_WPM = 0x03,   // u8 WPM -> ACK
+  PROTO_SET_PITCH = 0x04, // u16 Hz -> ACK
+  PROTO_GET_STATS = 0x05, // -> STATS
+  PROTO_SUBSCRIBE = 0x06, // u8 ProtoStream bits (0 = none) -> ACK
+  PROTO_STOP = 0x07,      // stop playback, drop queued messages, end a Koch/echo session -> ACK
+  PROTO_GET_ECHO = 0x08,  // u8 first character index -> ECHO
+  // device -> host
+  PROTO_ACK = 0x81,   // u8 request type, u8 ProtoStatus, u8 detail
+  PROTO_STATS = 0x82, // ProtoStats
+  PROTO_EVENT = 0x83, // u32 time ms, u8 TraceEventType, u8 arg, u8 payload (key_trace.h)
+  PROTO_ECHO = 0x84,  // u8 characters in all, u8 first index, echo drill records (echo_drill.h)
+};
+
+enum ProtoStatus : uint8_t
+{
+  PROTO_STATUS_OK = 0,
+  PROTO_STATUS_UNKNOWN = 1,     // no such request type
+  PROTO_STATUS_BAD_ARG = 2,     // payload missing or out of range
+  PROTO_STATUS_FULL = 3,        // no room to queue
+  PROTO_STATUS_UNSUPPORTED = 4, // not in this build (e.g. pitch on the active buzzer)
+};
+
+// Event streams for PROTO_SUBSCRIBE
+enum ProtoStream : uint8_t
+{
+  PROTO_STREAM_CHARS = 1, // commits, word spaces, clears
+  PROTO_STREAM_KEYS = 2,  // key presses and releases
+  PROTO_STREAM_PLAY = 4,  // playback start / stop
+};
+
+// Stream bit a trace event belongs to
+inline uint8_t protoStreamOf(uint8_t traceType)
+{
+  switch (traceType)
+  {
+  case TRACE_PRESS:
+  case TRACE_RELEASE:
+    return PROTO_STREAM_KEYS;
+  case TRACE_PLAY_START:
+  case TRACE_PLAY_STOP:
+    return PROTO_STREAM_PLAY;
+  default:
+    return PROTO_STREAM_CHARS;
+  }
+}
+
+struct ProtoStats
+{
+  uint32_t uptimeMs;
+  uint16_t unitMs;
+  uint16_t pitchHz;
+  uint32_t commits;       // letters committed since boot
+  uint32_t keyEdges;      // debounced presses + releases
+  uint8_t playing;        // 1 while playback runs
+  uint8_t queued;         // messages waiting to play
+  uint16_t framesOk;      // valid frames received
+  uint16_t framesBad;     // frames dropped (CRC, length, COBS, timeout)
+  uint16_t framesDropped; // replies and events not sent: UART full
+  uint32_t freeHeap;
+};
+const size_t PROTO_STATS_SIZE = 28;
+
+inline size_t protoEncodeStats(const ProtoStats &s, uint8_t *out)
+{
+  logPut32(out, s.uptimeMs);
+  logPut16(out + 4, s.unitMs);
+  logPut16(out + 6, s.pitchHz);
+  logPut32(out + 8, s.commits);
+  logPut32(out + 12, s.keyEdges);
+  out[16] = s.playing;
+  out[17] = s.queued;
+  logPut16(out + 18, s.framesOk);
+  logPut16(out + 20, s.framesBad);
+  logPut16(out + 22, s.framesDropped);
+  logPut32(out + 24, s.freeHeap);
+  return PROTO_STATS_SIZE;
+}
+
+inline bool protoDecodeStats(const uint8_t *p, size_t len, ProtoStats &s)
+{
+  if (len < PROTO_STATS_SIZE)
+    return false;
+  s.uptimeMs = logGet32(p);
+  s.unitMs = logGet16(p + 4);
+  s.pitchHz = logGet16(p + 6);
+  s.commits = logGet32(p + 8);
+  s.keyEdges = logGet32(p + 12);
+  s.playing = p[16];
+  s.queued = p[17];
+  s.framesOk = logGet16(p + 18);
+  s.framesBad = logGet16(p + 20);
+  s.framesDropped = logGet16(p + 22);
+  s.freeHeap = logGet32(p + 24);
+  return true;
+}
+
+// ================= Encode =================
+// Whole wire frame (both zeros included) into out[PROTO_WIRE_MAX]; returns
+// its length, 0 if the payload is too long
+inline size_t protoEncodeFrame(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len, uint8_t *out)
+{
+  if (len > PROTO_PAYLOAD_MAX)
+    return 0;
+  uint8_t head[2] = {type, seq};
+  uint8_t crc[4];
+  logPut32(crc, logCrc32(payload, len, logCrc32(head, 2)));
+
+  size_t n = 0;
+  out[n++] = 0x00;
+  size_t codeAt = n++; // COBS: each block starts with the distance to the next zero
+  uint8_t code = 1;
+  auto put = [&](uint8_t b) {
+    if (b != 0)
+    {
+      out[n++] = b;
+      code++;
+    }
+    if (b == 0 || code == 0xFF)
+    {
+      out[codeAt] = code;
+      codeAt = n++;
+      code = 1;
+    }
+  };
+  for (uint8_t b : head)
+    put(b);
+  for (size_t i = 0; i < len; i++)
+    put(payload[i]);
+  for (uint8_t b : crc)
+    put(b);
+  out[codeAt] = code;
+  out[n++] = 0x00;
+  return n;
+}
+
+// ================= Decode =================
+enum ProtoFeed : uint8_t
+{
+  PROTO_FEED_TEXT,  // not part of a frame: the caller's text byte
+  PROTO_FEED_BUSY,  // taken into the frame being read
+  PROTO_FEED_FRAME, // a valid frame just ended: type(), seq(), payload()
+  PROTO_FEED_BAD,   // a frame ended but was invalid and is dropped
+};
+
+class ProtoReader
+{
+public:
+  // One received byte at time nowMs (any clock in ms)
+  ProtoFeed feed(uint8_t b, uint32_t nowMs)
+  {
+    if (inFrame_ && nowMs - lastMs_ > PROTO_IDLE_MS)
+      inFrame_ = false; // stalled: whatever it was is gone
+    lastMs_ = nowMs;
+    if (!inFrame_)
+    {
+      if (b != 0x00)
+        return PROTO_FEED_TEXT;
+      inFrame_ = true;
+      len_ = 0;
+      left_ = 0;
+      code_ = 0xFF; // no zero owed before the first block
+      overflow_ = false;
+      return PROTO_FEED_BUSY;
+    }
+    if (b == 0x00)
+    {
+      inFrame_ = false;
+      if (len_ == 0 && !overflow_)
+      {
+        inFrame_ = true; // "00 00": treat the second zero as a fresh start
+        return PROTO_FEED_BUSY;
+      }
+      return finish() ? PROTO_FEED_FRAME : PROTO_FEED_BAD;
+    }
+    if (left_ == 0)
+    {
+      // a new COBS block; the previous one ended in a zero unless it was full
+      if (code_ != 0xFF)
+        push(0x00);
+      code_ = b;
+      left_ = (uint8_t)(b - 1);
+    }
+    else
+    {
+      push(b);
+      left_--;
+    }
+    return PROTO_FEED_BUSY;
+  }
+
+  bool inFrame() const { return inFrame_; }
+  uint8_t type() const { return body_[0]; }
+  uint8_t seq() const { return body_[1]; }
+  const uint8_t *payload() const { return body_ + 2; }
+  size_t payloadLen() const { return len_ - 6; }
+
+private:
+  void push(uint8_t b)
+  {
+    if (len_ < PROTO_BODY_MAX)
+      body_[len_++] = b;
+    else
+      overflow_ = true;
+  }
+
+  bool finish()
+  {
+    if (overflow_ || left_ != 0 || len_ < 6)
+      return false;
+    return logCrc32(body_, len_ - 4) == logGet32(body_ + len_ - 4);
+  }
+
+  uint8_t body_[PROTO_BODY_MAX] = {};
+  size_t len_ = 0;
+  uint8_t left_ = 0; // data bytes still due in the current COBS block
+  uint8_t code_ = 0xFF;
+  bool overflow_ = false;
+  bool inFrame_ = false;
+  uint32_t lastMs_ = 0;
+};
@@ -0,0 +1,384 @@
+#pragma once
+// Session log record format and batching, shared by the firmware (which
+// appends records to LittleFS) and host tools (which parse a serial dump).
+//
+// Record = 12-byte header + payload:
+//   u8  magic (0xA5)
+//   u8  type  (LOG_REC_*)
+//   u16 payload length
+//   u32 time of the first entry, ms since boot
+//   u32 CRC-32 over type, length, time and payload
+// All fields little-endian. A record cut short by power loss fails its CRC and
+// the reader resyncs on the next magic byte, so at most the tail is lost.
+//
+// Serial trace chunk (TRACE ON only, never in flash) = 4 bytes + events:
+//   u8  magic (0xA6)
+//   u8  events length
+//   u8  sequence, counting from 0 after the stream's header record
+//   ... events, deltas carrying on from the previous chunk
+//   u8  low byte of the CRC-32 over length, sequence and events
+// The stream's header goes out once as a LOG_REC_TRACE record, whose time
+// anchors every chunk after it.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "key_trace.h"
+
+const uint8_t LOG_MAGIC = 0xA5;
+const size_t LOG_HEADER_SIZE = 12;
+const uint8_t LOG_CHUNK_MAGIC = 0xA6;
+const size_t LOG_CHUNK_OVERHEAD = 4;
+const size_t LOG_CHUNK_MAX = 255; // events per chunk
+
+enum LogRecordType : uint8_t
+{
+  LOG_REC_BOOT = 1,  // payload: none
+  LOG_REC_TEXT = 2,  // payload: committed characters, in order
+  LOG_REC_TRACE = 4, // payload: key_trace.h events (optionally led by a stream
+                     // header), first delta counted from the record time
+  LOG_REC_TRACE_MORE = 5, // parsed serial chunk: events continuing the stream
+};
+
+// ================= CRC-32 (IEEE, reflected) =================
+inline uint32_t logCrc32(const uint8_t *p, size_t n, uint32_t crc = 0)
+{
+  static const uint32_t T[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++)
+  {
+    crc = (crc >> 4) ^ T[(crc ^ p[i]) & 0x0F];
+    crc = (crc >> 4) ^ T[(crc ^ (p[i] >> 4)) & 0x0F];
+  }
+  return ~crc;
+}
+
+inline void logPut16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+inline void logPut32(uint8_t *p, uint32_t v)
+{
+  for (int i = 0; i < 4; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+inline uint16_t logGet16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+inline uint32_t logGet32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ================= Encode / parse =================
+// Writes just the header (LOG_HEADER_SIZE bytes) for a payload kept elsewhere,
+// so a large buffer can be framed without copying it
+inline void logEncodeHeader(uint8_t type, uint32_t timeMs, const uint8_t *payload, uint16_t len, uint8_t *out)
+{
+  out[0] = LOG_MAGIC;
+  out[1] = type;
+  logPut16(out + 2, len);
+  logPut32(out + 4, timeMs);
+  uint32_t crc = logCrc32(out + 1, 7);
+  crc = logCrc32(payload, len, crc);
+  logPut32(out + 8, crc);
+}
+
+// Writes header + payload to out (LOG_HEADER_SIZE + len bytes)
+inline size_t logEncodeRecord(uint8_t type, uint32_t timeMs, const uint8_t *payload, uint16_t len, uint8_t *out)
+{
+  if (len)
+    memcpy(out + LOG_HEADER_SIZE, payload, len);
+  logEncodeHeader(type, timeMs, out + LOG_HEADER_SIZE, len, out);
+  return LOG_HEADER_SIZE + len;
+}
+
+struct LogRecordView
+{
+  uint8_t type;
+  uint16_t len;
+  uint32_t timeMs; // 0 for a chunk
+  const uint8_t *payload;
+  uint8_t seq; // chunks only
+};
+
+// Writes a chunk of len (<= LOG_CHUNK_MAX) event bytes to out
+// (LOG_CHUNK_OVERHEAD + len bytes)
+inline size_t logEncodeChunk(uint8_t seq, const uint8_t *events, size_t len, uint8_t *out)
+{
+  out[0] = LOG_CHUNK_MAGIC;
+  out[1] = (uint8_t)len;
+  out[2] = seq;
+  if (len)
+    memcpy(out + 3, events, len);
+  out[3 + len] = (uint8_t)logCrc32(out + 1, 2 + len);
+  return LOG_CHUNK_OVERHEAD + len;
+}
+
+enum LogParseResult
+{
+  LOG_PARSE_OK,   // rec filled; consume `used` bytes
+  LOG_PARSE_MORE, // need more bytes
+  LOG_PARSE_SKIP, // not a valid record here; skip `used` bytes and retry
+};
+
+inline LogParseResult logParseRecord(const uint8_t *buf, size_t n, LogRecordView &rec, size_t &used)
+{
+  used = 1;
+  if (n == 0)
+    return LOG_PARSE_MORE;
+  if (buf[0] == LOG_CHUNK_MAGIC)
+  {
+    if (n < LOG_CHUNK_OVERHEAD || n < LOG_CHUNK_OVERHEAD + buf[1])
+      return LOG_PARSE_MORE;
+    size_t len = buf[1];
+    if (buf[3 + len] != (uint8_t)logCrc32(buf + 1, 2 + len))
+      return LOG_PARSE_SKIP;
+    rec.type = LOG_REC_TRACE_MORE;
+    rec.len = (uint16_t)len;
+    rec.timeMs = 0;
+    rec.payload = buf + 3;
+    rec.seq = buf[2];
+    used = LOG_CHUNK_OVERHEAD + len;
+    return LOG_PARSE_OK;
+  }
+  if (buf[0] != LOG_MAGIC)
+    return LOG_PARSE_SKIP;
+  if (n < LOG_HEADER_SIZE)
+    return LOG_PARSE_MORE;
+  uint16_t len = logGet16(buf + 2);
+  if (n < LOG_HEADER_SIZE + len)
+    return LOG_PARSE_MORE;
+  uint32_t crc = logCrc32(buf + 1, 7);
+  crc = logCrc32(buf + LOG_HEADER_SIZE, len, crc);
+  if (crc != logGet32(buf + 8))
+    return LOG_PARSE_SKIP;
+  rec.type = buf[1];
+  rec.len = len;
+  rec.timeMs = logGet32(buf + 4);
+  rec.payload = buf + LOG_HEADER_SIZE;
+  rec.seq = 0;
+  used = LOG_HEADER_SIZE + len;
+  return LOG_PARSE_OK;
+}
+
+// ================= Batcher =================
+// Collects text and trace events in RAM and turns them into records once
+// enough has piled up or the oldest entry reaches maxAgeMs. Appends are O(1)
+// and never touch flash; the caller decides where drained records go.
+template <size_t Cap>
+class LogBatcher
+{
+public:
+  LogBatcher(uint32_t maxAgeMs, size_t flushBytes) : maxAgeMs_(maxAgeMs), flushBytes_(flushBytes) {}
+
+  // Returns false (and counts a drop) when the buffer is full
+  bool addText(char c, uint32_t now)
+  {
+    if (text_.len == 0)
+      text_.startMs = now;
+    if (text_.len >= Cap)
+      return drop();
+    text_.buf[text_.len++] = (uint8_t)c;
+    return true;
+  }
+
+  bool addTraceEvent(uint32_t now, uint8_t type, uint8_t arg = 0, uint8_t payload = 0)
+  {
+    if (trace_.len == 0 && !writer_.holding())
+      startTrace(now);
+    if (trace_.len + TRACE_EVENT_MAX > Cap)
+      return drop();
+    trace_.len += writer_.event(&trace_.buf[trace_.len], now, type, arg, payload);
+    return true;
+  }
+
+  // A stream header may only lead a record, so readers find it at the start
+  bool addTraceHeader(uint16_t unitMs, uint32_t now)
+  {
+    if (trace_.len != 0 || writer_.holding())
+      return false;
+    startTrace(now);
+    trace_.len = TraceWriter::header(trace_.buf, unitMs);
+    return true;
+  }
+
+  bool pending() const { return text_.len > 0 || trace_.len > 0; }
+
+  // Flush when either buffer is big enough or its first entry is old enough
+  bool due(uint32_t now) const
+  {
+    return text_.due(now, maxAgeMs_, flushBytes_) || trace_.due(now, maxAgeMs_, flushBytes_);
+  }
+
+  // Bytes drain() needs for everything pending
+  size_t drainSize() const
+  {
+    return (text_.len ? LOG_HEADER_SIZE + text_.len : 0) + (trace_.len ? LOG_HEADER_SIZE + trace_.len : 0);
+  }
+
+  // Encode pending entries as records into out (at least drainSize() bytes)
+  size_t drain(uint8_t *out)
+  {
+    size_t n = 0;
+    if (text_.len)
+      n += logEncodeRecord(LOG_REC_TEXT, text_.startMs, text_.buf, (uint16_t)text_.len, out + n);
+    if (trace_.len)
+      n += logEncodeRecord(LOG_REC_TRACE, trace_.startMs, trace_.buf, (uint16_t)trace_.len, out + n);
+    text_.len = 0;
+    trace_.len = 0;
+    if (writer_.holding())
+      trace_.startMs = writer_.lastMs(); // the held press opens the next record
+    return n;
+  }
+
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  struct Pending
+  {
+    uint8_t buf[Cap];
+    size_t len = 0;
+    uint32_t startMs = 0;
+
+    bool due(uint32_t now, uint32_t maxAgeMs, size_t flushBytes) const
+    {
+      return len > 0 && (len >= flushBytes || now - startMs >= maxAgeMs);
+    }
+  };
+
+  void startTrace(uint32_t now)
+  {
+    trace_.startMs = now;
+    writer_.reset(now);
+  }
+
+  bool drop()
+  {
+    dropped_++;
+    return false;
+  }
+
+  Pending text_;
+  Pending trace_;
+  TraceWriter writer_;
+  uint32_t maxAgeMs_;
+  size_t flushBytes_;
+  uint32_t dropped_ = 0;
+};
+
+// ================= Serial trace stream =================
+// TRACE ON: the header record once, then chunks of events on one delta chain,
+// each flushed like a batch (big enough or old enough). Four bytes of framing
+// per flush instead of a 12-byte record header.
+template <size_t Cap>
+class TraceStreamer
+{
+  static_assert(Cap <= LOG_CHUNK_MAX, "a chunk holds at most LOG_CHUNK_MAX bytes");
+
+public:
+  TraceStreamer(uint32_t maxAgeMs, size_t flushBytes) : maxAgeMs_(maxAgeMs), flushBytes_(flushBytes) {}
+
+  // The stream's header record into out (LOG_HEADER_SIZE + TRACE_HEADER_MAX
+  // bytes); events count from `now`
+  size_t start(uint16_t unitMs, uint32_t now, uint8_t *out)
+  {
+    uint8_t header[TRACE_HEADER_MAX];
+    size_t n = TraceWriter::header(header, unitMs);
+    writer_.reset(now);
+    len_ = 0;
+    seq_ = 0;
+    return logEncodeRecord(LOG_REC_TRACE, now, header, (uint16_t)n, out);
+  }
+
+  // Returns false (and counts a drop) when the buffer is full
+  bool add(uint32_t now, uint8_t type, uint8_t arg = 0, uint8_t payload = 0)
+  {
+    if (len_ == 0)
+      startMs_ = now;
+    if (len_ + TRACE_EVENT_MAX + TRACE_FLUSH_MAX > Cap)
+    {
+      dropped_++;
+      return false;
+    }
+    len_ += writer_.event(buf_ + len_, now, type, arg, payload);
+    return true;
+  }
+
+  bool due(uint32_t now) const { return len_ > 0 && (len_ >= flushBytes_ || now - startMs_ >= maxAgeMs_); }
+
+  // Pending events as a chunk into out (LOG_CHUNK_OVERHEAD + Cap bytes), 0 if
+  // none. `end` also lets go of a held press, for the end of the stream.
+  size_t drain(uint8_t *out, bool end = false)
+  {
+    if (end)
+      len_ += writer_.flush(buf_ + len_);
+    if (len_ == 0)
+      return 0;
+    size_t n = logEncodeChunk(seq_++, buf_, len_, out);
+    len_ = 0;
+    return n;
+  }
+
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  uint8_t buf_[Cap];
+  size_t len_ = 0;
+  uint32_t startMs_ = 0;
+  uint8_t seq_ = 0;
+  TraceWriter writer_;
+  uint32_t maxAgeMs_;
+  size_t flushBytes_;
+  uint32_t dropped_ = 0;
+};
+
+// ================= Following a trace =================
+// Reading side for traces spread over records and chunks: gives each payload
+// a TraceReader with the right time base. A record carries its own time; a
+// chunk carries on from the last event before it, so it is only read when it
+// is the next one after the stream's header record.
+class TraceFollower
+{
+public:
+  // Reader over rec's events, header already consumed (started = it had one);
+  // false if rec holds no trace events that can be placed in time
+  bool open(const LogRecordView &rec, TraceReader &rd, bool &started, uint16_t &unitMs)
+  {
+    started = false;
+    if (rec.type == LOG_REC_TRACE)
+    {
+      rd = TraceReader(rec.payload, rec.len, rec.timeMs);
+      if (rd.readHeader(unitMs))
+      {
+        started = live_ = true;
+        seq_ = 0;
+      }
+      return true;
+    }
+    if (rec.type != LOG_REC_TRACE_MORE)
+      return false;
+    if (!live_ || rec.seq != seq_)
+    {
+      live_ = false; // a chunk went missing: no time base until the next header
+      return false;
+    }
+    seq_++;
+    rd = TraceReader(rec.payload, rec.len, timeMs_);
+    return true;
+  }
+
+  // After reading rec's events: where the next chunk carries on from
+  void close(const TraceReader &rd) { timeMs_ = rd.timeMs(); }
+
+private:
+  bool live_ = false;
+  uint8_t seq_ = 0;
+  uint32_t timeMs_ = 0;
+};
@@ -0,0 +1,139 @@
+#pragma once
+// Gated sine generator with raised-cosine attack/release, producing 16-bit PCM
+// in blocks. Shared by the host WAV renderer and the firmware's audio output so
+// both shape tones identically.
+//
+// Portable (no Arduino dependencies). Per sample it costs one wavetable lookup
+// and a multiply; silent and steady-state stretches take fast paths.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// ================= Tone synth =================
+class ToneSynth
+{
+public:
+  static const uint16_t WAVE_BITS = 10; // 1024-entry sine table
+  static const uint16_t WAVE_SIZE = 1 << WAVE_BITS;
+  static const uint16_t ENV_STEPS = 64; // raised-cosine ramp table
+
+  // volume 0..1, edgeMs = attack/release ramp length (0 = hard keying)
+  void configure(uint32_t sampleRate, float pitchHz, float volume, float edgeMs)
+  {
+    sampleRate_ = sampleRate ? sampleRate : 1;
+    buildTables();
+    setPitch(pitchHz);
+    setVolume(volume);
+    setEdgeMs(edgeMs);
+    phase_ = 0;
+    envPos_ = 0;
+    gate_ = false;
+  }
+
+  void setPitch(float hz)
+  {
+    phaseStep_ = (uint32_t)(hz / (float)sampleRate_ * 4294967296.0f);
+  }
+
+  void setVolume(float v)
+  {
+    if (v < 0.0f)
+      v = 0.0f;
+    if (v > 1.0f)
+      v = 1.0f;
+    vol_ = (int32_t)(v * 32767.0f);
+  }
+
+  void setEdgeMs(float ms)
+  {
+    uint32_t rampSamples = (uint32_t)(ms * (float)sampleRate_ / 1000.0f);
+    envStep_ = rampSamples ? ENV_MAX / rampSamples : ENV_MAX;
+    if (envStep_ == 0)
+      envStep_ = 1;
+  }
+
+  void setGate(bool on) { gate_ = on; }
+  bool gate() const { return gate_; }
+
+  // True once the release has finished: output is exact silence
+  bool idle() const { return !gate_ && envPos_ == 0; }
+
+  void render(int16_t *out, size_t n)
+  {
+    const int16_t *wave = waveTable();
+    const int16_t *env = envTable();
+    while (n > 0)
+    {
+      if (idle())
+      {
+        // silence: restart the next tone at a zero crossing
+        memset(out, 0, n * sizeof(int16_t));
+        phase_ = 0;
+        return;
+      }
+      if (gate_ && envPos_ == ENV_MAX)
+      {
+        // steady tone
+        const int32_t g = vol_;
+        uint32_t ph = phase_;
+        for (size_t i = 0; i < n; i++)
+        {
+          out[i] = (int16_t)((wave[ph >> (32 - WAVE_BITS)] * g) >> 15);
+          ph += phaseStep_;
+        }
+        phase_ = ph;
+        return;
+      }
+      // attack or release ramp, one envelope step per sample
+      const int32_t w = wave[phase_ >> (32 - WAVE_BITS)];
+      const int32_t e = env[envPos_ >> ENV_FRAC_BITS];
+      *out++ = (int16_t)((w * ((vol_ * e) >> 15)) >> 15);
+      phase_ += phaseStep_;
+      n--;
+      if (gate_)
+        envPos_ = (ENV_MAX - envPos_ > envStep_) ? envPos_ + envStep_ : ENV_MAX;
+      else
+        envPos_ = (envPos_ > envStep_) ? envPos_ - envStep_ : 0;
+    }
+  }
+
+private:
+  static const uint32_t ENV_FRAC_BITS = 16;
+  static const uint32_t ENV_MAX = (uint32_t)(ENV_STEPS - 1) << ENV_FRAC_BITS;
+
+  static int16_t *waveTable()
+  {
+    static int16_t table[WAVE_SIZE];
+    return table;
+  }
+
+  static int16_t *envTable()
+  {
+    static int16_t table[ENV_STEPS];
+    return table;
+  }
+
+  static void buildTables()
+  {
+    static bool built = false;
+    if (built)
+      return;
+    int16_t *wave = waveTable();
+    for (uint16_t i = 0; i < WAVE_SIZE; i++)
+      wave[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * (float)M_PI * (float)i / (float)WAVE_SIZE));
+    int16_t *env = envTable();
+    for (uint16_t i = 0; i < ENV_STEPS; i++)
+      env[i] = (int16_t)lrintf(32767.0f * 0.5f * (1.0f - cosf((float)M_PI * (float)i / (float)(ENV_STEPS - 1))));
+    built = true;
+  }
+
+  uint32_t sampleRate_ = 8000;
+  uint32_t phase_ = 0;
+  uint32_t phaseStep_ = 0;
+  uint32_t envPos_ = 0;
+  uint32_t envStep_ = ENV_MAX;
+  int32_t vol_ = 32767;
+  bool gate_ = false;
+};
@@ -0,0 +1,26 @@
+#pragma once
+// xorshift32 for the practice modes: three shifts per number, no state
+// beyond one word, same sequence on the device and the host for a seed.
+// Not for anything that needs to be unpredictable.
+//
+// Portable (no Arduino dependencies).
+
+#include <stdint.h>
+
+struct TrainRng
+{
+  uint32_t state = 1;
+
+  void seed(uint32_t s) { state = s ? s : 1; } // 0 would stay 0 forever
+
+  uint32_t next()
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // 0..n-1 (n > 0); multiply-shift instead of %, no division
+  uint32_t below(uint32_t n) { return (uint32_t)(((uint64_t)next() * n) >> 32); }
+};
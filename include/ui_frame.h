@@ -0,0 +1,154 @@
+#pragma once
+// What the OLED shows, composed as text: six lines of at most UI_COLS
+// characters of the 6x8 font, each drawn at its own pixel row, plus the
+// columns to draw inverted (the character being sent). uiCompose() fills a
+// UiFrame from the keyer and the mode flags; drawUI() in main.cpp copies it to
+// the display, and tools/morse_bench.cpp times the same composition on the
+// host without one.
+//
+// Lines: 0 title, 1 unit and mode tag, 2 key states, 3 letter being keyed
+// (or a trainer hint, or playback progress), 4-5 decoded text tail or the
+// message being played.
+//
+// Portable (no Arduino dependencies).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "keyer.h"
+#include "koch_trainer.h"
+#include "morse_nearest.h"
+#include "morse_playmap.h"
+#include "morse_trie.h"
+
+const size_t UI_COLS = 21; // 6 px font at text size 1 on 128 px
+const size_t UI_LINES = 6;
+const uint8_t UI_LINE_Y[UI_LINES] = {0, 10, 22, 34, 46, 56}; // pixel row of each line
+
+struct UiFrame
+{
+  char line[UI_LINES][UI_COLS + 1]; // NUL-terminated
+  uint8_t hiLine;                   // line with the inverted columns
+  uint8_t hiCol, hiLen;             // hiLen 0 = nothing inverted
+};
+
+// Playback lines, re-cut only when the character being sent changes
+struct UiPlayLines
+{
+  char progress[UI_COLS + 1] = "";
+  char line[UI_COLS + 1] = "";
+  size_t hiCol = 0, hiLen = 0;
+  bool fresh = false; // the map was rebuilt since the lines were cut
+
+  template <size_t Cap>
+  void update(MorsePlayMap<Cap> &map, size_t playIndex)
+  {
+    if (!map.follow(playIndex) && !fresh)
+      return;
+    fresh = false;
+    snprintf(progress, sizeof(progress), "Sending %u/%u", (unsigned)map.current() + 1, (unsigned)map.size());
+    map.formatLine(line, UI_COLS, hiCol, hiLen);
+  }
+};
+
+// Everything besides the keyer that decides what is shown
+struct UiContext
+{
+  uint16_t unitMs;
+  bool replaying;
+  bool recording;
+  const KochTrainer *koch; // while a Koch session runs, else null
+  const char *echoLine;    // while the echo drill runs, else null
+  const UiPlayLines *play; // updated by the caller while the keyer plays
+};
+
+// Write s into a line from column col on, cut at the right edge
+inline void uiPut(UiFrame &f, size_t line, size_t col, const char *s)
+{
+  char *out = f.line[line];
+  size_t n = strlen(out);
+  while (n < col && n < UI_COLS)
+    out[n++] = ' ';
+  for (; *s && col < UI_COLS; s++)
+    out[col++] = *s;
+  if (col > n)
+    out[col] = '\0';
+}
+
+inline void uiCompose(UiFrame &f, const Keyer &keyer, const UiContext &c)
+{
+  for (size_t i = 0; i < UI_LINES; i++)
+    f.line[i][0] = '\0';
+  f.hiLine = f.hiCol = f.hiLen = 0;
+  char buf[32]; // uiPut() clips to UI_COLS
+  bool playing = keyer.playing();
+
+  uiPut(f, 0, 0, playing ? "ESP32 Morse (PLAYING)" : "ESP32 Morse (3-btn)");
+
+  // Unit + tag: what owns the keyer, if anything
+  snprintf(buf, sizeof(buf), "u=%ums", c.unitMs);
+  uiPut(f, 1, 0, buf);
+  const char *tag = playing       ? "jrcsrg"
+                    : c.replaying ? "REPLAY"
+                    : c.recording ? "REC"
+                    : c.koch      ? "KOCH"
+                    : c.echoLine  ? "ECHO"
+                                  : nullptr;
+  if (tag)
+    uiPut(f, 1, strlen(f.line[1]) + 2, tag);
+
+  uiPut(f, 2, 0, keyer.keyDown(TRACE_KEY_DOT) ? "DOT:DOWN" : "DOT:UP");
+  uiPut(f, 2, 10, keyer.keyDown(TRACE_KEY_DASH) ? "DASH:DOWN" : "DASH:UP");
+
+  // Building letter or a short hint. While keying: the elements, what they
+  // spell so far and what keying on can still reach.
+  bool idle = keyer.symbols()[0] == '\0';
+  if (playing)
+    uiPut(f, 3, 0, c.play->progress);
+  else if (idle && c.koch)
+  {
+    snprintf(buf, sizeof(buf), "Koch L%u group %u/%u", c.koch->level(), c.koch->groups() + 1, KOCH_SESSION_GROUPS);
+    uiPut(f, 3, 0, buf);
+  }
+  else if (idle && c.echoLine)
+    uiPut(f, 3, 0, c.echoLine);
+  else if (idle)
+    uiPut(f, 3, 0, "Letter: ");
+  else
+  {
+    const MorseCodec &codec = keyer.codec();
+    morseFormatLetterLine(*codec.trie, keyer.symbols(), keyer.trieNode(), buf, sizeof(buf),
+                          morseNearest(*codec.nearest, keyer.symbols()).ch);
+    uiPut(f, 3, 0, buf);
+  }
+
+  // The message being played with the character being sent inverted, or the
+  // newest decoded text that fits, prosigns as "<SK>"
+  if (playing)
+  {
+    uiPut(f, 4, 0, "Msg:");
+    uiPut(f, 5, 0, c.play->line);
+    f.hiLine = 5;
+    f.hiCol = (uint8_t)c.play->hiCol;
+    f.hiLen = (uint8_t)c.play->hiLen;
+    return;
+  }
+  uiPut(f, 4, 0, "Text:");
+  const char *text = keyer.text();
+  size_t len = keyer.textLen();
+  size_t start = morseTextTail(text, len, UI_COLS);
+  size_t col = 0;
+  if (start > 0) // older text out of view
+  {
+    start = morseTextTail(text, len, UI_COLS - 3);
+    uiPut(f, 5, 0, "...");
+    col = 3;
+  }
+  char label[6];
+  for (const char *p = text + start; *p; p++)
+  {
+    uiPut(f, 5, col, morseCharLabel(*p, label));
+    col += morseCharLabelLen(*p);
+  }
+}
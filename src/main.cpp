@@ -2,6 +2,23 @@
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SH110X.h>
+#include <Preferences.h>
+#include "morse_table.h"
+#include "morse_stages.h"
+#include "morse_literal.h"
+#include "session_log.h"
+#include "keyer.h"
+#include "key_recorder.h"
+#include "heap_monitor.h"
+#include "edge_jitter.h"
+#include "key_debounce.h"
+#include "key_sampler.h"
+#include "serial_proto.h"
+#include "play_queue.h"
+#include "morse_playmap.h"
+#include "koch_trainer.h"
+#include "echo_drill.h"
+#include "ui_frame.h"
 
 // ================= Pins =================
 #define DOT_BTN_PIN 13  // DOT button to GND
@@ -12,6 +29,97 @@
 // Active-LOW buzzer: LOW=ON, HIGH=OFF
 #define BUZZER_ACTIVE_LOW 1
 
+// ================= Audio output =================
+// 0 = active buzzer on BUZZER_PIN (fixed pitch, hard edges)
+// 1 = internal DAC on GPIO25, fed by I2S0 DMA (passive buzzer / small amp)
+// 2 = external I2S DAC/amp (e.g. MAX98357A) on I2S1
+// Modes 1 and 2 stream a wavetable sine with raised-cosine edges.
+#ifndef AUDIO_OUT_MODE
+#define AUDIO_OUT_MODE 0
+#endif
+#define AUDIO_I2S_BCK_PIN 26  // mode 2 only
+#define AUDIO_I2S_WS_PIN 25   // mode 2 only
+#define AUDIO_I2S_DATA_PIN 33 // mode 2 only
+const uint32_t AUDIO_SAMPLE_RATE = 16000;
+const size_t AUDIO_BLOCK = 64;    // samples per DMA refill (4 ms)
+const float AUDIO_EDGE_MS = 5.0f; // attack/release ramp
+uint16_t tonePitchHz = 700;       // runtime setting
+uint8_t toneVolumePct = 60;       // runtime setting
+
+// ================= CW receiver (optional) =================
+// Audio in on an ADC1 pin, sampled by I2S0 DMA and decoded by a Goertzel bank.
+// Every bin gets its own decoder; output is tagged with the bin's channel.
+#ifndef CW_RX_ENABLE
+#define CW_RX_ENABLE 0
+#endif
+#define CW_RX_ADC_CHANNEL ADC1_CHANNEL_6 // GPIO34
+#if CW_RX_ENABLE && AUDIO_OUT_MODE == 1
+#error "CW_RX_ENABLE and the internal DAC both need I2S0; use AUDIO_OUT_MODE 2"
+#endif
+const uint32_t CW_RX_SAMPLE_RATE = 8000;
+const size_t CW_RX_BINS = 16;        // channels across the pitch range
+const float CW_RX_LOW_HZ = 400.0f;   // lowest channel pitch
+const float CW_RX_HIGH_HZ = 1150.0f; // highest channel pitch
+const size_t CW_RX_BLOCK = 128;      // samples per detection block (16 ms)
+const float CW_RX_START_WPM = 20.0f; // initial speed guess, adapts per channel
+
+// ================= High-speed keying (optional) =================
+// Keys are sampled by a high-resolution timer instead of once per loop pass,
+// and each debounced edge carries the time it happened. The debounce window
+// follows the unit (UNIT_MS / HS_DEBOUNCE_DIV, at most DEBOUNCE_MS) with
+// VerticalDebouncer::DEBOUNCE_SAMPLES samples per window: at 60 WPM (20 ms
+// unit) a key must hold 5 ms and is sampled every 1.25 ms.
+#ifndef HS_KEYING_ENABLE
+#define HS_KEYING_ENABLE 0
+#endif
+const uint8_t HS_DEBOUNCE_DIV = 4;     // debounce window = unit / this
+const uint32_t HS_MIN_SAMPLE_US = 250; // fastest sample period
+const size_t HS_EDGE_QUEUE = 32;       // edges between two loop passes
+
+// ================= HMM decoder (optional) =================
+// A second decoder beside the keyer, on the same key edges: a Viterbi search
+// over mark/space durations and sender speed (morse_hmm.h) instead of fixed
+// gap thresholds, for irregular hand timing. Its letters go out on serial as
+// "HMM: <c>", about a letter behind the keyer, or at once after a pause.
+#ifndef HMM_DECODE_ENABLE
+#define HMM_DECODE_ENABLE 0
+#endif
+const size_t HMM_WINDOW = 32; // observations decided by lookback
+
+// ================= Alphabet =================
+// MORSE_ALPHABET (morse_table.h: 0 Latin, 1 Latin + accented letters,
+// 2 Cyrillic, 3 Wabun) picks the table at build time. With
+// MORSE_ALPHABET_RUNTIME every table's indexes go into flash as well and
+// serial ABC <name> switches the keyer between them.
+#ifndef MORSE_ALPHABET_RUNTIME
+#define MORSE_ALPHABET_RUNTIME 0
+#endif
+
+// ================= Session log =================
+// Decoded text and key edges are batched in RAM and appended to LittleFS by a
+// background task, so flash writes never stall keying. A power cut loses at
+// most LOG_FLUSH_MS worth of entries.
+#ifndef SESSION_LOG_ENABLE
+#define SESSION_LOG_ENABLE 1
+#endif
+const uint32_t LOG_FLUSH_MS = 5000;      // oldest entry waits at most this long
+const size_t LOG_FLUSH_BYTES = 256;      // or flush once this much is pending
+const size_t LOG_MAX_BYTES = 256 * 1024; // rotate session.log -> session.old
+
+// ================= Heap monitor =================
+// Every malloc/calloc/realloc is counted per subsystem (the linker wraps them,
+// see platformio.ini) and free heap / largest block are sampled regularly.
+// Serial HEAP prints a report; one also goes out every HEAP_REPORT_MS.
+const uint32_t HEAP_SAMPLE_MS = 1000;
+const uint32_t HEAP_REPORT_MS = 10UL * 60 * 1000; // 0 = only on request
+const uint8_t HEAP_FRAG_WARN_PCT = 50;            // warn at this fragmentation
+const uint32_t HEAP_LOW_WARN_BYTES = 16 * 1024;   // warn below this much free
+
+// ================= Edge jitter =================
+// Every playback tone edge is timed against its ideal schedule; serial JITTER
+// prints the lateness histogram and percentiles (JITTER RESET clears it).
+const uint32_t JITTER_BIN_US = 250; // histogram resolution
+
 // ================= OLED (SH1106) =================
 #define OLED_W 128
 #define OLED_H 64
@@ -30,591 +138,1918 @@ const uint16_t DEBOUNCE_MS = 25;
 
 const uint16_t CLEAR_HOLD_MS = 2000;     // OK long-press clears
 const uint16_t OK_MULTI_WINDOW_MS = 600; // triple-tap window
+const bool EARLY_COMMIT = true;          // commit once no longer code can follow (F, Q, 0, most punctuation)
+const uint8_t GUESS_MIN_CONFIDENCE = 0;  // unknown codes commit the nearest character at least this sure (0..100), else '?'
+const uint16_t WORD_FIX_MAX_COST = 4;    // dictionary correction of closed words; 0 = off
 
-// Playback timings (fixed to UNIT_MS at boot)
+// Playback timings at boot; setUnitMs() rescales playTiming
 const uint16_t PLAY_DOT_MS = 1 * 120;       // tone
 const uint16_t PLAY_DASH_MS = 3 * 120;      // tone
 const uint16_t PLAY_INTER_GAP_MS = 1 * 120; // between parts of a letter
 const uint16_t PLAY_LOOP_GAP_MS = 3 * 120;  // between full-message loops
 
+// Stage durations as the player (and the host renderer) look them up
+MorseTiming playTiming = {PLAY_DOT_MS, PLAY_DASH_MS, PLAY_INTER_GAP_MS, LETTER_GAP_MS, WORD_GAP_MS, PLAY_LOOP_GAP_MS};
+
 // ================= Buffer / display caps =================
-const size_t MAX_TEXT_LEN = 120;
-const size_t OLED_TAIL_CHARS = 40;
+// Committed text is capped at KEYER_TEXT_MAX (keyer.h), OLED lines at
+// UI_COLS (ui_frame.h)
 
 // ================= Button state =================
-struct Btn
-{
-  uint8_t pin;
-  bool stable;
-  bool prevStable;
-  uint32_t lastEdgeMs;
-  uint32_t pressStartMs;
-};
+#include <soc/gpio_reg.h>
+
+// All keys come from one GPIO_IN_REG read per sample and are debounced
+// together (key_debounce.h): a key changes state once it has read the other
+// way for DEBOUNCE_SAMPLES ticks of DEBOUNCE_TICK_MS. More keys = more bits.
+static_assert(DOT_BTN_PIN < 32 && DASH_BTN_PIN < 32 && OK_BTN_PIN < 32, "keys must be on GPIO0-31 (GPIO_IN_REG)");
+const uint32_t KEY_DOT_BIT = 1UL << DOT_BTN_PIN;
+const uint32_t KEY_DASH_BIT = 1UL << DASH_BTN_PIN;
+const uint32_t KEY_OK_BIT = 1UL << OK_BTN_PIN;
+const uint32_t KEY_MASK = KEY_DOT_BIT | KEY_DASH_BIT | KEY_OK_BIT;
+const uint16_t DEBOUNCE_TICK_MS = DEBOUNCE_MS / VerticalDebouncer::DEBOUNCE_SAMPLES;
 
-Btn btnDot{DOT_BTN_PIN, false, false, 0, 0};
-Btn btnDash{DASH_BTN_PIN, false, false, 0, 0};
-Btn btnOk{OK_BTN_PIN, false, false, 0, 0};
-
-bool prevAnyPressed = false;
-uint32_t lastSilenceStartMs = 0;
-
-// ================= OK multi-click tracking =================
-uint8_t okMultiCount = 0;
-uint32_t okMultiStartMs = 0;
-bool okClearLatched = false;
-
-// ================= Playback state machine =================
-// We encode a full "stage" sequence with symbols:
-// '.'  = dot tone (1u)
-// '-'  = dash tone (3u)
-// 'i'  = inter-element gap (1u)
-// '|'  = inter-letter gap (3u)
-// '/'  = inter-word gap (7u)
-bool playActive = false;
-String playSequence = "";    // sequence of stage symbols
-size_t playIndex = 0;        // current stage index
-uint32_t playStageStart = 0; // millis when current stage started
-uint16_t playStageDur = 0;   // ms duration of current stage
-bool playToneOn = false;     // stage is tone (true) or gap (false)
-bool playInLoopGap = false;  // true while we’re in the loop gap
-
-// Keep last committed pattern for single-letter play if needed
-String lastCommittedPattern = "";
+VerticalDebouncer keyDebounce;
+uint32_t keyLastSampleMs = 0;
+
+// ================= Keyer =================
+// Gap/commit logic, OK gestures and playback live in keyer.h so a recorded
+// session replays through exactly the same code on the device and the host.
+// Its listener (further down) drives the buzzer, the logs and the memories.
+Keyer keyer;
+uint32_t keyerClockMs = 0; // time the keyer was last stepped to; trace events carry it
 
 // ================= Buzzer helpers =================
+#if AUDIO_OUT_MODE == 0
 inline void buzzerOn() { digitalWrite(BUZZER_PIN, BUZZER_ACTIVE_LOW ? LOW : HIGH); }
 inline void buzzerOff() { digitalWrite(BUZZER_PIN, BUZZER_ACTIVE_LOW ? HIGH : LOW); }
+#else
+#include <driver/i2s.h>
+#include "tone_synth.h"
+
+#if AUDIO_OUT_MODE == 1
+#define AUDIO_I2S_PORT I2S_NUM_0
+#else
+#define AUDIO_I2S_PORT I2S_NUM_1
+#endif
+
+// The audio task owns the synth; the keyer only flips these and the task
+// picks them up at the next block boundary.
+ToneSynth audioSynth;
+volatile bool audioGate = false;
+volatile uint16_t audioPitchHz = 0;
+volatile uint8_t audioVolumePct = 0;
+TaskHandle_t audioTaskHandle = NULL;
+
+inline void buzzerOn() { audioGate = true; }
+inline void buzzerOff() { audioGate = false; }
 
-// ================= Morse table =================
-typedef struct
+// Render one block at a time and hand it to DMA; i2s_write() blocks until a
+// DMA buffer is free, so the CPU only wakes once per block.
+void audioTask(void *)
 {
-  const char *pattern;
-  char ch;
-} MorseEntry;
-const MorseEntry MORSE_TABLE[] = {
-    {".-", 'A'}, {"-...", 'B'}, {"-.-.", 'C'}, {"-..", 'D'}, {".", 'E'}, {"..-.", 'F'}, {"--.", 'G'}, {"....", 'H'}, {"..", 'I'}, {".---", 'J'}, {"-.-", 'K'}, {".-..", 'L'}, {"--", 'M'}, {"-.", 'N'}, {"---", 'O'}, {".--.", 'P'}, {"--.-", 'Q'}, {".-.", 'R'}, {"...", 'S'}, {"-", 'T'}, {"..-", 'U'}, {"...-", 'V'}, {".--", 'W'}, {"-..-", 'X'}, {"-.--", 'Y'}, {"--..", 'Z'}, {"-----", '0'}, {".----", '1'}, {"..---", '2'}, {"...--", '3'}, {"....-", '4'}, {".....", '5'}, {"-....", '6'}, {"--...", '7'}, {"---..", '8'}, {"----.", '9'}, {".-.-.-", '.'}, {"--..--", ','}, {"..--..", '?'}, {".----.", '\''}, {"-.-.--", '!'}, {"-..-.", '/'}, {"-.--.", '('}, {"-.--.-", ')'}, {".-...", '&'}, {"---...", ':'}, {"-.-.-.", ';'}, {"-...-", '='}, {".-.-.", '+'}, {"-....-", '-'}, {"..--.-", '_'}, {".-..-.", '"'}, {".--.-.", '@'}};
-const size_t MORSE_TABLE_LEN = sizeof(MORSE_TABLE) / sizeof(MORSE_TABLE[0]);
+  static int16_t block[AUDIO_BLOCK];
+  static uint16_t frames[AUDIO_BLOCK * 2]; // L/R pairs
+  uint16_t pitch = 0;
+  uint8_t volume = 0;
+  for (;;)
+  {
+    if (pitch != audioPitchHz)
+    {
+      pitch = audioPitchHz;
+      audioSynth.setPitch(pitch);
+    }
+    if (volume != audioVolumePct)
+    {
+      volume = audioVolumePct;
+      audioSynth.setVolume(volume / 100.0f);
+    }
+    audioSynth.setGate(audioGate);
+    audioSynth.render(block, AUDIO_BLOCK);
+    for (size_t i = 0; i < AUDIO_BLOCK; i++)
+    {
+#if AUDIO_OUT_MODE == 1
+      uint16_t v = (uint16_t)(block[i] + 0x8000); // DAC takes the top 8 bits, unsigned
+#else
+      uint16_t v = (uint16_t)block[i];
+#endif
+      frames[2 * i] = v;
+      frames[2 * i + 1] = v;
+    }
+    size_t written = 0;
+    i2s_write(AUDIO_I2S_PORT, frames, sizeof(frames), &written, portMAX_DELAY);
+  }
+}
+
+void setupAudioOut()
+{
+  i2s_config_t cfg = {};
+#if AUDIO_OUT_MODE == 1
+  cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN);
+  cfg.communication_format = I2S_COMM_FORMAT_STAND_MSB;
+#else
+  cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+  cfg.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+#endif
+  cfg.sample_rate = AUDIO_SAMPLE_RATE;
+  cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  cfg.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+  cfg.dma_buf_count = 3;
+  cfg.dma_buf_len = AUDIO_BLOCK;
+  cfg.tx_desc_auto_clear = true; // an underrun plays silence, not a stuck sample
+  i2s_driver_install(AUDIO_I2S_PORT, &cfg, 0, NULL);
+#if AUDIO_OUT_MODE == 1
+  i2s_set_pin(AUDIO_I2S_PORT, NULL);          // route to the built-in DAC
+  i2s_set_dac_mode(I2S_DAC_CHANNEL_RIGHT_EN); // GPIO25
+#else
+  i2s_pin_config_t pins = {};
+  pins.mck_io_num = I2S_PIN_NO_CHANGE;
+  pins.bck_io_num = AUDIO_I2S_BCK_PIN;
+  pins.ws_io_num = AUDIO_I2S_WS_PIN;
+  pins.data_out_num = AUDIO_I2S_DATA_PIN;
+  pins.data_in_num = I2S_PIN_NO_CHANGE;
+  i2s_set_pin(AUDIO_I2S_PORT, &pins);
+#endif
+
+  audioPitchHz = tonePitchHz;
+  audioVolumePct = toneVolumePct;
+  audioSynth.configure(AUDIO_SAMPLE_RATE, tonePitchHz, toneVolumePct / 100.0f, AUDIO_EDGE_MS);
+  xTaskCreatePinnedToCore(audioTask, "audio", 3072, NULL, 5, &audioTaskHandle, 0);
+}
+#endif
 
-char decodeMorse(const String &pattern)
+// Runtime tone settings (no effect on the fixed-pitch active buzzer)
+void setTonePitch(uint16_t hz)
 {
-  for (size_t i = 0; i < MORSE_TABLE_LEN; i++)
-    if (pattern.equals(MORSE_TABLE[i].pattern))
-      return MORSE_TABLE[i].ch;
-  return '?';
+  tonePitchHz = hz;
+#if AUDIO_OUT_MODE != 0
+  audioPitchHz = hz;
+#endif
 }
 
-String encodeMorse(char ch)
+void setToneVolume(uint8_t pct)
 {
-  if (ch >= 'a' && ch <= 'z')
-    ch = ch - 'a' + 'A';
-  for (size_t i = 0; i < MORSE_TABLE_LEN; i++)
-    if (MORSE_TABLE[i].ch == ch)
-      return String(MORSE_TABLE[i].pattern);
-  return "";
+  toneVolumePct = pct > 100 ? 100 : pct;
+#if AUDIO_OUT_MODE != 0
+  audioVolumePct = toneVolumePct;
+#endif
 }
 
-// ================= Buffers =================
-String currentSymbols = ""; // uncommitted pattern for current letter
-String decodedText = "";    // committed text
-bool textWasTrimmed = false;
+// ================= Session log =================
+#if SESSION_LOG_ENABLE
+#include <LittleFS.h>
 
-// ================= Utilities =================
-inline bool rawPressed(uint8_t pin) { return digitalRead(pin) == LOW; } // buttons active-LOW
-inline bool anyPressed() { return btnDot.stable || btnDash.stable; }    // DOT/DASH only
+const char *const LOG_PATH = "/session.log";
+const char *const LOG_OLD_PATH = "/session.old";
+const size_t LOG_BATCH_CAP = 512;
+
+LogBatcher<LOG_BATCH_CAP> logBatch(LOG_FLUSH_MS, LOG_FLUSH_BYTES);
+uint8_t logWriteBuf[2 * (LOG_HEADER_SIZE + LOG_BATCH_CAP)];
+volatile size_t logWriteLen = 0; // non-zero while the writer task owns logWriteBuf
+volatile bool logRotateDue = false; // set by the writer, acted on by the loop
+TaskHandle_t logTask = NULL;
+bool logReady = false;
+
+// Serial dump in progress: streams session.old then session.log
+File logDumpFile;
+uint8_t logDumpStage = 0; // 0 = idle, 1 = old file, 2 = current file
 
-void ensureTextLimit()
+// The writer keeps session.log open between batches: opening a File allocates
+// its handle and cache, and doing that every few seconds for weeks is the kind
+// of churn that fragments the heap. Only the writer task touches it, except
+// clearSessionLog() and the rotation in serviceSessionLog(), which run while
+// the writer is idle.
+File logFile;
+
+// Appends one handed-over batch per wakeup; runs at low priority on core 0
+void logWriterTask(void *)
 {
-  if (decodedText.length() > MAX_TEXT_LEN)
+  for (;;)
   {
-    decodedText.remove(0, decodedText.length() - MAX_TEXT_LEN);
-    textWasTrimmed = true;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!logFile)
+      logFile = LittleFS.open(LOG_PATH, FILE_APPEND);
+    if (logFile)
+    {
+      logFile.write(logWriteBuf, logWriteLen);
+      logFile.flush();
+      if (logFile.size() > LOG_MAX_BYTES)
+        logRotateDue = true; // before the handback below
+    }
+    logWriteLen = 0;
   }
 }
-void pushChar(char c)
-{
-  decodedText += c;
-  ensureTextLimit();
-}
-void pushSpaceIfNeeded()
+
+void setupSessionLog()
 {
-  if (decodedText.length() == 0)
-    return;
-  if (decodedText[decodedText.length() - 1] != ' ')
+  if (!LittleFS.begin(true))
   {
-    decodedText += ' ';
-    ensureTextLimit();
+    Serial.println("LOG: LittleFS mount failed");
+    return;
   }
+  xTaskCreatePinnedToCore(logWriterTask, "log", 4096, NULL, 1, &logTask, 0);
+  logReady = true;
+  logWriteLen = logEncodeRecord(LOG_REC_BOOT, millis(), nullptr, 0, logWriteBuf);
+  xTaskNotifyGive(logTask);
+  // Each boot starts a fresh trace stream
+  logBatch.addTraceHeader(UNIT_MS, millis());
 }
 
-void commitLetterIfAny()
+inline void logText(char c)
 {
-  if (currentSymbols.length() == 0)
-    return;
-  char c = decodeMorse(currentSymbols);
-  pushChar(c);
-  lastCommittedPattern = currentSymbols;
-  Serial.printf("LETTER: %s -> %c\n", currentSymbols.c_str(), c);
-  currentSymbols = "";
+  if (logReady)
+    logBatch.addText(c, millis());
 }
 
-void clearAll()
+// Hand pending entries to the writer when due (or when forced). If the writer
+// is still busy, entries keep collecting in the batcher.
+void serviceSessionLog(uint32_t now, bool force = false)
 {
-  decodedText = "";
-  currentSymbols = "";
-  lastCommittedPattern = "";
-  textWasTrimmed = false;
-  Serial.println("** CLEAR **");
+  if (!logReady || logWriteLen != 0)
+    return;
+  // Rotated here rather than in the writer: the loop also starts and runs
+  // dumps, so session.old is never replaced while it is being read
+  if (logRotateDue && logDumpStage == 0)
+  {
+    logFile.close();
+    LittleFS.remove(LOG_OLD_PATH);
+    LittleFS.rename(LOG_PATH, LOG_OLD_PATH);
+    logRotateDue = false;
+  }
+  if (!(force ? logBatch.pending() : logBatch.due(now)))
+    return;
+  logWriteLen = logBatch.drain(logWriteBuf);
+  xTaskNotifyGive(logTask);
 }
 
-// Debounce + edge detect for a single button.
-// Returns: 0=no event, +1=pressed, -1=released
-int8_t updateButton(Btn &b, uint32_t now)
+// Stream the raw log in small pieces so keying continues during a dump.
+// Records carry their own magic and CRC, so a host parser resyncs past any
+// text lines that get interleaved.
+void serviceLogDump()
 {
-  bool raw = rawPressed(b.pin);
-  if (raw != b.stable)
+  while (logDumpStage != 0)
   {
-    if (now - b.lastEdgeMs >= DEBOUNCE_MS)
+    if (!logDumpFile)
     {
-      b.prevStable = b.stable;
-      b.stable = raw;
-      b.lastEdgeMs = now;
-      if (b.stable)
-      {
-        b.pressStartMs = now;
-        return +1;
-      } // pressed
-      else
+      logDumpFile = LittleFS.open(logDumpStage == 1 ? LOG_OLD_PATH : LOG_PATH, FILE_READ);
+      if (!logDumpFile)
       {
-        return -1;
-      } // released
+        if (++logDumpStage > 2)
+        {
+          logDumpStage = 0;
+          Serial.println("\nLOG END");
+        }
+        continue;
+      }
+    }
+    int room = Serial.availableForWrite();
+    if (room <= 0)
+      return;
+    uint8_t chunk[128];
+    size_t n = logDumpFile.read(chunk, room < (int)sizeof(chunk) ? (size_t)room : sizeof(chunk));
+    if (n > 0)
+    {
+      Serial.write(chunk, n);
+      return;
+    }
+    logDumpFile.close();
+    if (++logDumpStage > 2)
+    {
+      logDumpStage = 0;
+      Serial.println("\nLOG END");
     }
   }
-  else
-  {
-    b.lastEdgeMs = now;
-  }
-  return 0;
 }
 
-// -------- Build play sequence (stages) --------
-// Build stages for one Morse pattern (".-" etc.)
-String buildStagesForPattern(const String &pat)
+void startLogDump(uint32_t now)
 {
-  String seq;
-  for (int i = 0; i < (int)pat.length(); ++i)
+  if (!logReady || logDumpStage != 0)
+    return;
+  serviceSessionLog(now, true);
+  size_t total = 0;
+  const char *const paths[] = {LOG_OLD_PATH, LOG_PATH};
+  for (const char *path : paths)
   {
-    char s = pat[i];
-    if (s == '.' || s == '-')
+    File f = LittleFS.open(path, FILE_READ);
+    if (f)
     {
-      seq += s; // tone
-      if (i < (int)pat.length() - 1)
-        seq += 'i'; // inter-element gap (1u) except after last element
+      total += f.size();
+      f.close();
     }
   }
-  return seq;
+  Serial.printf("LOG BEGIN %u\n", (unsigned)total);
+  logDumpStage = 1;
 }
 
-// Build full play sequence from a text message (letters/spaces)
-String buildStagesFromText(const String &msg)
+void clearSessionLog()
 {
-  String seq;
-  for (int i = 0; i < (int)msg.length(); ++i)
+  if (!logReady || logWriteLen != 0 || logDumpStage != 0)
   {
-    char ch = msg[i];
-    if (ch == ' ')
-    {
-      // collapse consecutive spaces into one word gap
-      if (seq.length() == 0 || seq[seq.length() - 1] == '/')
-        continue;
-      // replace a trailing letter gap with word gap, if present
-      if (seq.length() > 0 && seq[seq.length() - 1] == '|')
-        seq.remove(seq.length() - 1);
-      seq += '/'; // word gap (7u)
-      continue;
-    }
-    String pat = encodeMorse(ch);
-    if (pat.length() == 0)
-      continue; // skip unknown chars
-    seq += buildStagesForPattern(pat);
-    // add inter-letter gap unless next char is space or end
-    // look ahead to next non-space valid char
-    int j = i + 1;
-    while (j < (int)msg.length() && msg[j] == ' ')
-      j++;
-    if (j < (int)msg.length())
-    {
-      // next is another letter/number/punct
-      seq += '|';
-    }
+    Serial.println("LOG: BUSY");
+    return;
   }
-  // remove trailing letter gap if any
-  if (seq.length() > 0 && seq[seq.length() - 1] == '|')
-    seq.remove(seq.length() - 1);
-  return seq;
-}
-
-// Build sequence for currentSymbols OR entire decodedText
-String buildStagesForPlayback()
-{
-  if (currentSymbols.length() > 0)
-  {
-    return buildStagesForPattern(currentSymbols); // play in-progress letter
-  }
-  // Build from full committed text
-  // Trim trailing spaces
-  String msg = decodedText;
-  while (msg.length() > 0 && msg[msg.length() - 1] == ' ')
-    msg.remove(msg.length() - 1);
-  return buildStagesFromText(msg);
-}
-
-// -------- Playback engine --------
-void startStageFromIndex(uint32_t now)
-{
-  if (playIndex >= playSequence.length())
-  {
-    // end of message -> loop gap
-    playInLoopGap = true;
-    playToneOn = false;
-    playStageDur = PLAY_LOOP_GAP_MS;
-    playStageStart = now;
-    buzzerOff();
-    return;
-  }
-  char s = playSequence[playIndex];
-  switch (s)
-  {
-  case '.':
-    playToneOn = true;
-    playStageDur = PLAY_DOT_MS;
-    buzzerOn();
-    break;
-  case '-':
-    playToneOn = true;
-    playStageDur = PLAY_DASH_MS;
-    buzzerOn();
-    break;
-  case 'i':
-    playToneOn = false;
-    playStageDur = PLAY_INTER_GAP_MS;
-    buzzerOff();
-    break;
-  case '|':
-    playToneOn = false;
-    playStageDur = LETTER_GAP_MS;
-    buzzerOff();
-    break;
-  case '/':
-    playToneOn = false;
-    playStageDur = WORD_GAP_MS;
-    buzzerOff();
-    break;
-  default:
-    playToneOn = false;
-    playStageDur = PLAY_INTER_GAP_MS;
-    buzzerOff();
-    break;
+  logFile.close();
+  LittleFS.remove(LOG_OLD_PATH);
+  LittleFS.remove(LOG_PATH);
+  Serial.println("LOG: CLEARED");
+}
+#else
+inline void logText(char) {}
+#endif
+
+// ================= Serial protocol =================
+// COBS frames (serial_proto.h) share the port with the text commands: a zero
+// byte starts one. Replies and subscribed events go out only when the UART
+// buffer has room for the whole frame; otherwise they are counted and dropped
+// so a slow host never holds up the loop. Keep TRACE OFF while using it.
+ProtoReader protoReader;
+uint8_t protoStreams = 0; // ProtoStream bits subscribed
+uint16_t protoFramesOk = 0;
+uint16_t protoFramesBad = 0;
+uint16_t protoFramesDropped = 0;
+uint32_t protoCommits = 0;
+uint32_t protoKeyEdges = 0;
+
+void protoSend(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len)
+{
+  uint8_t out[PROTO_WIRE_MAX];
+  size_t n = protoEncodeFrame(type, seq, payload, len, out);
+  if (n == 0 || Serial.availableForWrite() < (int)n)
+  {
+    protoFramesDropped++;
+    return;
   }
-  playStageStart = now;
+  Serial.write(out, n);
 }
 
-void stopPlayback()
+void protoAck(uint8_t seq, uint8_t request, uint8_t status, uint8_t detail = 0)
 {
-  playActive = false;
-  buzzerOff();
+  uint8_t p[3] = {request, status, detail};
+  protoSend(PROTO_ACK, seq, p, sizeof(p));
 }
 
-void startPlayback(uint32_t now)
+// Every trace event passes through here: counted for STATS, sent if subscribed
+void protoEvent(uint32_t now, uint8_t type, uint8_t arg, uint8_t payload)
 {
-  playSequence = buildStagesForPlayback();
-  if (playSequence.length() == 0)
-  {
-    Serial.println("PLAY: NO SEQUENCE");
+  if (type == TRACE_COMMIT)
+    protoCommits++;
+  else if (type == TRACE_PRESS || type == TRACE_RELEASE)
+    protoKeyEdges++;
+  if (!(protoStreams & protoStreamOf(type)))
     return;
-  }
-  playIndex = 0;
-  playActive = true;
-  playInLoopGap = false;
-  startStageFromIndex(now);
-  Serial.print("PLAY START: stages=");
-  Serial.println(playSequence);
+  uint8_t p[7];
+  logPut32(p, now);
+  p[4] = type;
+  p[5] = arg;
+  p[6] = payload;
+  protoSend(PROTO_EVENT, 0, p, sizeof(p));
+}
+
+// ================= Key trace =================
+// Binary event trace (key_trace.h) written to the session log and, after
+// TRACE ON, streamed on Serial: one header record, then CRC-checked chunks
+// (session_log.h). The readable event lines (DOT, LETTER: ..., GAP: ...) are
+// muted while streaming.
+const uint32_t TRACE_SERIAL_FLUSH_MS = 1000;
+const size_t TRACE_SERIAL_FLUSH_BYTES = 96;
+
+TraceStreamer<128> traceSerialStream(TRACE_SERIAL_FLUSH_MS, TRACE_SERIAL_FLUSH_BYTES);
+bool traceStreaming = false;
+
+// Session recording (REC); same events, kept in RAM for replay
+const size_t REC_CAP = 16 * 1024; // ~250 words of keying at ~13 bytes per letter
+KeyRecorder<REC_CAP> recorder;
+
+// Human-readable event line, unless the binary trace has the port. Keep these
+// under 64 bytes: longer printf() output is formatted in a malloc'd buffer.
+#define EVENT_LOG(...)           \
+  do                             \
+  {                              \
+    if (!traceStreaming)         \
+      Serial.printf(__VA_ARGS__); \
+  } while (0)
+
+void traceEvent(uint8_t type, uint8_t arg = 0, uint8_t payload = 0)
+{
+  uint32_t now = keyerClockMs;
+#if SESSION_LOG_ENABLE
+  if (logReady)
+    logBatch.addTraceEvent(now, type, arg, payload);
+#endif
+  if (traceStreaming)
+    traceSerialStream.add(now, type, arg, payload);
+  recorder.add(now, type, arg, payload);
+  protoEvent(now, type, arg, payload);
 }
 
-void servicePlayback(uint32_t now)
+void serviceTraceStream(uint32_t now, bool end = false)
 {
-  if (!playActive)
+  if (!end && !traceSerialStream.due(now))
     return;
+  uint8_t out[LOG_CHUNK_OVERHEAD + 128];
+  size_t n = traceSerialStream.drain(out, end);
+  if (n)
+    Serial.write(out, n);
+}
 
-  // if we're in loop gap and it finished, restart from beginning
-  if (playInLoopGap)
-  {
-    if (now - playStageStart >= playStageDur)
-    {
-      playInLoopGap = false;
-      playIndex = 0;
-      startStageFromIndex(now);
-    }
+void setTraceStreaming(bool on, uint32_t now)
+{
+  if (on == traceStreaming)
     return;
+  if (on)
+  {
+    Serial.println("TRACE ON");
+    traceStreaming = true;
+    uint8_t out[LOG_HEADER_SIZE + TRACE_HEADER_MAX];
+    Serial.write(out, traceSerialStream.start(UNIT_MS, now, out));
   }
-
-  // advance stage when its time is up
-  if (now - playStageStart >= playStageDur)
+  else
   {
-    playIndex++;
-    if (playIndex >= playSequence.length())
-    {
-      // run loop gap
-      playInLoopGap = true;
-      playToneOn = false;
-      playStageDur = PLAY_LOOP_GAP_MS;
-      playStageStart = now;
-      buzzerOff();
-    }
-    else
-    {
-      startStageFromIndex(now);
-    }
+    serviceTraceStream(now, true);
+    traceStreaming = false;
+    Serial.println("\nTRACE OFF");
   }
 }
 
-// ================= OLED UI =================
-void drawUI()
+// ================= Heap monitor =================
+#include <esp_heap_caps.h>
+
+HeapAllocCounters heapCounters;
+HeapMonitor heapMonitor;
+volatile uint8_t heapScope = HEAP_SUB_BOOT; // section of the main loop running now
+TaskHandle_t loopTaskHandle = NULL;
+uint32_t heapLastSampleMs = 0;
+uint32_t heapLastReportMs = 0;
+uint32_t heapAllocsAtReport = 0;
+
+// Tags the main loop's allocations for the rest of a block
+struct HeapScope
 {
-  display.clearDisplay();
-  display.setTextColor(SH110X_WHITE);
-  display.setTextSize(1);
+  uint8_t prev;
+  explicit HeapScope(uint8_t sub) : prev(heapScope) { heapScope = sub; }
+  ~HeapScope() { heapScope = prev; }
+};
 
-  // Header
-  display.setCursor(0, 0);
-  display.print(playActive ? "ESP32 Morse (PLAYING)" : "ESP32 Morse (3-btn)");
+uint8_t heapCaller()
+{
+  TaskHandle_t t = xTaskGetCurrentTaskHandle();
+  if (t == loopTaskHandle) // also start-up, before the scheduler runs
+    return heapScope;
+#if SESSION_LOG_ENABLE
+  if (t == logTask)
+    return HEAP_SUB_LOG;
+#endif
+#if AUDIO_OUT_MODE != 0
+  if (t == audioTaskHandle)
+    return HEAP_SUB_AUDIO;
+#endif
+  return HEAP_SUB_OTHER;
+}
+
+// Linked in place of the C allocator's entry points (-Wl,--wrap=...), so core,
+// IDF and library code is counted too. Drivers that call heap_caps_malloc()
+// directly bypass the counters but still show up in the heap samples.
+extern "C"
+{
+  void *__real_malloc(size_t n);
+  void *__real_calloc(size_t k, size_t n);
+  void *__real_realloc(void *p, size_t n);
+  void __real_free(void *p);
 
-  // Line 2: unit + tag (tag only when playing)
-  display.setCursor(0, 10);
-  display.print("u=");
-  display.print(UNIT_MS);
-  display.print("ms");
-  if (playActive)
+  void *__wrap_malloc(size_t n)
   {
-    display.print("  jrcsrg");
+    heapCounters.noteAlloc(heapCaller(), n);
+    return __real_malloc(n);
   }
 
-  // Line 3: key states
-  display.setCursor(0, 22);
-  display.print("DOT:");
-  display.print(btnDot.stable ? "DOWN" : "UP  ");
-  display.setCursor(64, 22);
-  display.print("DASH:");
-  display.print(btnDash.stable ? "DOWN" : "UP  ");
+  void *__wrap_calloc(size_t k, size_t n)
+  {
+    heapCounters.noteAlloc(heapCaller(), k * n);
+    return __real_calloc(k, n);
+  }
 
-  // Line 4: show either building letter or a short hint
-  display.setCursor(0, 34);
-  if (playActive)
+  void *__wrap_realloc(void *p, size_t n)
   {
-    display.print("PLAYING MSG...");
+    heapCounters.noteAlloc(heapCaller(), n);
+    return __real_realloc(p, n);
   }
-  else
+
+  void __wrap_free(void *p)
   {
-    display.print("Letter: ");
-    display.print(currentSymbols);
+    if (p)
+      heapCounters.noteFree();
+    __real_free(p);
   }
+}
 
-  // Line 5: decoded tail
-  display.setCursor(0, 46);
-  display.print("Text:");
-  String tail = decodedText;
-  bool showEllipsis = textWasTrimmed && tail.length() > OLED_TAIL_CHARS;
-  if (tail.length() > OLED_TAIL_CHARS)
-    tail = tail.substring(tail.length() - OLED_TAIL_CHARS);
-  display.setCursor(0, 56);
-  if (showEllipsis)
-    display.print("...");
-  display.print(tail);
+HeapSample heapSampleNow()
+{
+  HeapSample s;
+  s.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  s.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  s.minFreeEver = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  return s;
+}
 
-  display.display();
+// Short printf()s only: the report must not allocate itself
+void printHeapReport()
+{
+  const HeapSample &s = heapMonitor.last();
+  Serial.printf("HEAP free=%u largest=%u frag=%u%%\n", s.freeBytes, s.largestBlock,
+                HeapMonitor::fragmentationPct(s));
+  Serial.printf("HEAP low: free=%u largest=%u frag=%u%%\n", s.minFreeEver, heapMonitor.minLargest(),
+                heapMonitor.maxFragmentationPct());
+  Serial.print("HEAP allocs");
+  for (uint8_t i = 0; i < HEAP_SUB_COUNT; i++)
+    Serial.printf(" %s=%u/%uB", heapSubsystemName(i), heapCounters.count[i], heapCounters.bytes[i]);
+  uint32_t total = heapCounters.total();
+  Serial.printf(" frees=%u\n", heapCounters.frees);
+  Serial.printf("HEAP allocs since last report: %u\n", total - heapAllocsAtReport);
+  heapAllocsAtReport = total;
+  Serial.printf("HEAP stack free: loop=%u", (unsigned)uxTaskGetStackHighWaterMark(NULL));
+#if SESSION_LOG_ENABLE
+  if (logTask)
+    Serial.printf(" log=%u", (unsigned)uxTaskGetStackHighWaterMark(logTask));
+#endif
+#if AUDIO_OUT_MODE != 0
+  if (audioTaskHandle)
+    Serial.printf(" audio=%u", (unsigned)uxTaskGetStackHighWaterMark(audioTaskHandle));
+#endif
+  Serial.println();
 }
 
-// ================= Setup / Loop =================
-void setup()
+void setupHeapMonitor()
 {
-  Serial.begin(115200);
-  delay(150);
+  heapMonitor.configure(HEAP_FRAG_WARN_PCT, HEAP_LOW_WARN_BYTES);
+  heapMonitor.sample(heapSampleNow());
+  heapLastSampleMs = heapLastReportMs = millis();
+  printHeapReport(); // boot cost per subsystem
+}
 
-  pinMode(DOT_BTN_PIN, INPUT_PULLUP);
-  pinMode(DASH_BTN_PIN, INPUT_PULLUP);
-  pinMode(OK_BTN_PIN, INPUT_PULLUP);
+void serviceHeapMonitor(uint32_t now)
+{
+  if (now - heapLastSampleMs < HEAP_SAMPLE_MS)
+    return;
+  heapLastSampleMs = now;
+  uint8_t warn = heapMonitor.sample(heapSampleNow());
+  const HeapSample &s = heapMonitor.last();
+  if (warn & HEAP_WARN_FRAGMENTED)
+    Serial.printf("HEAP WARN: frag %u%% (largest %u of %u)\n", HeapMonitor::fragmentationPct(s), s.largestBlock,
+                  s.freeBytes);
+  if (warn & HEAP_WARN_LOW)
+    Serial.printf("HEAP WARN: low, %u bytes free\n", s.freeBytes);
+  if (HEAP_REPORT_MS && now - heapLastReportMs >= HEAP_REPORT_MS)
+  {
+    heapLastReportMs = now;
+    if (!traceStreaming)
+      printHeapReport();
+  }
+}
 
-  // Silent at boot for active-LOW
-  if (BUZZER_ACTIVE_LOW)
-    digitalWrite(BUZZER_PIN, HIGH);
-  else
-    digitalWrite(BUZZER_PIN, LOW);
-  pinMode(BUZZER_PIN, OUTPUT);
-  buzzerOff();
+// ================= Edge jitter =================
+EdgeJitter edgeJitter;
 
-  btnDot.stable = rawPressed(DOT_BTN_PIN);
-  btnDash.stable = rawPressed(DASH_BTN_PIN);
-  btnOk.stable = rawPressed(OK_BTN_PIN);
-  btnDot.prevStable = btnDot.stable;
-  btnDash.prevStable = btnDash.stable;
-  btnOk.prevStable = btnOk.stable;
-  btnDot.lastEdgeMs = millis();
-  btnDash.lastEdgeMs = millis();
-  btnOk.lastEdgeMs = millis();
-  lastSilenceStartMs = millis();
-  prevAnyPressed = (btnDot.stable || btnDash.stable);
+void printJitterReport()
+{
+  Serial.printf("JITTER edges=%u early=%u min=%d mean=%d max=%d us\n", edgeJitter.count(), edgeJitter.early(),
+                edgeJitter.minUs(), edgeJitter.meanUs(), edgeJitter.maxUs());
+  Serial.printf("JITTER p50=%d p90=%d p99=%d us\n", edgeJitter.percentileUs(50), edgeJitter.percentileUs(90),
+                edgeJitter.percentileUs(99));
+  uint32_t bin = edgeJitter.binUs();
+  for (size_t i = 0; i < EDGE_JITTER_BINS; i++)
+    if (edgeJitter.bin(i))
+      Serial.printf("JITTER %u-%u us: %u\n", (unsigned)(i * bin), (unsigned)((i + 1) * bin), edgeJitter.bin(i));
+  if (edgeJitter.bin(EDGE_JITTER_BINS))
+    Serial.printf("JITTER >=%u us: %u\n", (unsigned)(EDGE_JITTER_BINS * bin), edgeJitter.bin(EDGE_JITTER_BINS));
+}
 
-  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
-  if (!display.begin(OLED_ADDR_PRIMARY, true))
-  {
-    display.begin(OLED_ADDR_FALLBACK, true);
-  }
-  display.clearDisplay();
-  display.setRotation(0);
-  display.display();
+// ================= Utilities =================
+// Buttons are active-LOW: a 1 bit is a key held down
+inline uint32_t readKeys() { return ~REG_READ(GPIO_IN_REG) & KEY_MASK; }
 
-  // Minimal splash
-  display.setTextSize(1);
-  display.setTextColor(SH110X_WHITE);
-  display.setCursor(0, 0);
-  display.print("ESP32 Morse Ready");
-  display.setCursor(0, 12);
-  display.print("DOT=13 DASH=14 OK=27");
+// One sample per elapsed tick. The register is read once per pass; when the
+// loop was away for several ticks that reading stands for all of them, so a
+// slow pass (OLED refresh) adds no debounce latency.
+void serviceKeys(uint32_t now)
+{
+  uint32_t ticks = (now - keyLastSampleMs) / DEBOUNCE_TICK_MS;
+  if (ticks == 0)
+    return;
+  keyLastSampleMs += ticks * DEBOUNCE_TICK_MS;
+  if (ticks > VerticalDebouncer::DEBOUNCE_SAMPLES)
+    ticks = VerticalDebouncer::DEBOUNCE_SAMPLES;
+  uint32_t raw = readKeys();
+  while (ticks--)
+    keyDebounce.sample(raw);
+}
 
-  display.setCursor(0, 24);
-  display.print("JRCSRG 2025");
-  display.display();
-  delay(2000);
+// +1 pressed, -1 released, 0 no edge
+inline int8_t keyEdge(uint32_t pressed, uint32_t released, uint32_t bit)
+{
+  return (pressed & bit) ? +1 : (released & bit) ? -1 : 0;
 }
 
-void loop()
+// ================= High-speed key sampler =================
+#if HS_KEYING_ENABLE
+#include <esp_timer.h>
+
+KeySampler<HS_EDGE_QUEUE> keySampler;
+esp_timer_handle_t keySampleTimer = NULL;
+
+// esp_timer task (core 0): one register read, a few bit ops, maybe one push
+void keySampleTick(void *)
 {
-  uint32_t now = millis();
+  keySampler.sample(readKeys(), (uint32_t)(esp_timer_get_time() / 1000)); // = millis()
+}
 
-  // Update buttons
-  int8_t evDot = updateButton(btnDot, now);
-  int8_t evDash = updateButton(btnDash, now);
-  int8_t evOk = updateButton(btnOk, now);
+void setupKeySampler(uint32_t held)
+{
+  keySampler.reset(held);
+  uint32_t periodUs = keySamplePeriodUs(UNIT_MS, HS_DEBOUNCE_DIV, DEBOUNCE_MS, HS_MIN_SAMPLE_US);
+  esp_timer_create_args_t args = {};
+  args.callback = keySampleTick;
+  args.name = "keys";
+  esp_timer_create(&args, &keySampleTimer);
+  esp_timer_start_periodic(keySampleTimer, periodUs);
+  Serial.printf("KEYS: sample %u us, debounce %u us\n", periodUs, periodUs * VerticalDebouncer::DEBOUNCE_SAMPLES);
+}
+#endif
 
-  // Cancel playback on any input
-  if (playActive && (evDot == +1 || evDash == +1 || evOk == +1))
-  {
-    stopPlayback();
-    Serial.println("PLAY STOP (user input)");
-  }
+// ================= HMM decoder =================
+#if HMM_DECODE_ENABLE
+#include "morse_hmm.h"
+
+MorseHmm<HMM_WINDOW> hmmDecoder;
+
+void hmmKeyEdges(uint32_t t, int8_t evDot, int8_t evDash)
+{
+  // releases first: a DOT -> DASH handover in one pass is two marks
+  if (evDot < 0)
+    hmmDecoder.keyUp(t);
+  if (evDash < 0)
+    hmmDecoder.keyUp(t);
+  if (evDot > 0)
+    hmmDecoder.keyDown(t, MORSE_HMM_DOT);
+  if (evDash > 0)
+    hmmDecoder.keyDown(t, MORSE_HMM_DASH);
+}
+
+void serviceHmmDecoder(uint32_t now)
+{
+  hmmDecoder.poll(now);
+  char c, label[6];
+  while (hmmDecoder.read(c))
+    Serial.printf("HMM: %s\n", morseCharLabel(c, label));
+}
+
+void printHmmStatus()
+{
+  float unit = hmmDecoder.unitMs();
+  Serial.printf("HMM: unit %.0f ms (%.0f WPM), %u marks+spaces, %u pending\n", unit, 1200.0f / unit,
+                hmmDecoder.observations(), (unsigned)hmmDecoder.pending());
+}
+#endif
 
-  // Buzzer behavior
-  if (playActive)
+// ================= Playback queue =================
+// Everything that plays a stored program goes through playQueue
+// (play_queue.h): memory chords first, then serial PLAY messages, then the
+// beacon, each level first come first served. Higher levels take over at the
+// next letter boundary and the one they interrupted resumes from there.
+// Serial and beacon messages wait until the keys have been quiet for a word gap.
+const size_t PLAY_QUEUE_MAX = 8;
+PlayQueue<PLAY_QUEUE_MAX> playQueue;
+
+// PLAY frames are compiled on arrival into one of these and queued in place
+const uint8_t SERIAL_PLAY_SLOTS = 4;
+const size_t SERIAL_PLAY_MAX_STAGES = 512; // ~60 characters
+char serialPlayStages[SERIAL_PLAY_SLOTS][SERIAL_PLAY_MAX_STAGES + 1];
+
+// Compile and queue. Text that does not compile whole into one buffer, or
+// has nothing playable, is refused rather than cut short.
+ProtoStatus serialPlayEnqueue(const char *text, uint8_t passes)
+{
+  const MorseAlphabet &alphabet = *keyer.codec().alphabet;
+  size_t need = morseBuildStagesFromText(text, nullptr, (size_t)-1, alphabet);
+  if (need == 0 || need > SERIAL_PLAY_MAX_STAGES)
+    return PROTO_STATUS_BAD_ARG;
+  for (uint8_t i = 0; i < SERIAL_PLAY_SLOTS; i++)
   {
-    servicePlayback(now); // playback drives buzzer
+    char *stages = serialPlayStages[i];
+    if (playQueue.holds(stages))
+      continue;
+    size_t len = morseBuildStagesFromText(text, stages, SERIAL_PLAY_MAX_STAGES + 1, alphabet);
+    return playQueue.push(stages, len, PLAY_PRIO_SERIAL, passes, TRACE_PLAY_SERIAL) ? PROTO_STATUS_OK
+                                                                                    : PROTO_STATUS_FULL;
   }
-  else
-  {
-    bool nowAnyPressed = anyPressed();
-    if (nowAnyPressed)
-      buzzerOn();
-    else
-      buzzerOff();
+  return PROTO_STATUS_FULL;
+}
+
+// The program playing as text, one stage index per character
+// (morse_playmap.h); rebuilt at each playback start for the OLED
+MorsePlayMap<KEYER_TEXT_MAX + 8> playMap;
+UiPlayLines playLines; // cut from playMap for the OLED
+
+// Scheduled end of the last tone played so far, and whether the program has
+// no tones left (its final loop gap); the trainers time answers from here
+uint32_t playToneEndMs = 0;
+bool playTonesDone = false;
+
+// Start of the answer to a program that just stopped: the end of its last
+// tone once every tone has played (played out, or keyed in the loop gap),
+// else the key-down that cut it short
+uint32_t playAnswerStartMs() { return playTonesDone ? playToneEndMs : keyerClockMs; }
+
+// ================= Memory keyer =================
+// Slots hold finished stage programs, loaded from NVS at boot, so a trigger
+// only points the player at a buffer: no encoding between gesture and tone.
+const uint8_t MEM_SLOTS = KEYER_MEM_SLOTS; // one per chord
+const size_t MEM_MAX_STAGES = 255;
+const uint16_t MEM_RECORD_HOLD_MS = 1500; // hold a chord this long to record
+
+struct MemSlot
+{
+  uint16_t len;
+  char stages[MEM_MAX_STAGES + 1];
+};
+MemSlot memSlots[MEM_SLOTS];
+const char *beaconStages = nullptr; // slot queued as the beacon
+Preferences memPrefs;
+
+// Factory contents for slot 1 until something is recorded over it
+constexpr auto MEM_DEFAULT_CQ = MORSE_PROGRAM("CQ CQ CQ DE JRCSRG K");
+static_assert(MEM_DEFAULT_CQ.size() <= MEM_MAX_STAGES, "default memory too long");
+
+void memKey(uint8_t slot, char *key)
+{
+  key[0] = 'm';
+  key[1] = (char)('0' + slot);
+  key[2] = '\0';
+}
 
-    // Optional auto-commit/space based on idle gaps
-    if (!prevAnyPressed && nowAnyPressed)
+void setupMemoryKeyer()
+{
+  memPrefs.begin("memkey", false);
+  for (uint8_t i = 0; i < MEM_SLOTS; i++)
+  {
+    char key[3];
+    memKey(i, key);
+    size_t n = memPrefs.getBytes(key, memSlots[i].stages, MEM_MAX_STAGES);
+    if (n == 0 && i == 0)
     {
-      uint32_t gap = now - lastSilenceStartMs;
-      if (gap >= WORD_GAP_MS)
-      {
-        commitLetterIfAny();
-        pushSpaceIfNeeded();
-        Serial.println("GAP: WORD (auto)");
-      }
-      else if (gap >= LETTER_GAP_MS)
-      {
-        commitLetterIfAny();
-        Serial.println("GAP: LETTER (auto)");
-      }
+      memcpy(memSlots[i].stages, MEM_DEFAULT_CQ.data(), MEM_DEFAULT_CQ.size());
+      n = MEM_DEFAULT_CQ.size();
     }
-    if (prevAnyPressed && !nowAnyPressed)
-      lastSilenceStartMs = now;
-    prevAnyPressed = nowAnyPressed;
+    memSlots[i].len = (uint16_t)n;
+    memSlots[i].stages[n] = '\0';
   }
+}
 
-  // Append symbols on release
-  if (evDot == -1)
+// Compile text into a slot and persist the compiled stages. Text that does
+// not compile whole into the slot is refused and the old contents stay.
+bool memStore(uint8_t slot, const char *text)
+{
+  if (slot >= MEM_SLOTS)
+    return false;
+  const MorseAlphabet &alphabet = *keyer.codec().alphabet;
+  size_t need = morseBuildStagesFromText(text, nullptr, (size_t)-1, alphabet);
+  if (need > MEM_MAX_STAGES)
   {
-    currentSymbols += '.';
-    Serial.println("DOT");
+    Serial.printf("MEM %u: TOO LONG (stages=%u, max %u)\n", slot + 1, (unsigned)need, (unsigned)MEM_MAX_STAGES);
+    return false;
   }
-  if (evDash == -1)
+  HeapScope scope(HEAP_SUB_MEMORY);
+  MemSlot &m = memSlots[slot];
+  if (beaconStages == m.stages)
+    beaconStages = nullptr;
+  playQueue.remove(m.stages, keyer); // queued plays of the old contents
+  m.len = (uint16_t)morseBuildStagesFromText(text, m.stages, sizeof(m.stages), alphabet);
+  char key[3];
+  memKey(slot, key);
+  if (m.len == 0)
+    memPrefs.remove(key);
+  else
+    memPrefs.putBytes(key, m.stages, m.len);
+  Serial.printf("MEM %u STORED: stages=%u\n", slot + 1, m.len);
+  return true;
+}
+
+void memPlay(uint8_t slot)
+{
+  if (slot >= MEM_SLOTS || memSlots[slot].len == 0)
   {
-    currentSymbols += '-';
-    Serial.println("DASH");
+    Serial.printf("MEM %u: EMPTY\n", slot + 1);
+    return;
   }
+  Serial.printf("MEM %u: PLAY\n", slot + 1);
+  if (!playQueue.push(memSlots[slot].stages, memSlots[slot].len, PLAY_PRIO_MEMORY, 0, TRACE_PLAY_MEMORY))
+    Serial.println("PLAY: QUEUE FULL");
+}
+
+// Loop a slot in the background until BEACON STOP; anything else preempts it
+void beaconStop()
+{
+  if (beaconStages)
+    playQueue.remove(beaconStages, keyer);
+  beaconStages = nullptr;
+}
 
-  // OK long-press = clear
-  if (btnOk.stable && !okClearLatched && (now - btnOk.pressStartMs >= CLEAR_HOLD_MS))
+void beaconStart(uint8_t slot)
+{
+  beaconStop();
+  if (memSlots[slot].len == 0 || !playQueue.push(memSlots[slot].stages, memSlots[slot].len, PLAY_PRIO_BEACON, 0,
+                                                  TRACE_PLAY_BEACON))
   {
-    clearAll();
-    okClearLatched = true;
-    stopPlayback();
-    okMultiCount = 0;
+    Serial.printf("BEACON %u: EMPTY OR QUEUE FULL\n", slot + 1);
+    return;
   }
-  if (!btnOk.stable)
-    okClearLatched = false;
+  beaconStages = memSlots[slot].stages;
+  Serial.printf("BEACON %u: ON\n", slot + 1);
+}
 
-  // OK short-press with triple-tap detection
-  if (evOk == -1)
-  {
-    uint32_t held = now - btnOk.pressStartMs;
-    if (held < CLEAR_HOLD_MS)
-    {
-      if (okMultiCount == 0)
-      {
-        okMultiCount = 1;
-        okMultiStartMs = now;
-      }
-      else if (now - okMultiStartMs <= OK_MULTI_WINDOW_MS)
-      {
-        okMultiCount++;
-      }
-      else
-      {
-        if (okMultiCount < 3)
-        {
-          commitLetterIfAny();
-          Serial.println("OK: COMMIT (timeout)");
-        }
-        okMultiCount = 1;
-        okMultiStartMs = now;
-      }
+// Record the committed text (trailing spaces trimmed) into a slot
+void memRecordFromText(uint8_t slot)
+{
+  char msg[KEYER_TEXT_MAX + 1];
+  size_t len = keyer.textLen();
+  while (len > 0 && keyer.text()[len - 1] == ' ')
+    len--;
+  memcpy(msg, keyer.text(), len);
+  msg[len] = '\0';
+  memStore(slot, msg);
+}
 
-      // Triple tap: start/stop playback of current letter or the whole committed message
-      if (okMultiCount >= 3)
-      {
-        if (playActive)
-        {
-          stopPlayback();
-          Serial.println("PLAY TOGGLE: OFF");
-        }
-        else
-        {
-          startPlayback(now); // builds from currentSymbols OR decodedText
-          if (playActive)
-            Serial.println("PLAY TOGGLE: ON");
-        }
-        okMultiCount = 0;
-      }
-    }
-  }
+// ================= Koch trainer =================
+// KOCH plays random groups from the characters learned so far (koch_trainer.h)
+// at the current speed; each is keyed back and scored per character. Groups
+// go through the play queue at memory priority, so a beacon waits and keying
+// over a group just ends it early. Progress lives in NVS.
+KochTrainer koch;
+Preferences kochPrefs;
+char kochStages[KOCH_GROUP_LEN * MORSE_STAGES_PER_CHAR + 1];
+bool kochActive = false;
+bool kochPlaying = false;                      // the keyer is playing kochStages
+uint32_t kochNextMs = 0;                       // next group not before this
+const uint16_t KOCH_PAUSE_MS = 1500;           // after a group is scored
+const uint16_t KOCH_ANSWER_TIMEOUT_MS = 15000; // no keying this long closes the answer
+
+void setupKochTrainer()
+{
+  kochPrefs.begin("koch", false);
+  KochProgress p;
+  if (kochPrefs.getBytes("p", &p, sizeof(p)) == sizeof(p))
+    koch.load(p);
+}
 
-  // Commit after single/double tap when window ends
-  if (okMultiCount > 0 && (now - okMultiStartMs > OK_MULTI_WINDOW_MS))
+void kochSave() { kochPrefs.putBytes("p", &koch.progress(), sizeof(KochProgress)); }
+
+void kochStop()
+{
+  kochActive = false;
+  playQueue.remove(kochStages, keyer);
+}
+
+void kochStart(uint32_t now)
+{
+  kochStop();
+  koch.start(esp_random());
+  kochActive = true;
+  kochNextMs = now;
+  Serial.printf("KOCH: START level %u (%c)\n", koch.level(), KOCH_ORDER[koch.level() - 1]);
+}
+
+void printKochStats()
+{
+  const KochProgress &p = koch.progress();
+  Serial.printf("KOCH: level %u, %u sessions\n", p.level, p.sessions);
+  for (size_t i = 0; i < p.level; i++)
   {
-    if (okMultiCount < 3)
+    const KochCharStats &st = p.chars[i];
+    Serial.printf("  %c %u/%u %ums max %ums\n", KOCH_ORDER[i], st.correct, st.sent,
+                  st.timed ? (unsigned)(st.latencySumMs / st.timed) : 0u, st.latencyMaxMs);
+  }
+}
+
+// After a group is scored: report it, and end the session after the last
+void kochScored(uint32_t now)
+{
+  Serial.print("KOCH: ");
+  Serial.print(koch.group());
+  Serial.print(" / ");
+  Serial.print(koch.answer());
+  Serial.printf(" %u/%u\n", koch.lastCorrect(), (unsigned)KOCH_GROUP_LEN);
+  kochNextMs = now + KOCH_PAUSE_MS;
+  if (!koch.sessionDone())
+    return;
+  kochActive = false;
+  kochSave();
+  Serial.printf("KOCH: SESSION %u%%%s\n", koch.sessionPct(), koch.advanced() ? ", NEW CHARACTER" : "");
+  if (koch.advanced())
+    Serial.printf("KOCH: level %u adds %c\n", koch.level(), KOCH_ORDER[koch.level() - 1]);
+}
+
+void kochLetter(char c, uint32_t now)
+{
+  if (kochActive && koch.letter(c, now))
+    kochScored(now);
+}
+
+// A word gap after some letters ends the answer
+void kochSpace(uint32_t now)
+{
+  if (kochActive && koch.state() == KOCH_ANSWER && koch.answerLen() > 0)
+  {
+    koch.close();
+    kochScored(now);
+  }
+}
+
+// Key edges, after the keyer has seen them
+void kochKeyEdges(uint32_t t, int8_t evDot, int8_t evDash)
+{
+  if (!kochActive)
+    return;
+  if (evDot > 0 || evDash > 0)
+    koch.keyDown(t);
+  else if ((evDot < 0 || evDash < 0) && !keyer.keyDown(TRACE_KEY_DOT) && !keyer.keyDown(TRACE_KEY_DASH))
+    koch.keyUp(t);
+}
+
+void serviceKoch(uint32_t now)
+{
+  if (!kochActive)
+    return;
+  if (koch.state() == KOCH_ANSWER && now - koch.lastActivityMs() >= KOCH_ANSWER_TIMEOUT_MS)
+  {
+    koch.close();
+    kochScored(now);
+    return;
+  }
+  if (koch.state() != KOCH_IDLE || (int32_t)(now - kochNextMs) < 0 || playQueue.full())
+    return;
+  size_t len = morseBuildStagesFromText(koch.nextGroup(), kochStages, sizeof(kochStages), *keyer.codec().alphabet);
+  keyer.clearText(); // the answer starts on an empty line
+  playQueue.push(kochStages, len, PLAY_PRIO_MEMORY, 1, TRACE_PLAY_KOCH);
+}
+
+// ================= Echo drill =================
+// ECHO plays one character at a time (echo_drill.h) and times the answer
+// from the scheduled end of its last tone to the first debounced press, so
+// with HS_KEYING_ENABLE both ends are sampler edges. Slow characters come
+// back more often. Stats stay in RAM until ECHO RESET or a reboot; ECHO STATS
+// prints them, PROTO_GET_ECHO frames carry the histograms (morse_ctl echo).
+EchoDrill echo;
+char echoStages[MORSE_STAGES_PER_CHAR + 1];
+bool echoActive = false;
+bool echoPlaying = false;                     // the keyer is playing echoStages
+uint32_t echoNextMs = 0;                      // next character not before this
+char echoLine[UI_COLS + 1];                   // last result for the OLED
+const uint16_t ECHO_PAUSE_MS = 800;           // after a result
+const uint16_t ECHO_ANSWER_TIMEOUT_MS = 5000; // no key-down this long is a miss
+
+void echoStop()
+{
+  echoActive = false;
+  playQueue.remove(echoStages, keyer);
+}
+
+void echoStart(uint32_t now, size_t count)
+{
+  echoStop();
+  echo.start(esp_random(), count);
+  echoActive = true;
+  echoNextMs = now;
+  snprintf(echoLine, sizeof(echoLine), "Echo: listen");
+  Serial.printf("ECHO: START %u characters\n", (unsigned)echo.count());
+}
+
+void printEchoStats()
+{
+  Serial.println("ECHO: char ok/tries avg min max (ms)");
+  for (size_t i = 0; i < ECHO_CHARS; i++)
+  {
+    const EchoCharStats &s = echo.stats(i);
+    if (s.tries)
+      Serial.printf("  %c %u/%u %u %u %u\n", KOCH_ORDER[i], s.correct, s.tries, s.avgMs, s.minMs, s.maxMs);
+  }
+}
+
+void echoScored(uint32_t now)
+{
+  char c = echo.target();
+  char label[6];
+  if (echo.lastCorrect())
+  {
+    Serial.printf("ECHO: %c %u ms\n", c, (unsigned)echo.lastMs());
+    snprintf(echoLine, sizeof(echoLine), "Echo %c %u ms", c, (unsigned)echo.lastMs());
+  }
+  else if (echo.answer())
+  {
+    Serial.printf("ECHO: %c as %s\n", c, morseCharLabel(echo.answer(), label));
+    snprintf(echoLine, sizeof(echoLine), "Echo %c as %s", c, label);
+  }
+  else
+  {
+    Serial.printf("ECHO: %c no answer\n", c);
+    snprintf(echoLine, sizeof(echoLine), "Echo %c missed", c);
+  }
+  echoNextMs = now + ECHO_PAUSE_MS;
+}
+
+void echoLetter(char c, uint32_t now)
+{
+  if (!echoActive || echo.state() != ECHO_ANSWER)
+    return;
+  echo.letter(c);
+  echoScored(now);
+}
+
+void echoKeyEdges(uint32_t t, int8_t evDot, int8_t evDash)
+{
+  if (echoActive && (evDot > 0 || evDash > 0))
+    echo.keyDown(t);
+}
+
+void serviceEcho(uint32_t now)
+{
+  if (!echoActive)
+    return;
+  if (echo.state() == ECHO_ANSWER && !echo.pressed() && now - echo.answerStartMs() >= ECHO_ANSWER_TIMEOUT_MS)
+  {
+    echo.timeout();
+    echoScored(now);
+    return;
+  }
+  if (echo.state() != ECHO_IDLE || (int32_t)(now - echoNextMs) < 0 || playQueue.full())
+    return;
+  char c = echo.next();
+  size_t len = morseBuildStagesForPattern(morseEncode(c, *keyer.codec().alphabet), echoStages, sizeof(echoStages));
+  if (len == 0)
+  {
+    echoActive = false;
+    Serial.printf("ECHO: %c NOT IN THIS ALPHABET\n", c);
+    return;
+  }
+  keyer.clearText();
+  playQueue.push(echoStages, len, PLAY_PRIO_MEMORY, 1, TRACE_PLAY_ECHO);
+}
+
+// ================= Stopping playback =================
+// Stop whatever the queue is playing and forget the rest. A Koch or echo
+// session would wait forever for the group or character dropped here (and
+// queue the next one at once), so both end too.
+void playQueueClear()
+{
+  if (kochActive)
+    Serial.println("KOCH: STOP");
+  if (echoActive)
+    Serial.println("ECHO: STOP");
+  kochStop();
+  echoStop();
+  if (playQueue.active())
+    keyer.stopPlayback(KEYER_STOP_REMOTE);
+  playQueue.clear();
+}
+
+// ================= Keyer events =================
+// Everything the keyer decides ends up here: tone, readable event lines,
+// trace/log entries and memory chords.
+class DeviceKeyerListener : public KeyerListener
+{
+public:
+  void onTone(bool on) override
+  {
+    if (on)
+      buzzerOn();
+    else
+      buzzerOff();
+    if (keyer.playing()) // sidetone follows the keys, only playback has a schedule
+      edgeJitter.record(keyer.playStageStartMs(), micros());
+    if (!on && keyer.playing())
+    {
+      playToneEndMs = keyer.playStageStartMs();
+      playTonesDone = keyer.playTonesDone();
+    }
+  }
+
+  void onSymbol(char s) override { EVENT_LOG(s == '.' ? "DOT\n" : "DASH\n"); }
+
+  void onLetter(const char *pattern, char c, uint8_t reason) override
+  {
+    logText(c);
+    traceEvent(TRACE_COMMIT, reason, (uint8_t)c);
+    kochLetter(c, keyerClockMs);
+    echoLetter(c, keyerClockMs);
+    const MorseGuess &g = keyer.lastGuess();
+    char label[6];
+    morseCharLabel(c, label);
+    if (g.cost == 0)
+      EVENT_LOG("LETTER: %s -> %s\n", pattern, label);
+    else
+      EVENT_LOG("LETTER: %s ~> %s (%u%%, alt %c)\n", pattern, label, g.confidence, g.alt ? g.alt : '-');
+  }
+
+  void onSpace() override
+  {
+    logText(' ');
+    traceEvent(TRACE_SPACE);
+    kochSpace(keyerClockMs);
+  }
+
+  void onWordFixed(const char *keyed, const char *fixed) override { EVENT_LOG("WORD: %s -> %s\n", keyed, fixed); }
+
+  void onWordErased(const char *word) override { EVENT_LOG("ERASE: %s\n", word); }
+
+  void onCommitPoint(uint8_t at) override
+  {
+    static const char *const LINES[] = {"GAP: LETTER (auto)", "GAP: WORD (auto)", "OK: COMMIT", "OK: COMMIT (timeout)",
+                                        "LETTER: COMPLETE (early)"};
+    EVENT_LOG("%s\n", LINES[at]);
+  }
+
+  void onClear() override
+  {
+    traceEvent(TRACE_CLEAR);
+    EVENT_LOG("** CLEAR **\n");
+  }
+
+  void onPlayStart(const char *stages, uint8_t source) override
+  {
+    traceEvent(TRACE_PLAY_START, source);
+    playTonesDone = false;
+    kochPlaying = source == TRACE_PLAY_KOCH;
+    echoPlaying = source == TRACE_PLAY_ECHO;
+    playMap.build(stages, keyer.playLen(), *keyer.codec().trie);
+    playLines.fresh = true;
+    if (!traceStreaming)
     {
-      commitLetterIfAny();
-      Serial.println("OK: COMMIT");
+      // print(), not EVENT_LOG(): printf() goes to the heap past 64 bytes
+      Serial.print("PLAY START: stages=");
+      Serial.println(stages);
     }
-    okMultiCount = 0;
+    if (source == TRACE_PLAY_TEXT)
+      EVENT_LOG("PLAY TOGGLE: ON\n");
+  }
+
+  void onPlayEmpty() override { EVENT_LOG("PLAY: NO SEQUENCE\n"); }
+
+  void onPlayStop(uint8_t reason) override
+  {
+    playQueue.stopped(reason, keyer);
+    traceEvent(TRACE_PLAY_STOP);
+    if (kochPlaying && kochActive && reason != KEYER_STOP_YIELD)
+      koch.sent(playAnswerStartMs());
+    kochPlaying = false;
+    if (echoPlaying && echoActive && reason != KEYER_STOP_YIELD)
+      echo.played(playAnswerStartMs());
+    echoPlaying = false;
+    if (reason == KEYER_STOP_INPUT)
+      EVENT_LOG("PLAY STOP (user input)\n");
+    else if (reason == KEYER_STOP_TOGGLE)
+      EVENT_LOG("PLAY TOGGLE: OFF\n");
+    else if (reason == KEYER_STOP_DONE)
+      EVENT_LOG("PLAY DONE\n");
+    else if (reason == KEYER_STOP_REMOTE)
+      EVENT_LOG("PLAY STOP (serial)\n");
+    else if (reason == KEYER_STOP_YIELD)
+      EVENT_LOG("PLAY PAUSED (preempted)\n");
+  }
+
+  void onMemory(uint8_t slot, bool record, uint32_t /*now*/) override
+  {
+    if (record)
+      memRecordFromText(slot);
+    else
+      memPlay(slot);
+  }
+};
+
+DeviceKeyerListener keyerEvents;
+
+// ================= Session recorder / replay =================
+// REC captures key edges (and the commits they caused) as a key trace in RAM;
+// REPLAY clears the text and feeds the edges back through the keyer at their
+// original offsets. REC DUMP sends the recording as one session-log record, so
+// tools/keyer_replay.cpp can re-run it on the host and check every commit.
+KeyReplayer replayer;
+size_t recDumpPos = 0; // bytes of the dump still to send; 0 = idle
+uint8_t recDumpHeader[LOG_HEADER_SIZE];
+
+void startRecording(uint32_t now)
+{
+  replayer.stop();
+  keyer.reset(now);
+  recorder.start(now, UNIT_MS);
+  Serial.printf("REC: START (%u bytes)\n", (unsigned)REC_CAP);
+}
+
+void stopRecording()
+{
+  recorder.stop();
+  Serial.printf("REC: %u bytes%s\n", (unsigned)recorder.size(), recorder.full() ? " (FULL)" : "");
+}
+
+void startReplay(uint32_t now)
+{
+  recorder.stop();
+  if (!replayer.begin(recorder.data(), recorder.size(), now))
+  {
+    Serial.println("REPLAY: NOTHING RECORDED");
+    return;
+  }
+  keyer.reset(now);
+  Serial.println("REPLAY: START");
+}
+
+void stopReplay(uint32_t now)
+{
+  if (!replayer.active())
+    return;
+  replayer.stop();
+  keyer.releaseKeys(now);
+  Serial.println("REPLAY: STOP");
+}
+
+// Chunked like the log dump so keying carries on while it drains
+void serviceRecDump()
+{
+  size_t total = LOG_HEADER_SIZE + recorder.size();
+  while (recDumpPos > 0)
+  {
+    int room = Serial.availableForWrite();
+    if (room <= 0)
+      return;
+    size_t off = total - recDumpPos;
+    size_t n = recDumpPos < (size_t)room ? recDumpPos : (size_t)room;
+    if (off < LOG_HEADER_SIZE)
+    {
+      n = n < LOG_HEADER_SIZE - off ? n : LOG_HEADER_SIZE - off;
+      Serial.write(recDumpHeader + off, n);
+    }
+    else
+      Serial.write(recorder.data() + off - LOG_HEADER_SIZE, n);
+    recDumpPos -= n;
+    if (recDumpPos == 0)
+      Serial.println("\nREC END");
+  }
+}
+
+void startRecDump()
+{
+  if (recorder.active() || recorder.size() == 0 || recDumpPos != 0)
+  {
+    Serial.println("REC: BUSY OR EMPTY");
+    return;
+  }
+  logEncodeHeader(LOG_REC_TRACE, recorder.startMs(), recorder.data(), (uint16_t)recorder.size(), recDumpHeader);
+  Serial.printf("REC BEGIN %u\n", (unsigned)(LOG_HEADER_SIZE + recorder.size()));
+  recDumpPos = LOG_HEADER_SIZE + recorder.size();
+}
+
+// ================= Serial commands =================
+// Line-based, typed in the serial monitor (newline-terminated):
+//   MEM            list slots
+//   MEM <n>        play slot n (1-based)
+//   MEM <n> <text> compile text into slot n and save it
+//   BEACON <n>     loop slot n in the background (pauses for keying and other plays)
+//   BEACON STOP    end the beacon
+//   KOCH [STOP]    start a Koch session (random groups to key back) or end it
+//   KOCH STATS     level and per-character accuracy / response time
+//   KOCH LEVEL <n> use the first n characters of the Koch order
+//   KOCH RESET     forget Koch progress
+//   ECHO [n]       echo drill over all (or the first n Koch) characters
+//   ECHO STOP      end the echo drill
+//   ECHO STATS     per-character recognition latency
+//   ECHO RESET     clear the echo drill stats
+//   LOG            stream the session log (LOG BEGIN <bytes> ... LOG END)
+//   LOG CLEAR      delete the session log
+//   TRACE ON|OFF   stream the binary key trace instead of event lines
+//   REC            clear the text and start recording key edges
+//   REC STOP       stop recording
+//   REC DUMP       send the recording (REC BEGIN <bytes> ... REC END)
+//   REPLAY [STOP]  clear the text and replay the recording
+//   HEAP           heap, fragmentation and per-subsystem allocation report
+//   JITTER [RESET] playback edge lateness histogram (or clear it)
+//   HMM            HMM decoder speed estimate (HMM_DECODE_ENABLE)
+//   ABC [name]     list alphabets or switch to one (MORSE_ALPHABET_RUNTIME)
+// A zero byte starts a binary frame instead (serial_proto.h, tools/morse_ctl):
+// queue text to play, set WPM / pitch, read stats, subscribe to key events.
+const size_t SERIAL_LINE_MAX = 160;
+char serialLine[SERIAL_LINE_MAX + 1];
+size_t serialLineLen = 0;
+
+void handleCommand(char *line, uint32_t now)
+{
+  for (char *p = line; *p; p++)
+    if (*p >= 'a' && *p <= 'z')
+      *p = *p - 'a' + 'A';
+
+  if (strncmp(line, "MEM", 3) == 0 && (line[3] == '\0' || line[3] == ' '))
+  {
+    char *arg = line + 3;
+    while (*arg == ' ')
+      arg++;
+    if (*arg == '\0')
+    {
+      for (uint8_t i = 0; i < MEM_SLOTS; i++)
+        Serial.printf("MEM %u: %u stages\n", i + 1, memSlots[i].len);
+      return;
+    }
+    int slot = atoi(arg) - 1;
+    while (*arg >= '0' && *arg <= '9')
+      arg++;
+    if (slot < 0 || slot >= MEM_SLOTS)
+    {
+      Serial.println("MEM: BAD SLOT");
+      return;
+    }
+    while (*arg == ' ')
+      arg++;
+    if (*arg == '\0')
+      memPlay((uint8_t)slot);
+    else
+      memStore((uint8_t)slot, arg);
+    return;
+  }
+  if (strcmp(line, "BEACON STOP") == 0)
+  {
+    beaconStop();
+    Serial.println("BEACON: OFF");
+    return;
+  }
+  if (strncmp(line, "BEACON ", 7) == 0)
+  {
+    int slot = atoi(line + 7) - 1;
+    if (slot < 0 || slot >= MEM_SLOTS)
+      Serial.println("BEACON: BAD SLOT");
+    else
+      beaconStart((uint8_t)slot);
+    return;
+  }
+  if (strcmp(line, "KOCH") == 0)
+  {
+    echoStop();
+    kochStart(now);
+    return;
+  }
+  if (strcmp(line, "KOCH STOP") == 0)
+  {
+    kochStop();
+    Serial.println("KOCH: STOP");
+    return;
+  }
+  if (strcmp(line, "KOCH STATS") == 0)
+  {
+    printKochStats();
+    return;
+  }
+  if (strncmp(line, "KOCH LEVEL ", 11) == 0)
+  {
+    int level = atoi(line + 11);
+    koch.setLevel(level < 0 ? 0 : level > 255 ? 255 : (uint8_t)level);
+    kochSave();
+    Serial.printf("KOCH: level %u (%c)\n", koch.level(), KOCH_ORDER[koch.level() - 1]);
+    return;
+  }
+  if (strcmp(line, "KOCH RESET") == 0)
+  {
+    kochStop();
+    koch.reset();
+    kochSave();
+    Serial.println("KOCH: RESET");
+    return;
+  }
+  if (strcmp(line, "ECHO STOP") == 0)
+  {
+    echoStop();
+    Serial.println("ECHO: STOP");
+    return;
+  }
+  if (strcmp(line, "ECHO STATS") == 0)
+  {
+    printEchoStats();
+    return;
+  }
+  if (strcmp(line, "ECHO RESET") == 0)
+  {
+    echoStop();
+    echo.reset();
+    Serial.println("ECHO: RESET");
+    return;
+  }
+  if (strcmp(line, "ECHO") == 0 || strncmp(line, "ECHO ", 5) == 0)
+  {
+    int count = line[4] ? atoi(line + 5) : 0;
+    kochStop();
+    echoStart(now, count > 0 ? (size_t)count : 0);
+    return;
+  }
+  if (strcmp(line, "HEAP") == 0)
+  {
+    heapMonitor.sample(heapSampleNow());
+    printHeapReport();
+    return;
   }
+  if (strcmp(line, "JITTER") == 0)
+  {
+    printJitterReport();
+    return;
+  }
+  if (strcmp(line, "JITTER RESET") == 0)
+  {
+    edgeJitter.reset();
+    Serial.println("JITTER: RESET");
+    return;
+  }
+  if (strcmp(line, "REC") == 0)
+  {
+    startRecording(now);
+    return;
+  }
+  if (strcmp(line, "REC STOP") == 0)
+  {
+    stopRecording();
+    return;
+  }
+  if (strcmp(line, "REC DUMP") == 0)
+  {
+    startRecDump();
+    return;
+  }
+  if (strcmp(line, "REPLAY") == 0)
+  {
+    startReplay(now);
+    return;
+  }
+  if (strcmp(line, "REPLAY STOP") == 0)
+  {
+    stopReplay(now);
+    return;
+  }
+  if (strcmp(line, "TRACE ON") == 0 || strcmp(line, "TRACE OFF") == 0)
+  {
+    setTraceStreaming(line[7] == 'N', now);
+    return;
+  }
+#if HMM_DECODE_ENABLE
+  if (strcmp(line, "HMM") == 0)
+  {
+    printHmmStatus();
+    return;
+  }
+#endif
+#if MORSE_ALPHABET_RUNTIME
+  if (strncmp(line, "ABC", 3) == 0 && (line[3] == '\0' || line[3] == ' '))
+  {
+    const char *name = line + 3;
+    while (*name == ' ')
+      name++;
+    size_t i = morseAlphabetIndex(name);
+    if (*name != '\0' && i < MORSE_ALPHABET_COUNT)
+    {
+      keyer.setCodec(morseCodec(i));
+#if HMM_DECODE_ENABLE
+      hmmDecoder.setNearest(*keyer.codec().nearest);
+#endif
+    }
+    else if (*name != '\0')
+      Serial.println("ABC: UNKNOWN");
+    for (i = 0; i < MORSE_ALPHABET_COUNT; i++)
+      Serial.printf("ABC %s%s\n", MORSE_ALPHABETS[i].name, keyer.codec().alphabet == &MORSE_ALPHABETS[i] ? " *" : "");
+    return;
+  }
+#endif
+#if SESSION_LOG_ENABLE
+  if (strcmp(line, "LOG") == 0)
+  {
+    startLogDump(now);
+    return;
+  }
+  if (strcmp(line, "LOG CLEAR") == 0)
+  {
+    clearSessionLog();
+    return;
+  }
+#endif
+  Serial.print("?CMD: "); // the line can be long; printf() would allocate
+  Serial.println(line);
+}
+
+// New keying speed: gaps, playback stages and (HS_KEYING_ENABLE) the key
+// sample period all follow the unit
+void setUnitMs(uint16_t unit)
+{
+  UNIT_MS = unit;
+  LETTER_GAP_MS = (uint16_t)(3 * unit);
+  WORD_GAP_MS = (uint16_t)(7 * unit);
+  playTiming = morseTimingForUnit(unit);
+  KeyerTiming t = keyer.timing();
+  t.letterGapMs = LETTER_GAP_MS;
+  t.wordGapMs = WORD_GAP_MS;
+  t.play = playTiming;
+  keyer.configure(t, &keyerEvents);
+#if HS_KEYING_ENABLE
+  esp_timer_stop(keySampleTimer);
+  esp_timer_start_periodic(keySampleTimer, keySamplePeriodUs(UNIT_MS, HS_DEBOUNCE_DIV, DEBOUNCE_MS, HS_MIN_SAMPLE_US));
+#endif
+}
+
+// One checked frame from protoReader; every request gets exactly one reply
+void handleFrame(uint32_t now)
+{
+  uint8_t type = protoReader.type(), seq = protoReader.seq();
+  const uint8_t *p = protoReader.payload();
+  size_t len = protoReader.payloadLen();
+  protoFramesOk++;
+  switch (type)
+  {
+  case PROTO_PING:
+    protoAck(seq, type, PROTO_STATUS_OK);
+    return;
+  case PROTO_PLAY:
+  {
+    if (len < 2)
+    {
+      protoAck(seq, type, PROTO_STATUS_BAD_ARG);
+      return;
+    }
+    if (playQueue.full())
+    {
+      protoAck(seq, type, PROTO_STATUS_FULL, (uint8_t)playQueue.size());
+      return;
+    }
+    char text[PROTO_PAYLOAD_MAX];
+    memcpy(text, p + 1, len - 1);
+    text[len - 1] = '\0';
+    protoAck(seq, type, serialPlayEnqueue(text, p[0]), (uint8_t)playQueue.size());
+    return;
+  }
+  case PROTO_SET_WPM:
+    if (len < 1 || p[0] < 5 || p[0] > 60)
+    {
+      protoAck(seq, type, PROTO_STATUS_BAD_ARG);
+      return;
+    }
+    setUnitMs((uint16_t)(1200 / p[0]));
+    protoAck(seq, type, PROTO_STATUS_OK, p[0]);
+    return;
+  case PROTO_SET_PITCH:
+  {
+#if AUDIO_OUT_MODE == 0
+    protoAck(seq, type, PROTO_STATUS_UNSUPPORTED);
+#else
+    uint16_t hz = len >= 2 ? logGet16(p) : 0;
+    if (hz < 200 || hz > 2000)
+    {
+      protoAck(seq, type, PROTO_STATUS_BAD_ARG);
+      return;
+    }
+    setTonePitch(hz);
+    protoAck(seq, type, PROTO_STATUS_OK);
+#endif
+    return;
+  }
+  case PROTO_GET_STATS:
+  {
+    ProtoStats st;
+    st.uptimeMs = now;
+    st.unitMs = UNIT_MS;
+    st.pitchHz = tonePitchHz;
+    st.commits = protoCommits;
+    st.keyEdges = protoKeyEdges;
+    st.playing = keyer.playing() ? 1 : 0;
+    st.queued = (uint8_t)playQueue.size();
+    st.framesOk = protoFramesOk;
+    st.framesBad = protoFramesBad;
+    st.framesDropped = protoFramesDropped;
+    st.freeHeap = heapSampleNow().freeBytes;
+    uint8_t out[PROTO_STATS_SIZE];
+    protoSend(PROTO_STATS, seq, out, protoEncodeStats(st, out));
+    return;
+  }
+  case PROTO_SUBSCRIBE:
+    if (len < 1)
+    {
+      protoAck(seq, type, PROTO_STATUS_BAD_ARG);
+      return;
+    }
+    protoStreams = p[0];
+    protoAck(seq, type, PROTO_STATUS_OK, protoStreams);
+    return;
+  case PROTO_GET_ECHO:
+  {
+    if (len < 1)
+    {
+      protoAck(seq, type, PROTO_STATUS_BAD_ARG);
+      return;
+    }
+    // two records per frame: ~100 bytes on the wire, inside the UART FIFO
+    uint8_t out[2 + 2 * ECHO_RECORD_SIZE];
+    size_t n = 0;
+    out[n++] = (uint8_t)ECHO_CHARS;
+    out[n++] = p[0];
+    for (size_t i = p[0]; i < ECHO_CHARS && n + ECHO_RECORD_SIZE <= sizeof(out); i++)
+      n += echoEncodeStats(KOCH_ORDER[i], echo.stats(i), out + n);
+    protoSend(PROTO_ECHO, seq, out, n);
+    return;
+  }
+  case PROTO_STOP:
+    beaconStages = nullptr;
+    playQueueClear();
+    protoAck(seq, type, PROTO_STATUS_OK);
+    return;
+  default:
+    protoAck(seq, type, PROTO_STATUS_UNKNOWN);
+    return;
+  }
+}
+
+// Consume whatever has arrived; never waits for the rest of a line or frame
+void serviceSerialCommands(uint32_t now)
+{
+  while (Serial.available() > 0)
+  {
+    uint8_t b = (uint8_t)Serial.read();
+    ProtoFeed f = protoReader.feed(b, now);
+    if (f == PROTO_FEED_FRAME)
+      handleFrame(now);
+    else if (f == PROTO_FEED_BAD)
+      protoFramesBad++;
+    if (f != PROTO_FEED_TEXT)
+      continue;
+    char c = (char)b;
+    if (c == '\r')
+      continue;
+    if (c == '\n')
+    {
+      serialLine[serialLineLen] = '\0';
+      if (serialLineLen > 0)
+        handleCommand(serialLine, now);
+      serialLineLen = 0;
+    }
+    else if (serialLineLen < SERIAL_LINE_MAX)
+      serialLine[serialLineLen++] = c;
+  }
+}
+
+// ================= CW receiver =================
+#if CW_RX_ENABLE
+#include <driver/i2s.h>
+#include <driver/adc.h>
+#include "goertzel_bank.h"
+
+CwReceiver<CW_RX_BINS> cwRx;
+float cwRxDc = 2048.0f; // running ADC midpoint (12-bit)
+
+void onRxChar(uint8_t channel, char ch, void *)
+{
+  char label[6];
+  Serial.printf("RX[%u @ %.0fHz]: %s\n", channel, cwRx.bank().binHz(channel), morseCharLabel(ch, label));
+}
+
+void setupCwReceiver()
+{
+  i2s_config_t cfg = {};
+  cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+  cfg.sample_rate = CW_RX_SAMPLE_RATE;
+  cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  cfg.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+  cfg.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+  cfg.dma_buf_count = 4;
+  cfg.dma_buf_len = CW_RX_BLOCK * 2;
+  i2s_driver_install(I2S_NUM_0, &cfg, 0, NULL);
+  i2s_set_adc_mode(ADC_UNIT_1, CW_RX_ADC_CHANNEL);
+  i2s_adc_enable(I2S_NUM_0);
+
+  cwRx.configure((float)CW_RX_SAMPLE_RATE, CW_RX_LOW_HZ, CW_RX_HIGH_HZ, CW_RX_BINS, CW_RX_BLOCK, CW_RX_START_WPM);
+  cwRx.setSink(onRxChar, nullptr);
+}
+
+// Drain whatever DMA has captured so far; never waits for more
+void serviceCwReceiver()
+{
+  static uint16_t raw[CW_RX_BLOCK];
+  static float samples[CW_RX_BLOCK];
+  size_t bytesRead = 0;
+  while (i2s_read(I2S_NUM_0, raw, sizeof(raw), &bytesRead, 0) == ESP_OK && bytesRead > 0)
+  {
+    size_t n = bytesRead / sizeof(raw[0]);
+    for (size_t i = 0; i < n; i++)
+    {
+      float v = (float)(raw[i] & 0x0FFF); // top nibble carries the channel id
+      cwRxDc += (v - cwRxDc) * 0.001f;
+      samples[i] = (v - cwRxDc) * (1.0f / 2048.0f);
+    }
+    cwRx.feed(samples, n);
+  }
+}
+#endif
+
+// ================= OLED UI =================
+// The frame is composed as text (ui_frame.h) and copied line by line
+void drawUI()
+{
+  if (keyer.playing())
+    playLines.update(playMap, keyer.playIndex());
+  UiContext ctx = {UNIT_MS, replayer.active(), recorder.active(), kochActive ? &koch : nullptr,
+                   echoActive ? echoLine : nullptr, &playLines};
+  UiFrame frame;
+  uiCompose(frame, keyer, ctx);
+
+  display.clearDisplay();
+  display.setTextSize(1);
+  for (size_t i = 0; i < UI_LINES; i++)
+  {
+    display.setCursor(0, UI_LINE_Y[i]);
+    for (size_t col = 0; frame.line[i][col]; col++)
+    {
+      bool hi = frame.hiLen && i == frame.hiLine && col >= frame.hiCol && col < frame.hiCol + frame.hiLen;
+      display.setTextColor(hi ? SH110X_BLACK : SH110X_WHITE, hi ? SH110X_WHITE : SH110X_BLACK);
+      display.print(frame.line[i][col]);
+    }
+  }
+  display.display();
+}
+
+// ================= Setup / Loop =================
+// Key edges at time t -> trace, HMM decoder, keyer, trainers
+void applyKeyEdges(uint32_t t, int8_t evDot, int8_t evDash, int8_t evOk)
+{
+  keyerClockMs = t;
+  if (evDot)
+    traceEvent(evDot > 0 ? TRACE_PRESS : TRACE_RELEASE, TRACE_KEY_DOT);
+  if (evDash)
+    traceEvent(evDash > 0 ? TRACE_PRESS : TRACE_RELEASE, TRACE_KEY_DASH);
+  if (evOk)
+    traceEvent(evOk > 0 ? TRACE_PRESS : TRACE_RELEASE, TRACE_KEY_OK);
+#if HMM_DECODE_ENABLE
+  hmmKeyEdges(t, evDot, evDash);
+#endif
+
+  // Sidetone, gaps, commits, OK gestures, memory chords and playback
+  keyer.update(t, evDot, evDash, evOk);
+  kochKeyEdges(t, evDot, evDash);
+  echoKeyEdges(t, evDot, evDash);
+}
+
+// Debounced key edges at time t, or the replay's in their place
+void feedKeyer(uint32_t t, uint32_t pressed, uint32_t released)
+{
+  int8_t evDot = keyEdge(pressed, released, KEY_DOT_BIT);
+  int8_t evDash = keyEdge(pressed, released, KEY_DASH_BIT);
+  int8_t evOk = keyEdge(pressed, released, KEY_OK_BIT);
+
+  // A replay owns the keyer until it ends or a key goes down. Every recorded
+  // edge due by t is applied at its own recorded time (the keyer catches up
+  // its deadlines in between), so gaps and commits land as they did, however
+  // long this pass took.
+  if (replayer.active())
+  {
+    if (evDot == +1 || evDash == +1 || evOk == +1)
+      stopReplay(t);
+    else
+    {
+      uint32_t at;
+      KeyEdges rec;
+      while (replayer.nextTime(at) && (int32_t)(at - t) <= 0)
+      {
+        replayer.poll(at, rec);
+        applyKeyEdges((int32_t)(at - keyerClockMs) > 0 ? at : keyerClockMs, rec.ev[TRACE_KEY_DOT],
+                      rec.ev[TRACE_KEY_DASH], rec.ev[TRACE_KEY_OK]);
+      }
+      if (!replayer.nextTime(at))
+      {
+        replayer.stop();
+        Serial.println("REPLAY: END");
+      }
+      evDot = evDash = evOk = 0;
+    }
+  }
+  applyKeyEdges(t, evDot, evDash, evOk);
+}
+
+void setup()
+{
+  loopTaskHandle = xTaskGetCurrentTaskHandle(); // setup() and loop() share the task
+  Serial.begin(115200);
+  delay(150);
+
+  pinMode(DOT_BTN_PIN, INPUT_PULLUP);
+  pinMode(DASH_BTN_PIN, INPUT_PULLUP);
+  pinMode(OK_BTN_PIN, INPUT_PULLUP);
+
+#if AUDIO_OUT_MODE == 0
+  // Silent at boot for active-LOW
+  if (BUZZER_ACTIVE_LOW)
+    digitalWrite(BUZZER_PIN, HIGH);
+  else
+    digitalWrite(BUZZER_PIN, LOW);
+  pinMode(BUZZER_PIN, OUTPUT);
+#else
+  heapScope = HEAP_SUB_AUDIO;
+  setupAudioOut();
+  heapScope = HEAP_SUB_BOOT;
+#endif
+  buzzerOff();
+
+  uint32_t held = readKeys();
+#if HS_KEYING_ENABLE
+  setupKeySampler(held);
+#else
+  keyDebounce.reset(held);
+  keyLastSampleMs = millis();
+#endif
+
+  KeyerTiming keyerTiming = {LETTER_GAP_MS, WORD_GAP_MS, CLEAR_HOLD_MS, OK_MULTI_WINDOW_MS, MEM_RECORD_HOLD_MS, playTiming,
+                             EARLY_COMMIT, GUESS_MIN_CONFIDENCE, WORD_FIX_MAX_COST};
+  keyer.configure(keyerTiming, &keyerEvents);
+  keyerClockMs = millis();
+  keyer.reset(keyerClockMs, held & KEY_DOT_BIT, held & KEY_DASH_BIT, held & KEY_OK_BIT);
+
+  heapScope = HEAP_SUB_UI;
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  if (!display.begin(OLED_ADDR_PRIMARY, true))
+  {
+    display.begin(OLED_ADDR_FALLBACK, true);
+  }
+  display.clearDisplay();
+  display.setRotation(0);
+  display.display();
+
+  // Minimal splash
+  display.setTextSize(1);
+  display.setTextColor(SH110X_WHITE);
+  display.setCursor(0, 0);
+  display.print("ESP32 Morse Ready");
+  display.setCursor(0, 12);
+  display.print("DOT=13 DASH=14 OK=27");
+
+  display.setCursor(0, 24);
+  display.print("JRCSRG 2025");
+  display.display();
+  delay(2000);
+
+#if CW_RX_ENABLE
+  heapScope = HEAP_SUB_RX;
+  setupCwReceiver();
+#endif
+  heapScope = HEAP_SUB_MEMORY;
+  setupMemoryKeyer();
+  setupKochTrainer();
+#if SESSION_LOG_ENABLE
+  heapScope = HEAP_SUB_LOG;
+  setupSessionLog();
+#endif
+  heapScope = HEAP_SUB_BOOT;
+  setupHeapMonitor();
+  edgeJitter.configure(JITTER_BIN_US);
+#if HMM_DECODE_ENABLE
+  hmmDecoder.reset(UNIT_MS);
+#endif
+}
+
+void loop()
+{
+  uint32_t now = millis();
+  heapScope = HEAP_SUB_KEYER;
+
+  // Update buttons
+#if HS_KEYING_ENABLE
+  // Each sampled edge is applied at its own time (never before the keyer's
+  // clock: an edge stamped just before the last pass may arrive after it)
+  KeySample ks;
+  while (keySampler.peek(ks) && (int32_t)(ks.timeMs - now) <= 0)
+  {
+    keySampler.pop();
+    feedKeyer((int32_t)(ks.timeMs - keyerClockMs) > 0 ? ks.timeMs : keyerClockMs, ks.pressed, ks.released);
+  }
+  feedKeyer(now, 0, 0);
+#else
+  serviceKeys(now);
+  feedKeyer(now, keyDebounce.takePressed(), keyDebounce.takeReleased());
+#endif
+  serviceKoch(now);
+  serviceEcho(now);
+  playQueue.service(keyer, now, WORD_GAP_MS);
+
+#if HMM_DECODE_ENABLE
+  serviceHmmDecoder(now);
+#endif
+#if CW_RX_ENABLE
+  heapScope = HEAP_SUB_RX;
+  serviceCwReceiver();
+#endif
+  heapScope = HEAP_SUB_SERIAL;
+  serviceSerialCommands(now);
+  if (traceStreaming)
+    serviceTraceStream(now);
+  serviceRecDump();
+  serviceHeapMonitor(now);
+#if SESSION_LOG_ENABLE
+  heapScope = HEAP_SUB_LOG;
+  serviceSessionLog(now);
+  serviceLogDump();
+#endif
 
+  heapScope = HEAP_SUB_UI;
   drawUI();
   delay(5);
 }
@@ -0,0 +1,75 @@
+#pragma once
+// Host-only heap allocation counter for the native checks and benchmarks.
+// Replaces the global operator new (and, on glibc, malloc/calloc/realloc)
+// with versions that count calls and bytes, so a tool can snapshot the
+// counters around the code it exercises. Include from one .cpp only.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+
+struct AllocStats
+{
+  unsigned long long count; // allocation calls
+  unsigned long long bytes; // bytes requested
+};
+
+inline AllocStats &allocStats()
+{
+  static AllocStats s = {0, 0};
+  return s;
+}
+
+inline void allocNote(size_t n)
+{
+  allocStats().count++;
+  allocStats().bytes += n;
+}
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+
+extern "C" void *malloc(size_t n)
+{
+  allocNote(n);
+  return __libc_malloc(n);
+}
+
+extern "C" void *calloc(size_t k, size_t n)
+{
+  allocNote(k * n);
+  return __libc_calloc(k, n);
+}
+
+extern "C" void *realloc(void *p, size_t n)
+{
+  allocNote(n);
+  return __libc_realloc(p, n);
+}
+
+// operator new ends up in malloc() above
+void *operator new(size_t n)
+{
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+#else
+void *operator new(size_t n)
+{
+  allocNote(n);
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+#endif
+
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
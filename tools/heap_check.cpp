@@ -0,0 +1,219 @@
+// Host tool: native zero-heap check. Sets up the firmware's portable pipeline
+// (keyer, recorder/replayer, log batcher, stage builder) the way setup() does,
+// then simulates a long unattended session of random keying, OK gestures,
+// playback, clears and memory chords and counts every heap allocation made
+// after setup. The firmware must make none, so long-running units cannot
+// fragment their heap.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/heap_check.cpp -o heap_check
+// Usage: heap_check [-h HOURS] [-s SEED]   (default 24 h, seed 1)
+// Exits 1 if anything was allocated after setup.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc_count.h"
+#include "keyer.h"
+#include "morse_literal.h"
+#include "key_recorder.h"
+#include "session_log.h"
+#include "train_rng.h"
+
+static TrainRng rng; // reproducible per seed
+
+static const uint16_t UNIT = 120;
+static const char CHARSET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,?/=";
+
+static Keyer keyer;
+static KeyRecorder<16 * 1024> recorder;
+static LogBatcher<512> logBatch(5000, 256);
+static uint8_t logWriteBuf[2 * (LOG_HEADER_SIZE + 512)];
+static char stageBuf[KEYER_TEXT_MAX * MORSE_STAGES_PER_CHAR + 1];
+static constexpr auto MEM_SLOT = MORSE_PROGRAM("CQ CQ CQ DE JRCSRG K");
+static uint32_t now = 0;
+static unsigned long edges = 0, commits = 0, plays = 0, clears = 0, replays = 0, replayCommits = 0;
+static unsigned long logBytes = 0;
+
+// Same jobs as the device listener, minus the hardware
+class CheckListener : public KeyerListener
+{
+public:
+  void onLetter(const char *, char c, uint8_t reason) override
+  {
+    commits++;
+    logBatch.addText(c, now);
+    logBatch.addTraceEvent(now, TRACE_COMMIT, reason, (uint8_t)c);
+    recorder.add(now, TRACE_COMMIT, reason, (uint8_t)c);
+  }
+  void onSpace() override
+  {
+    logBatch.addText(' ', now);
+    logBatch.addTraceEvent(now, TRACE_SPACE);
+  }
+  void onClear() override
+  {
+    clears++;
+    logBatch.addTraceEvent(now, TRACE_CLEAR);
+  }
+  void onPlayStart(const char *, uint8_t source) override
+  {
+    plays++;
+    logBatch.addTraceEvent(now, TRACE_PLAY_START, source);
+  }
+  void onMemory(uint8_t, bool record, uint32_t t) override
+  {
+    if (record)
+      morseBuildStagesFromText(keyer.text(), stageBuf, sizeof(stageBuf));
+    else
+      keyer.startPlaybackStages(MEM_SLOT.data(), MEM_SLOT.size(), t, TRACE_PLAY_MEMORY);
+  }
+};
+
+// Counts commits only; a second keyer re-running the last recording
+class ReplayCounter : public KeyerListener
+{
+public:
+  void onLetter(const char *, char, uint8_t) override { replayCommits++; }
+};
+
+static CheckListener listener;
+static ReplayCounter replayListener;
+static Keyer replayKeyer;
+
+// Let the keyer reach time t (deadlines on the way), then apply one edge
+static void edgeAt(uint32_t t, uint8_t key, bool down)
+{
+  uint32_t due;
+  while (keyer.nextDeadline(due) && (int32_t)(due - t) < 0)
+  {
+    now = due;
+    keyer.update(now, 0, 0, 0);
+  }
+  now = t;
+  int8_t ev[3] = {0, 0, 0};
+  ev[key] = down ? +1 : -1;
+  logBatch.addTraceEvent(now, down ? TRACE_PRESS : TRACE_RELEASE, key);
+  recorder.add(now, down ? TRACE_PRESS : TRACE_RELEASE, key);
+  keyer.update(now, ev[0], ev[1], ev[2]);
+  edges++;
+  if (logBatch.due(now))
+    logBytes += logBatch.drain(logWriteBuf);
+}
+
+static void tap(uint32_t &t, uint8_t key, uint32_t holdMs, uint32_t gapMs)
+{
+  edgeAt(t, key, true);
+  t += holdMs;
+  edgeAt(t, key, false);
+  t += gapMs;
+}
+
+static uint32_t jitter(uint32_t ms) { return ms - ms / 5 + rng.below(ms * 2 / 5 + 1); }
+
+// Replay the finished recording through a fresh keyer on a virtual clock
+static void replayRecording()
+{
+  KeyReplayer rp;
+  if (!rp.begin(recorder.data(), recorder.size(), 0))
+    return;
+  replayKeyer.reset(0);
+  uint32_t t = 0, next, due;
+  while (rp.nextTime(next))
+  {
+    t = replayKeyer.nextDeadline(due) && (int32_t)(due - next) < 0 ? due : next;
+    KeyEdges e;
+    rp.poll(t, e);
+    replayKeyer.update(t, e.ev[0], e.ev[1], e.ev[2]);
+  }
+  replays++;
+}
+
+int main(int argc, char **argv)
+{
+  double hours = 24.0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-h") && i + 1 < argc)
+      hours = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      rng.seed((uint32_t)strtoul(argv[++i], nullptr, 10));
+    else
+    {
+      fprintf(stderr, "usage: heap_check [-h hours] [-s seed]\n");
+      return 2;
+    }
+  }
+
+  // ---- setup() ----
+  keyer.configure(keyerTimingForUnit(UNIT), &listener);
+  keyer.reset(0);
+  replayKeyer.configure(keyerTimingForUnit(UNIT), &replayListener);
+  logBatch.addTraceHeader(UNIT, 0);
+  recorder.start(0, UNIT);
+  printf("simulating %.1f h of keying...\n", hours);
+  fflush(stdout); // stdio allocates its buffer on first use
+
+  // ---- loop() ----
+  AllocStats before = allocStats();
+  const uint64_t endMs = (uint64_t)(hours * 3600000.0);
+  uint64_t elapsed = 0;
+  uint32_t t = 1;
+  uint32_t nextRecordingMs = 10 * 60000;
+  while (elapsed < endMs)
+  {
+    uint32_t start = t;
+    uint32_t r = rng.below(100);
+    if (r < 85)
+    {
+      // one letter, then a letter or word gap (auto commit) or an OK tap
+      const char *pat = morseEncode(CHARSET[rng.below(sizeof(CHARSET) - 1)]);
+      for (const char *p = pat; *p; p++)
+        tap(t, *p == '.' ? TRACE_KEY_DOT : TRACE_KEY_DASH, jitter(*p == '.' ? UNIT : 3 * UNIT), jitter(UNIT));
+      uint32_t g = rng.below(10);
+      if (g < 2)
+        tap(t, TRACE_KEY_OK, jitter(80), jitter(700));
+      else
+        t += g < 8 ? jitter(3 * UNIT) : jitter(7 * UNIT);
+    }
+    else if (r < 93)
+    {
+      // triple tap: playback runs until the next key-down
+      for (int i = 0; i < 3; i++)
+        tap(t, TRACE_KEY_OK, jitter(80), jitter(120));
+      t += rng.below(20000);
+    }
+    else if (r < 97)
+    {
+      // memory chord: OK held, DOT tapped (sometimes held to record)
+      edgeAt(t, TRACE_KEY_OK, true);
+      t += 100;
+      tap(t, TRACE_KEY_DOT, rng.below(2) ? 150 : 1700, 50);
+      edgeAt(t, TRACE_KEY_OK, false);
+      t += jitter(1000);
+    }
+    else
+    {
+      tap(t, TRACE_KEY_OK, 2200, jitter(1000)); // long press: clear
+      morseBuildStagesFromText("PARIS PARIS CQ DE TEST", stageBuf, sizeof(stageBuf));
+    }
+    elapsed += t - start;
+
+    if ((int32_t)(t - nextRecordingMs) >= 0)
+    {
+      recorder.stop();
+      replayRecording();
+      recorder.start(t, UNIT);
+      keyer.reset(t);
+      nextRecordingMs = t + 10 * 60000;
+    }
+  }
+  logBytes += logBatch.drain(logWriteBuf);
+  AllocStats after = allocStats();
+
+  unsigned long long n = after.count - before.count;
+  unsigned long long bytes = after.bytes - before.bytes;
+  printf("%lu edges, %lu commits, %lu plays, %lu clears, %lu replays (%lu commits), %lu log bytes\n", edges, commits,
+         plays, clears, replays, replayCommits, logBytes);
+  printf("heap allocations after setup: %llu (%llu bytes)\n", n, bytes);
+  return n == 0 ? 0 : 1;
+}
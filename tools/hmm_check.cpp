@@ -0,0 +1,438 @@
+// Host tool: accuracy and throughput of the HMM timing decoder (morse_hmm.h)
+// against the threshold keyer (keyer.h), on sloppy synthetic keying or on
+// recorded traces.
+//
+// Synthetic: random dictionary words keyed by a simulated hand sender, with
+// element lengths scattered by -j percent (log-normal), gaps by -g percent,
+// letter gaps squeezed to -L units and the speed wandering by up to -d
+// percent. Both decoders get the same key edges. The keyer uses its fixed
+// 3u/7u thresholds at the nominal speed, and the HMM decides from the whole
+// run. Each HMM window size is run on the paddles (the key says dot or
+// dash) and as a straight key (duration only).
+//
+// Traces (-r): every key-trace stream in a REC DUMP / TRACE ON capture or a
+// session log is decoded by the HMM. The text the device committed is the
+// reference, so the error rate measures disagreement with the keyer.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/hmm_check.cpp -o hmm_check
+// Usage: hmm_check [options]
+//   -w WPM     nominal speed (default 18)
+//   -n CHARS   characters to send (default 3000)
+//   -j PCT     mark length scatter (default 15)
+//   -g PCT     gap length scatter (default 20)
+//   -L UNITS   letter gap the sender actually leaves (default 2.5)
+//   -d PCT     speed drift range (default 20)
+//   -x SEED    seed (default 1)
+//   -r FILE    decode recorded traces instead
+//   -v         print reference and decoded text
+// Prints character error rate (edit distance / reference length) and ns per
+// observation for each decoder. First checks that a flush after a mark closes
+// the letter (exits 1 if not).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "keyer.h"
+#include "morse_hmm.h"
+#include "session_log.h"
+#include "train_rng.h"
+
+static void usage()
+{
+  fprintf(stderr, "usage: hmm_check [-w wpm] [-n chars] [-j pct] [-g pct] [-L units] [-d pct] [-x seed] [-r file] [-v]\n");
+  exit(2);
+}
+
+static TrainRng rng; // reproducible per seed
+
+// Standard normal (Box-Muller)
+static double gauss()
+{
+  double u = (rng.below(1u << 30) + 1.0) / (double)(1u << 30);
+  double v = rng.below(1u << 30) / (double)(1u << 30);
+  return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+struct Edge
+{
+  uint32_t t;
+  uint8_t key; // TRACE_KEY_*
+  bool down;
+};
+
+static size_t editDistance(const std::string &a, const std::string &b)
+{
+  std::vector<size_t> row(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); j++)
+    row[j] = j;
+  for (size_t i = 1; i <= a.size(); i++)
+  {
+    size_t diag = row[0];
+    row[0] = i;
+    for (size_t j = 1; j <= b.size(); j++)
+    {
+      size_t up = row[j];
+      size_t best = diag + (a[i - 1] != b[j - 1]);
+      if (up + 1 < best)
+        best = up + 1;
+      if (row[j - 1] + 1 < best)
+        best = row[j - 1] + 1;
+      row[j] = best;
+      diag = up;
+    }
+  }
+  return row[b.size()];
+}
+
+// Spaces collapsed and trimmed, so word-gap decisions at the ends do not count
+static std::string normalize(const std::string &s)
+{
+  std::string out;
+  for (char c : s)
+    if (c != ' ' || (!out.empty() && out.back() != ' '))
+      out += c;
+  while (!out.empty() && out.back() == ' ')
+    out.pop_back();
+  return out;
+}
+
+// ---- Decoders ----
+
+template <size_t W>
+static std::string runHmm(const std::vector<Edge> &edges, float unitMs, bool paddles, double &nsPerObs)
+{
+  static MorseHmm<W> hmm;
+  hmm.reset(unitMs);
+  std::string out;
+  char c;
+  auto t0 = std::chrono::steady_clock::now();
+  for (const Edge &e : edges)
+  {
+    if (e.key == TRACE_KEY_OK)
+      continue;
+    hmm.poll(e.t);
+    if (e.down)
+      hmm.keyDown(e.t, paddles ? (int8_t)(e.key == TRACE_KEY_DASH ? MORSE_HMM_DASH : MORSE_HMM_DOT) : -1);
+    else
+      hmm.keyUp(e.t);
+    while (hmm.read(c))
+      out += c;
+  }
+  hmm.flush(edges.empty() ? 0 : edges.back().t + 5000);
+  while (hmm.read(c))
+    out += c;
+  auto t1 = std::chrono::steady_clock::now();
+  nsPerObs = hmm.observations() ? std::chrono::duration<double, std::nano>(t1 - t0).count() / hmm.observations() : 0;
+  return out;
+}
+
+class TextListener : public KeyerListener
+{
+public:
+  std::string text;
+  void onLetter(const char *, char c, uint8_t) override { text += c; }
+  void onSpace() override { text += ' '; }
+};
+
+static std::string runKeyer(const std::vector<Edge> &edges, uint16_t unitMs, double &nsPerEdge)
+{
+  Keyer keyer;
+  TextListener out;
+  keyer.configure(keyerTimingForUnit(unitMs), &out);
+  keyer.reset(edges.empty() ? 0 : edges.front().t);
+  auto t0 = std::chrono::steady_clock::now();
+  for (const Edge &e : edges)
+  {
+    uint32_t due;
+    while (keyer.nextDeadline(due) && (int32_t)(due - e.t) < 0)
+      keyer.update(due, 0, 0, 0);
+    int8_t ev[3] = {};
+    ev[e.key] = e.down ? +1 : -1;
+    keyer.update(e.t, ev[TRACE_KEY_DOT], ev[TRACE_KEY_DASH], ev[TRACE_KEY_OK]);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  nsPerEdge = edges.empty() ? 0 : std::chrono::duration<double, std::nano>(t1 - t0).count() / edges.size();
+  return out.text;
+}
+
+// ---- Inputs ----
+
+static std::vector<std::string> dictWords()
+{
+  std::vector<std::string> words;
+  std::string w;
+  for (const char *p = MORSE_DICT_WORDS;; p++)
+  {
+    if (*p && *p != ' ')
+      w += *p;
+    else if (!w.empty())
+    {
+      words.push_back(w);
+      w.clear();
+    }
+    if (!*p)
+      break;
+  }
+  return words;
+}
+
+struct Sender
+{
+  double unitMs, markPct, gapPct, letterUnits, driftPct;
+  double speed = 1.0; // current unit multiplier
+
+  uint32_t scatter(double units, double pct)
+  {
+    double ms = units * unitMs * speed * exp(gauss() * pct / 100.0);
+    return ms < 1 ? 1 : (uint32_t)(ms + 0.5);
+  }
+
+  void drift()
+  {
+    speed *= exp(gauss() * driftPct / 400.0);
+    double lo = 1.0 - driftPct / 100.0, hi = 1.0 + driftPct / 100.0;
+    speed = speed < lo ? lo : speed > hi ? hi : speed;
+  }
+};
+
+static std::string synthesize(Sender &snd, long chars, std::vector<Edge> &edges)
+{
+  std::vector<std::string> words = dictWords();
+  std::string sent;
+  uint32_t t = 1000;
+  while ((long)sent.size() < chars)
+  {
+    if (!sent.empty())
+    {
+      sent += ' ';
+      t += snd.scatter(7, snd.gapPct);
+    }
+    const std::string &w = words[rng.below((uint32_t)words.size())];
+    for (size_t i = 0; i < w.size(); i++)
+    {
+      if (i)
+        t += snd.scatter(snd.letterUnits, snd.gapPct);
+      snd.drift();
+      sent += w[i];
+      for (const char *p = morseEncode(w[i]); *p; p++)
+      {
+        uint8_t key = *p == '-' ? TRACE_KEY_DASH : TRACE_KEY_DOT;
+        edges.push_back({t, key, true});
+        t += snd.scatter(*p == '-' ? 3 : 1, snd.markPct);
+        edges.push_back({t, key, false});
+        if (p[1])
+          t += snd.scatter(1, snd.gapPct);
+      }
+    }
+  }
+  // OK tap so the keyer commits the last letter
+  t += snd.scatter(snd.letterUnits, snd.gapPct);
+  edges.push_back({t, TRACE_KEY_OK, true});
+  edges.push_back({t + 80, TRACE_KEY_OK, false});
+  return sent;
+}
+
+struct Stream
+{
+  uint16_t unitMs = 0;
+  std::vector<Edge> edges;
+  std::string committed;
+};
+
+static bool loadTraces(const char *path, std::vector<Stream> &streams)
+{
+  FILE *in = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!in)
+  {
+    perror(path);
+    return false;
+  }
+  std::vector<uint8_t> buf;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    buf.insert(buf.end(), chunk, chunk + got);
+  if (in != stdin)
+    fclose(in);
+
+  auto add = [&](const TraceEvent &ev) {
+    Stream &s = streams.back();
+    if (ev.type == TRACE_PRESS || ev.type == TRACE_RELEASE)
+      s.edges.push_back({ev.timeMs, ev.arg, ev.type == TRACE_PRESS});
+    else if (ev.type == TRACE_COMMIT)
+      s.committed += (char)ev.payload;
+    else if (ev.type == TRACE_SPACE)
+      s.committed += ' ';
+    else if (ev.type == TRACE_CLEAR)
+      s.committed += ' ';
+  };
+  TraceReader bare(buf.data(), buf.size());
+  uint16_t unitMs;
+  if (bare.readHeader(unitMs))
+  {
+    streams.emplace_back();
+    streams.back().unitMs = unitMs;
+    TraceEvent ev;
+    while (bare.next(ev))
+      add(ev);
+    return true;
+  }
+  size_t pos = 0;
+  TraceFollower follower;
+  while (pos < buf.size())
+  {
+    LogRecordView rec;
+    size_t used = 0;
+    LogParseResult r = logParseRecord(&buf[pos], buf.size() - pos, rec, used);
+    pos += used;
+    TraceReader rd(nullptr, 0);
+    bool started;
+    if (r != LOG_PARSE_OK || !follower.open(rec, rd, started, unitMs))
+      continue;
+    if (started)
+    {
+      streams.emplace_back();
+      streams.back().unitMs = unitMs;
+    }
+    if (streams.empty())
+      continue;
+    TraceEvent ev;
+    while (rd.next(ev))
+      add(ev);
+    follower.close(rd);
+  }
+  return true;
+}
+
+// ---- Report ----
+
+static void report(const char *name, const std::string &ref, const std::string &got, double ns, bool verbose)
+{
+  std::string a = normalize(ref), b = normalize(got);
+  double cer = a.empty() ? 0 : 100.0 * editDistance(a, b) / a.size();
+  printf("%-22s %7.2f%% %10.1f\n", name, cer, ns);
+  if (verbose)
+    printf("  %s\n", b.c_str());
+}
+
+template <size_t W>
+static void hmmRow(const char *mode, const std::vector<Edge> &edges, float unitMs, bool paddles,
+                   const std::string &ref, bool verbose)
+{
+  double ns;
+  std::string got = runHmm<W>(edges, unitMs, paddles, ns);
+  char name[40];
+  snprintf(name, sizeof(name), "hmm %s w=%zu", mode, W);
+  report(name, ref, got, ns, verbose);
+}
+
+static void compare(const std::vector<Edge> &edges, uint16_t unitMs, const std::string &ref, bool withKeyer,
+                    bool verbose)
+{
+  printf("%-22s %8s %10s\n", "decoder", "CER", "ns/obs");
+  if (verbose)
+    printf("  reference: %s\n", normalize(ref).c_str());
+  if (withKeyer)
+  {
+    double ns;
+    std::string got = runKeyer(edges, unitMs, ns);
+    report("keyer thresholds", ref, got, ns, verbose);
+  }
+  hmmRow<8>("paddles", edges, unitMs, true, ref, verbose);
+  hmmRow<16>("paddles", edges, unitMs, true, ref, verbose);
+  hmmRow<32>("paddles", edges, unitMs, true, ref, verbose);
+  hmmRow<64>("paddles", edges, unitMs, true, ref, verbose);
+  hmmRow<16>("straight", edges, unitMs, false, ref, verbose);
+  hmmRow<32>("straight", edges, unitMs, false, ref, verbose);
+}
+
+// A run that ends on a mark and is flushed must close its last letter:
+// ".-", flush, "." reads "AE", not one merged letter ("R")
+static bool flushAfterMark()
+{
+  static MorseHmm<> hmm;
+  const uint32_t u = 60;
+  hmm.reset((float)u);
+  hmm.observe(true, u, MORSE_HMM_DOT);
+  hmm.observe(false, u, -1);
+  hmm.observe(true, 3 * u, MORSE_HMM_DASH);
+  hmm.flush(0);
+  hmm.observe(true, u, MORSE_HMM_DOT);
+  hmm.observe(false, 20 * u, -1);
+  hmm.flush(0);
+  std::string out;
+  char c;
+  while (hmm.read(c))
+    out += c;
+  bool ok = normalize(out) == "AE";
+  printf("flush after a mark: \"%s\" %s\n", out.c_str(), ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  double wpm = 18, markPct = 15, gapPct = 20, letterUnits = 2.5, driftPct = 20;
+  long chars = 3000;
+  const char *tracePath = nullptr;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    bool hasVal = i + 1 < argc;
+    if (!strcmp(a, "-w") && hasVal)
+      wpm = atof(argv[++i]);
+    else if (!strcmp(a, "-n") && hasVal)
+      chars = atol(argv[++i]);
+    else if (!strcmp(a, "-j") && hasVal)
+      markPct = atof(argv[++i]);
+    else if (!strcmp(a, "-g") && hasVal)
+      gapPct = atof(argv[++i]);
+    else if (!strcmp(a, "-L") && hasVal)
+      letterUnits = atof(argv[++i]);
+    else if (!strcmp(a, "-d") && hasVal)
+      driftPct = atof(argv[++i]);
+    else if (!strcmp(a, "-x") && hasVal)
+      rng.seed((uint32_t)strtoul(argv[++i], nullptr, 10));
+    else if (!strcmp(a, "-r") && hasVal)
+      tracePath = argv[++i];
+    else if (!strcmp(a, "-v"))
+      verbose = true;
+    else
+      usage();
+  }
+  if (wpm <= 0 || chars < 1 || markPct < 0 || gapPct < 0 || letterUnits <= 1 || driftPct < 0 || driftPct >= 100)
+    usage();
+
+  if (!flushAfterMark())
+    return 1;
+
+  if (tracePath)
+  {
+    std::vector<Stream> streams;
+    if (!loadTraces(tracePath, streams))
+      return 1;
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+      const Stream &s = streams[i];
+      if (s.edges.empty())
+        continue;
+      printf("stream %zu: unit %u ms, %zu key edges, %zu chars committed\n", i, s.unitMs, s.edges.size(),
+             s.committed.size());
+      compare(s.edges, s.unitMs, s.committed, false, verbose);
+    }
+    return 0;
+  }
+
+  const uint16_t unitMs = (uint16_t)(1200.0 / wpm + 0.5);
+  Sender snd = {(double)unitMs, markPct, gapPct, letterUnits, driftPct};
+  std::vector<Edge> edges;
+  std::string sent = synthesize(snd, chars, edges);
+  printf("%.0f WPM (unit %u ms), %zu chars, marks +-%.0f%%, gaps +-%.0f%%, letter gap %.1fu, drift %.0f%%\n", wpm,
+         unitMs, sent.size(), markPct, gapPct, letterUnits, driftPct);
+  compare(edges, unitMs, sent, true, verbose);
+  return 0;
+}
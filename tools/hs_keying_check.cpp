@@ -0,0 +1,271 @@
+// Host tool: high-speed keying stress test. Synthesises straight keying of
+// random text on the DOT/DASH buttons (contact bounce on every transition,
+// element and gap lengths jittered), samples it the way the firmware does
+// and checks that the keyer commits exactly the text that was sent.
+//
+// Default is the HS_KEYING_ENABLE path: timer sampling with a unit-scaled
+// debounce (key_sampler.h), edges applied at their own times by a main loop
+// that also spends time on the OLED. -L switches to the classic path (one
+// reading per loop pass, fixed DEBOUNCE_MS) for comparison.
+//
+// Element and in-letter gap lengths vary by -j percent either way. Letter and
+// word gaps are keyed -g percent over their nominal 3u / 7u plus up to -j
+// percent more: the keyer commits a letter once a silence reaches 3u, so an
+// operator sitting exactly on 3u is ambiguous at any speed.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/hs_keying_check.cpp -o hs_keying_check
+// Usage: hs_keying_check [options]
+//   -w WPM     speed (default 60)
+//   -n CHARS   characters to send (default 5000)
+//   -b MS      contact bounce after each transition (default 1.5)
+//   -j PCT     timing jitter (default 15)
+//   -g PCT     letter / word gap margin (default 10)
+//   -l MS      loop period (default 5)
+//   -d MS      OLED refresh per pass (default 25)
+//   -L         classic loop sampling instead of the timer
+//   -x SEED    seed (default 1)
+//   -v         print sent and decoded text
+// Exits 1 if the decoded text differs from the sent text.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "keyer.h"
+#include "key_sampler.h"
+#include "train_rng.h"
+
+static void usage()
+{
+  fprintf(stderr, "usage: hs_keying_check [-w wpm] [-n chars] [-b ms] [-j pct] [-g pct] [-l ms] [-d ms] [-L] [-x seed] [-v]\n");
+  exit(2);
+}
+
+static TrainRng rng; // reproducible per seed
+
+// Firmware constants (main.cpp)
+static const uint16_t DEBOUNCE_MS = 25;
+static const uint8_t HS_DEBOUNCE_DIV = 4;
+static const uint32_t HS_MIN_SAMPLE_US = 250;
+static const uint32_t DOT_BIT = 1, DASH_BIT = 2, OK_BIT = 4;
+static const char CHARSET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,?/=";
+
+// Raw key level over time as a list of transitions
+struct Level
+{
+  uint64_t us;
+  uint32_t keys; // bits held from here on
+};
+
+class Waveform
+{
+public:
+  std::vector<Level> steps{{0, 0}};
+
+  // Switch `bit` to `down` at time t, chattering for up to bounceUs after it
+  void set(uint64_t t, uint32_t bit, bool down, uint32_t bounceUs)
+  {
+    uint32_t settled = down ? (cur() | bit) : (cur() & ~bit);
+    uint32_t other = settled ^ bit;
+    uint64_t at = t;
+    uint32_t flips = bounceUs ? rng.below(6) : 0;
+    for (uint32_t i = 0; i < flips; i++)
+    {
+      push(at, i % 2 == 0 ? settled : other);
+      at += 20 + rng.below(bounceUs / (flips + 1) + 1);
+    }
+    push(at, settled);
+  }
+
+  uint32_t at(uint64_t t)
+  {
+    while (cursor_ + 1 < steps.size() && steps[cursor_ + 1].us <= t)
+      cursor_++;
+    return steps[cursor_].keys;
+  }
+
+private:
+  uint32_t cur() const { return steps.back().keys; }
+  void push(uint64_t t, uint32_t keys)
+  {
+    if (t < steps.back().us)
+      t = steps.back().us;
+    steps.push_back({t, keys});
+  }
+  size_t cursor_ = 0;
+};
+
+class TextListener : public KeyerListener
+{
+public:
+  std::string text;
+  void onLetter(const char *, char c, uint8_t) override { text += c; }
+  void onSpace() override { text += ' '; }
+};
+
+static int8_t edge(uint32_t pressed, uint32_t released, uint32_t bit)
+{
+  return (pressed & bit) ? +1 : (released & bit) ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  double wpm = 60, bounceMs = 1.5, jitterPct = 15, gapPct = 10, loopMs = 5, drawMs = 25;
+  long chars = 5000;
+  bool classic = false, verbose = false;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    bool hasVal = i + 1 < argc;
+    if (!strcmp(a, "-w") && hasVal)
+      wpm = atof(argv[++i]);
+    else if (!strcmp(a, "-n") && hasVal)
+      chars = atol(argv[++i]);
+    else if (!strcmp(a, "-b") && hasVal)
+      bounceMs = atof(argv[++i]);
+    else if (!strcmp(a, "-j") && hasVal)
+      jitterPct = atof(argv[++i]);
+    else if (!strcmp(a, "-g") && hasVal)
+      gapPct = atof(argv[++i]);
+    else if (!strcmp(a, "-l") && hasVal)
+      loopMs = atof(argv[++i]);
+    else if (!strcmp(a, "-d") && hasVal)
+      drawMs = atof(argv[++i]);
+    else if (!strcmp(a, "-L"))
+      classic = true;
+    else if (!strcmp(a, "-x") && hasVal)
+      rng.seed((uint32_t)strtoul(argv[++i], nullptr, 10));
+    else if (!strcmp(a, "-v"))
+      verbose = true;
+    else
+      usage();
+  }
+  if (wpm <= 0 || chars < 1 || bounceMs < 0 || jitterPct < 0 || jitterPct >= 100 || gapPct < 0 || loopMs < 0 ||
+      drawMs < 0)
+    usage();
+
+  const uint16_t unitMs = (uint16_t)(1200.0 / wpm + 0.5);
+  const uint64_t unitUs = unitMs * 1000ULL;
+  const uint32_t bounceUs = (uint32_t)(bounceMs * 1000);
+  auto gap = [&](uint64_t us) {
+    us += (uint64_t)(us * gapPct / 100);
+    return us + rng.below((uint32_t)(us * jitterPct / 100) + 1);
+  };
+  auto vary = [&](uint64_t us) {
+    uint32_t j = (uint32_t)(us * jitterPct / 100);
+    return us - j + rng.below(2 * j + 1);
+  };
+
+  // ---- keying ----
+  Waveform wave;
+  std::string sent;
+  uint64_t t = 100000;
+  for (long n = 0; n < chars; n++)
+  {
+    char c = CHARSET[rng.below(sizeof(CHARSET) - 1)];
+    sent += c;
+    for (const char *p = morseEncode(c); *p; p++)
+    {
+      uint32_t bit = *p == '.' ? DOT_BIT : DASH_BIT;
+      wave.set(t, bit, true, bounceUs);
+      t += vary(*p == '.' ? unitUs : 3 * unitUs);
+      wave.set(t, bit, false, bounceUs);
+      t += p[1] ? vary(unitUs) : 0;
+    }
+    if (n + 1 < chars && rng.below(6) == 0)
+    {
+      sent += ' ';
+      t += gap(7 * unitUs);
+    }
+    else
+      t += gap(3 * unitUs);
+  }
+  // OK tap commits the last letter
+  wave.set(t, OK_BIT, true, bounceUs);
+  t += 80000;
+  wave.set(t, OK_BIT, false, bounceUs);
+  const uint64_t endUs = t + 2000000;
+
+  // ---- sampling + loop ----
+  Keyer keyer;
+  TextListener out;
+  keyer.configure(keyerTimingForUnit(unitMs), &out);
+  keyer.reset(0);
+  uint32_t keyerClock = 0;
+
+  const uint32_t periodUs = classic ? DEBOUNCE_MS / VerticalDebouncer::DEBOUNCE_SAMPLES * 1000u
+                                    : keySamplePeriodUs(unitMs, HS_DEBOUNCE_DIV, DEBOUNCE_MS, HS_MIN_SAMPLE_US);
+  const uint64_t passUs = (uint64_t)((loopMs + drawMs) * 1000) + 1;
+  KeySampler<32> sampler;
+  sampler.reset(0);
+  VerticalDebouncer loopDebounce;
+  loopDebounce.reset(0);
+  uint64_t nextSampleUs = periodUs, nextPassUs = passUs, lastTickUs = 0;
+  uint32_t passes = 0;
+
+  auto feed = [&](uint32_t ms, uint32_t pressed, uint32_t released) {
+    keyerClock = ms;
+    keyer.update(ms, edge(pressed, released, DOT_BIT), edge(pressed, released, DASH_BIT), edge(pressed, released, OK_BIT));
+  };
+
+  while (nextPassUs < endUs)
+  {
+    if (!classic && nextSampleUs <= nextPassUs)
+    {
+      // timer tick
+      sampler.sample(wave.at(nextSampleUs), (uint32_t)(nextSampleUs / 1000));
+      nextSampleUs += periodUs;
+      continue;
+    }
+    // loop pass: millis() is read at its start, the OLED takes the rest
+    uint64_t passStart = nextPassUs;
+    uint32_t now = (uint32_t)(passStart / 1000);
+    passes++;
+    if (classic)
+    {
+      // serviceKeys(): one reading stands for every elapsed tick
+      uint64_t ticks = (passStart - lastTickUs) / periodUs;
+      if (ticks)
+      {
+        lastTickUs += ticks * periodUs;
+        if (ticks > VerticalDebouncer::DEBOUNCE_SAMPLES)
+          ticks = VerticalDebouncer::DEBOUNCE_SAMPLES;
+        uint32_t raw = wave.at(passStart);
+        while (ticks--)
+          loopDebounce.sample(raw);
+      }
+      feed(now, loopDebounce.takePressed(), loopDebounce.takeReleased());
+    }
+    else
+    {
+      KeySample ks;
+      while (sampler.peek(ks) && (int32_t)(ks.timeMs - now) <= 0)
+      {
+        sampler.pop();
+        feed((int32_t)(ks.timeMs - keyerClock) > 0 ? ks.timeMs : keyerClock, ks.pressed, ks.released);
+      }
+      feed(now, 0, 0);
+    }
+    nextPassUs += passUs + rng.below(1000);
+  }
+
+  size_t same = 0;
+  while (same < sent.size() && same < out.text.size() && sent[same] == out.text[same])
+    same++;
+  bool ok = same == sent.size() && same == out.text.size();
+  printf("%.0f WPM (unit %u ms), %s sampling every %u us (debounce %u us), loop %.1f+%.1f ms\n", wpm, unitMs,
+         classic ? "loop" : "timer", periodUs, periodUs * VerticalDebouncer::DEBOUNCE_SAMPLES, loopMs, drawMs);
+  printf("%zu chars sent, %zu decoded, %u passes, %u dropped edges\n", sent.size(), out.text.size(), passes,
+         sampler.dropped());
+  if (verbose)
+    printf("sent:    %s\ndecoded: %s\n", sent.c_str(), out.text.c_str());
+  if (!ok)
+  {
+    size_t from = same > 20 ? same - 20 : 0;
+    printf("first difference at char %zu\n  sent:    ...%s\n  decoded: ...%s\n", same + 1,
+           sent.substr(from, 40).c_str(), out.text.substr(from, 40).c_str());
+  }
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// Host tool: playback edge-jitter check. Plays a message through the
+// firmware's keyer on a simulated main loop (one pass every -l ms plus the
+// -d ms a frame takes to reach the OLED, plus up to -r ms of random extra) and
+// times every tone edge against the ideal schedule with the same histogram
+// the device keeps (edge_jitter.h, serial JITTER). Use it to see what a loop
+// change does to timing at a given speed before trying it on hardware.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/jitter_check.cpp -o jitter_check
+// Usage: jitter_check [options] ["TEXT"]   (default "PARIS")
+//   -w WPM     speed (default 10 = the firmware's 120 ms unit)
+//   -s SEC     simulated playing time (default 600)
+//   -l MS      loop period without the display (default 5, the delay() in loop())
+//   -d MS      display refresh per pass (default 0; a full SH1106 frame over
+//              400 kHz I2C takes about 25)
+//   -r MS      random extra per pass, uniform 0..MS (default 1)
+//   -p PCT     percentile to check (default 99)
+//   -m US      limit for that percentile (default 10% of a unit)
+//   -x SEED    seed for the random extra (default 1)
+//   -v         print the histogram
+// Exits 1 when the percentile is over the limit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "keyer.h"
+#include "edge_jitter.h"
+#include "train_rng.h"
+
+static void usage()
+{
+  fprintf(stderr, "usage: jitter_check [-w wpm] [-s sec] [-l ms] [-d ms] [-r ms] [-p pct] [-m us] [-x seed] [-v] [TEXT]\n");
+  exit(2);
+}
+
+static TrainRng rng; // reproducible per seed
+
+// The device listener's jitter hook, on the simulated clock
+class JitterListener : public KeyerListener
+{
+public:
+  Keyer *keyer = nullptr;
+  EdgeJitter jitter;
+  uint64_t nowUs = 0;
+
+  void onTone(bool) override
+  {
+    if (keyer->playing())
+      jitter.record(keyer->playStageStartMs(), (uint32_t)nowUs);
+  }
+};
+
+int main(int argc, char **argv)
+{
+  double wpm = 10, seconds = 600, loopMs = 5, drawMs = 0, randMs = 1;
+  int pct = 99;
+  long limitUs = -1;
+  bool verbose = false;
+  const char *text = "PARIS";
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    bool hasVal = i + 1 < argc;
+    if (!strcmp(a, "-w") && hasVal)
+      wpm = atof(argv[++i]);
+    else if (!strcmp(a, "-s") && hasVal)
+      seconds = atof(argv[++i]);
+    else if (!strcmp(a, "-l") && hasVal)
+      loopMs = atof(argv[++i]);
+    else if (!strcmp(a, "-d") && hasVal)
+      drawMs = atof(argv[++i]);
+    else if (!strcmp(a, "-r") && hasVal)
+      randMs = atof(argv[++i]);
+    else if (!strcmp(a, "-p") && hasVal)
+      pct = atoi(argv[++i]);
+    else if (!strcmp(a, "-m") && hasVal)
+      limitUs = atol(argv[++i]);
+    else if (!strcmp(a, "-x") && hasVal)
+      rng.seed((uint32_t)strtoul(argv[++i], nullptr, 10));
+    else if (!strcmp(a, "-v"))
+      verbose = true;
+    else if (a[0] == '-' && a[1] != '\0')
+      usage();
+    else
+      text = a;
+  }
+  if (wpm <= 0 || seconds <= 0 || loopMs < 0 || drawMs < 0 || randMs < 0 || pct < 1 || pct > 100)
+    usage();
+
+  uint16_t unitMs = (uint16_t)(1200.0 / wpm + 0.5);
+  if (unitMs == 0)
+    unitMs = 1;
+  if (limitUs < 0)
+    limitUs = unitMs * 100L; // 10% of a unit
+
+  static char stages[KEYER_TEXT_MAX * MORSE_STAGES_PER_CHAR + 1];
+  size_t len = morseBuildStagesFromText(text, stages, sizeof(stages));
+  if (len == 0)
+  {
+    fprintf(stderr, "nothing to play in \"%s\"\n", text);
+    return 2;
+  }
+
+  Keyer keyer;
+  JitterListener out;
+  out.keyer = &keyer;
+  out.jitter.configure(EDGE_JITTER_BIN_US);
+  keyer.configure(keyerTimingForUnit(unitMs), &out);
+  keyer.reset(0);
+
+  // Start on a pass boundary, like a triple tap would
+  const uint64_t passUs = (uint64_t)((loopMs + drawMs) * 1000.0);
+  const uint32_t randUs = (uint32_t)(randMs * 1000.0);
+  uint64_t t = 1000;
+  out.nowUs = t;
+  keyer.startPlaybackStages(stages, len, (uint32_t)(t / 1000), TRACE_PLAY_TEXT);
+  const uint64_t endUs = t + (uint64_t)(seconds * 1e6);
+  while (t < endUs)
+  {
+    t += passUs + rng.below(randUs + 1);
+    if (passUs + randUs == 0)
+      t += 1000; // a loop that takes no time still sees millis() step
+    out.nowUs = t;
+    keyer.update((uint32_t)(t / 1000), 0, 0, 0);
+  }
+
+  const EdgeJitter &j = out.jitter;
+  int32_t p = j.percentileUs((uint8_t)pct);
+  printf("%.1f WPM (unit %u ms), loop %.1f+%.1f+0..%.1f ms, %.0f s of \"%s\"\n", wpm, unitMs, loopMs, drawMs, randMs,
+         seconds, text);
+  printf("edges %u, early %u, min %d, mean %d, max %d us\n", j.count(), j.early(), j.minUs(), j.meanUs(), j.maxUs());
+  printf("p50 %d, p90 %d, p99 %d us\n", j.percentileUs(50), j.percentileUs(90), j.percentileUs(99));
+  if (verbose)
+  {
+    for (size_t i = 0; i < EDGE_JITTER_BINS; i++)
+      if (j.bin(i))
+        printf("  %6u-%6u us: %u\n", (unsigned)(i * j.binUs()), (unsigned)((i + 1) * j.binUs()), j.bin(i));
+    if (j.bin(EDGE_JITTER_BINS))
+      printf("  >=%6u us: %u\n", (unsigned)(EDGE_JITTER_BINS * j.binUs()), j.bin(EDGE_JITTER_BINS));
+  }
+  bool pass = p <= limitUs;
+  printf("p%d %d us, limit %ld us: %s\n", pct, p, limitUs, pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,322 @@
+// Host tool: replay recorded key edges through the firmware's keyer (keyer.h)
+// on a virtual clock and check that it commits exactly what the device did.
+// Input is anything carrying key-trace records: a `REC DUMP` capture, a
+// `TRACE ON` capture or a session log dump. Each trace stream (one per boot or
+// recording) replays from a fresh keyer. The clock jumps straight to the next
+// edge or keyer deadline, so hours of keying replay in milliseconds.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/keyer_replay.cpp -o keyer_replay
+// Usage: keyer_replay [options] capture.bin   (or "-" for stdin)
+//   -v         print the replayed events (tone edges, letters, gaps)
+//   -p MS      poll like the device loop every MS ms instead of jumping (edges due in
+//              a pass still apply at their recorded times, as on the device)
+//   -n REPS    replay each stream REPS times and report the speed (default 1)
+//   -E         no early commit (captures from firmware without it)
+//   -G         unknown codes commit '?' (captures from before nearest-match guessing)
+// Exits 1 if any stream's replayed commits differ from the recorded ones.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "session_log.h"
+#include "keyer.h"
+#include "key_recorder.h"
+#include "morse_literal.h"
+
+static void usage()
+{
+  fprintf(stderr, "usage: keyer_replay [-v] [-p ms] [-n reps] [-E] [-G] capture.bin\n");
+  exit(2);
+}
+
+struct Stream
+{
+  uint16_t unitMs = 0;
+  std::vector<TraceEvent> events; // absolute times
+};
+
+struct Commit
+{
+  char c;
+  uint8_t reason;
+};
+
+// Collects what the keyer does during a replay
+class ReplayListener : public KeyerListener
+{
+public:
+  bool verbose = false;
+  Keyer *keyer = nullptr;
+  uint32_t now = 0;
+  std::vector<Commit> commits;
+  std::string text;
+  uint32_t toneEdges = 0;
+
+  void onTone(bool on) override
+  {
+    toneEdges++;
+    if (verbose)
+      printf("%10u tone %s\n", now, on ? "on" : "off");
+  }
+  void onLetter(const char *pattern, char c, uint8_t reason) override
+  {
+    char label[6];
+    commits.push_back({c, reason});
+    text += morseCharLabel(c, label);
+    if (verbose)
+      printf("%10u LETTER %s -> %s\n", now, pattern, label);
+  }
+  void onSpace() override { text += ' '; }
+  void onWordFixed(const char *keyed, const char *fixed) override
+  {
+    if (verbose)
+      printf("%10u WORD %s -> %s\n", now, keyed, fixed);
+  }
+  void onWordErased(const char *word) override
+  {
+    if (verbose)
+      printf("%10u ERASE %s\n", now, word);
+  }
+  void onClear() override
+  {
+    text += " <CLEAR> ";
+    if (verbose)
+      printf("%10u CLEAR\n", now);
+  }
+  void onPlayStart(const char *, uint8_t source) override
+  {
+    if (verbose)
+      printf("%10u PLAY %u\n", now, source);
+  }
+  // Slot contents are not in the trace; any program keeps playback running
+  // until the next key-down, which is all the commit logic depends on
+  void onMemory(uint8_t, bool record, uint32_t t) override
+  {
+    static constexpr auto STAND_IN = MORSE_PROGRAM("PARIS");
+    if (!record)
+      keyer->startPlaybackStages(STAND_IN.data(), STAND_IN.size(), t, TRACE_PLAY_MEMORY);
+  }
+};
+
+// Split trace records into streams; a record led by a stream header starts one
+static void collectStreams(const std::vector<uint8_t> &buf, std::vector<Stream> &streams)
+{
+  if (buf.size() >= 4 && buf[0] == 'M' && buf[1] == 'K' && buf[2] == 'T')
+  {
+    // bare stream, e.g. a raw recorder buffer
+    Stream s;
+    TraceReader rd(buf.data(), buf.size());
+    if (rd.readHeader(s.unitMs))
+    {
+      TraceEvent ev;
+      while (rd.next(ev))
+        s.events.push_back(ev);
+      streams.push_back(s);
+      return;
+    }
+  }
+  size_t pos = 0;
+  TraceFollower follower;
+  while (pos < buf.size())
+  {
+    LogRecordView rec;
+    size_t used = 0;
+    LogParseResult r = logParseRecord(&buf[pos], buf.size() - pos, rec, used);
+    pos += used;
+    TraceReader rd(nullptr, 0);
+    bool started;
+    uint16_t unitMs;
+    if (r != LOG_PARSE_OK || !follower.open(rec, rd, started, unitMs))
+      continue;
+    if (started)
+    {
+      streams.emplace_back();
+      streams.back().unitMs = unitMs;
+    }
+    if (streams.empty())
+      continue; // continuation of a stream that started before the capture
+    TraceEvent ev;
+    while (rd.next(ev))
+      streams.back().events.push_back(ev);
+    follower.close(rd);
+  }
+}
+
+// Re-frame a stream as one contiguous recording, as the device recorder keeps it
+static std::vector<uint8_t> encodeStream(const Stream &s)
+{
+  std::vector<uint8_t> out(TRACE_HEADER_MAX + s.events.size() * TRACE_EVENT_MAX + TRACE_FLUSH_MAX);
+  size_t n = TraceWriter::header(out.data(), s.unitMs);
+  TraceWriter w;
+  w.reset(s.events.empty() ? 0 : s.events.front().timeMs);
+  for (const TraceEvent &ev : s.events)
+    n += w.event(out.data() + n, ev.timeMs, ev.type, ev.arg, ev.payload);
+  n += w.flush(out.data() + n);
+  out.resize(n);
+  return out;
+}
+
+// One replay; returns the simulated span in ms
+static uint32_t replay(const std::vector<uint8_t> &rec, uint32_t startMs, uint32_t endMs, uint32_t pollMs,
+                       Keyer &keyer, ReplayListener &out)
+{
+  KeyReplayer rp;
+  rp.begin(rec.data(), rec.size(), startMs);
+  keyer.reset(startMs);
+  uint32_t now = startMs;
+  for (;;)
+  {
+    uint32_t next = 0, deadline;
+    bool haveEdge = rp.nextTime(next);
+    if (pollMs)
+      next = now + pollMs;
+    else if (keyer.nextDeadline(deadline) && (!haveEdge || (int32_t)(deadline - next) < 0))
+      next = deadline;
+    else if (!haveEdge)
+      break;
+    if ((int32_t)(next - endMs) > 0 && !haveEdge)
+      break; // only playback left, past the end of the recording
+    now = next;
+    KeyEdges e;
+    if (pollMs)
+    {
+      // like the device's feedKeyer(): every edge due by this pass at its own time
+      uint32_t at;
+      while (rp.nextTime(at) && (int32_t)(at - now) <= 0)
+      {
+        out.now = at;
+        rp.poll(at, e);
+        keyer.update(at, e.ev[TRACE_KEY_DOT], e.ev[TRACE_KEY_DASH], e.ev[TRACE_KEY_OK]);
+      }
+      out.now = now;
+      keyer.update(now, 0, 0, 0);
+      continue;
+    }
+    out.now = now;
+    rp.poll(now, e);
+    keyer.update(now, e.ev[TRACE_KEY_DOT], e.ev[TRACE_KEY_DASH], e.ev[TRACE_KEY_OK]);
+  }
+  return now - startMs;
+}
+
+int main(int argc, char **argv)
+{
+  bool verbose = false;
+  bool earlyCommit = true;
+  bool guess = true;
+  uint32_t pollMs = 0;
+  int reps = 1;
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    bool hasVal = i + 1 < argc;
+    if (!strcmp(a, "-v"))
+      verbose = true;
+    else if (!strcmp(a, "-p") && hasVal)
+      pollMs = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(a, "-n") && hasVal)
+      reps = atoi(argv[++i]);
+    else if (!strcmp(a, "-E"))
+      earlyCommit = false;
+    else if (!strcmp(a, "-G"))
+      guess = false;
+    else if (a[0] == '-' && a[1] != '\0')
+      usage();
+    else
+      path = a;
+  }
+  if (!path || reps < 1)
+    usage();
+
+  FILE *in = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!in)
+  {
+    perror(path);
+    return 1;
+  }
+  std::vector<uint8_t> buf;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    buf.insert(buf.end(), chunk, chunk + got);
+  if (in != stdin)
+    fclose(in);
+
+  std::vector<Stream> streams;
+  collectStreams(buf, streams);
+  if (streams.empty())
+  {
+    fprintf(stderr, "no key trace found\n");
+    return 1;
+  }
+
+  bool allMatch = true;
+  for (size_t si = 0; si < streams.size(); si++)
+  {
+    const Stream &s = streams[si];
+    std::vector<Commit> expected;
+    size_t edges = 0;
+    for (const TraceEvent &ev : s.events)
+    {
+      if (ev.type == TRACE_COMMIT)
+        expected.push_back({(char)ev.payload, ev.arg});
+      else if (ev.type == TRACE_PRESS || ev.type == TRACE_RELEASE)
+        edges++;
+    }
+    if (edges == 0)
+      continue;
+    uint32_t startMs = s.events.front().timeMs;
+    uint32_t endMs = s.events.back().timeMs;
+    std::vector<uint8_t> rec = encodeStream(s);
+
+    KeyerTiming timing = keyerTimingForUnit(s.unitMs);
+    timing.earlyCommit = earlyCommit;
+    if (!guess)
+      timing.guessMinConfidence = 101;
+    Keyer keyer;
+    ReplayListener out;
+    out.keyer = &keyer;
+    keyer.configure(timing, &out);
+
+    out.verbose = verbose;
+    uint32_t spanMs = replay(rec, startMs, endMs, pollMs, keyer, out);
+    out.verbose = false;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 1; r < reps; r++)
+    {
+      ReplayListener again;
+      again.keyer = &keyer;
+      keyer.configure(timing, &again);
+      replay(rec, startMs, endMs, pollMs, keyer, again);
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    size_t mismatch = 0;
+    while (mismatch < expected.size() && mismatch < out.commits.size() &&
+           expected[mismatch].c == out.commits[mismatch].c && expected[mismatch].reason == out.commits[mismatch].reason)
+      mismatch++;
+    bool match = mismatch == expected.size() && mismatch == out.commits.size();
+    allMatch = allMatch && match;
+
+    printf("stream %zu: unit %u ms, %zu edges, %.1f s keyed, %zu commits (recorded %zu): %s\n", si + 1, s.unitMs,
+           edges, spanMs / 1000.0, out.commits.size(), expected.size(), match ? "match" : "MISMATCH");
+    if (!match)
+    {
+      char was[6], now[6];
+      printf("  first difference at commit %zu: recorded '%s' (%u), replayed '%s' (%u)\n", mismatch + 1,
+             morseCharLabel(mismatch < expected.size() ? expected[mismatch].c : '-', was),
+             mismatch < expected.size() ? expected[mismatch].reason : 0,
+             morseCharLabel(mismatch < out.commits.size() ? out.commits[mismatch].c : '-', now),
+             mismatch < out.commits.size() ? out.commits[mismatch].reason : 0);
+    }
+    printf("  text: %s\n", out.text.c_str());
+    if (reps > 1 && wallMs > 0)
+      printf("  %d replays in %.2f ms: %.0fx real time\n", reps - 1, wallMs, (reps - 1) * (double)spanMs / wallMs);
+  }
+  return allMatch ? 0 : 1;
+}
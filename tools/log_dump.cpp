@@ -0,0 +1,145 @@
+// Host tool: decode a session log captured from the serial `LOG` command (or
+// copied off the LittleFS image) into readable lines. Bytes that are not part
+// of a valid record, such as interleaved serial text, are skipped. The same
+// works for a `TRACE ON` serial capture: a header record, then trace chunks.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/log_dump.cpp -o log_dump
+// Usage: log_dump capture.bin   (or "-" for stdin)
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "morse_table.h"
+#include "session_log.h"
+
+static const char *keyName(uint8_t key)
+{
+  switch (key)
+  {
+  case TRACE_KEY_DOT:
+    return "DOT";
+  case TRACE_KEY_DASH:
+    return "DASH";
+  default:
+    return "OK";
+  }
+}
+
+static TraceFollower follower;
+static bool traceLost = false; // reported once per stream
+
+static void printTrace(const LogRecordView &rec)
+{
+  TraceReader rd(nullptr, 0);
+  bool started;
+  uint16_t unitMs;
+  if (!follower.open(rec, rd, started, unitMs))
+  {
+    if (!traceLost)
+      printf("           TRACE chunk missing before #%u, skipping to the next stream\n", rec.seq);
+    traceLost = true;
+    return;
+  }
+  traceLost = false;
+  if (started)
+    printf("%10u TRACE unit=%ums\n", rec.timeMs, unitMs);
+  TraceEvent ev;
+  while (rd.next(ev))
+  {
+    switch (ev.type)
+    {
+    case TRACE_PRESS:
+    case TRACE_RELEASE:
+      printf("%10u %c%s\n", ev.timeMs, ev.type == TRACE_PRESS ? '+' : '-', keyName(ev.arg));
+      break;
+    case TRACE_COMMIT:
+    {
+      char label[6];
+      printf("%10u COMMIT '%s' (%s)\n", ev.timeMs, morseCharLabel((char)ev.payload, label),
+             ev.arg == TRACE_COMMIT_OK           ? "ok"
+             : ev.arg == TRACE_COMMIT_GAP_LETTER ? "gap"
+             : ev.arg == TRACE_COMMIT_GAP_WORD   ? "word gap"
+                                                 : "complete");
+      break;
+    }
+    case TRACE_PLAY_START:
+      printf("%10u PLAY %s\n", ev.timeMs,
+             ev.arg == TRACE_PLAY_MEMORY   ? "memory"
+             : ev.arg == TRACE_PLAY_SERIAL ? "serial"
+             : ev.arg == TRACE_PLAY_BEACON ? "beacon"
+             : ev.arg == TRACE_PLAY_KOCH   ? "koch"
+             : ev.arg == TRACE_PLAY_ECHO   ? "echo"
+                                           : "text");
+      break;
+    default:
+      printf("%10u %s\n", ev.timeMs, traceTypeName(ev.type));
+      break;
+    }
+  }
+  if (rd.remaining())
+    printf("%10u TRACE truncated, %zu bytes left\n", rd.timeMs(), rd.remaining());
+  follower.close(rd);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: log_dump capture.bin\n");
+    return 2;
+  }
+  FILE *in = strcmp(argv[1], "-") ? fopen(argv[1], "rb") : stdin;
+  if (!in)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+  std::vector<uint8_t> buf;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    buf.insert(buf.end(), chunk, chunk + got);
+  if (in != stdin)
+    fclose(in);
+
+  size_t pos = 0, records = 0, skipped = 0;
+  while (pos < buf.size())
+  {
+    LogRecordView rec;
+    size_t used = 0;
+    LogParseResult r = logParseRecord(&buf[pos], buf.size() - pos, rec, used);
+    // The whole capture is in memory, so "need more" means a record cut short
+    // (e.g. power lost mid-write) or a stray magic byte: resync either way.
+    pos += used;
+    if (r != LOG_PARSE_OK)
+    {
+      skipped += used;
+      continue;
+    }
+    records++;
+    switch (rec.type)
+    {
+    case LOG_REC_BOOT:
+      printf("%10u BOOT\n", rec.timeMs);
+      break;
+    case LOG_REC_TEXT:
+    {
+      char label[6];
+      printf("%10u TEXT \"", rec.timeMs);
+      for (size_t i = 0; i < rec.len; i++)
+        fputs(morseCharLabel((char)rec.payload[i], label), stdout); // prosigns as "<SK>"
+      printf("\"\n");
+      break;
+    }
+    case LOG_REC_TRACE:
+    case LOG_REC_TRACE_MORE:
+      printTrace(rec);
+      break;
+    default:
+      printf("%10u type %u, %u bytes\n", rec.timeMs, rec.type, rec.len);
+      break;
+    }
+  }
+  fprintf(stderr, "%zu records, %zu bytes skipped\n", records, skipped);
+  return 0;
+}
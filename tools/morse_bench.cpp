@@ -0,0 +1,488 @@
+// Host tool: benchmark the firmware's hot paths on realistic corpora and
+// report ns/op and heap allocations/op, so changes to them can be compared
+// across commits. Covered: morseDecode(), morseNearest(), trie decoding on the
+// build's alphabet and through a runtime MorseCodec pointer, morseEncode(), the
+// dictionary lookup and correction (morse_dict.h), the two stage builders,
+// playback stage stepping (Keyer::startStageFromIndex() via update() at each
+// stage deadline), the playback position map, play queue preemption and
+// resume, the drawUI() frame composition (ui_frame.h), and the CW receiver's
+// Goertzel bank with its per-channel decoders (goertzel_bank.h) per bin count.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/morse_bench.cpp -o morse_bench
+// Usage: morse_bench [options]
+//   -j         JSON output (one object, one entry per benchmark)
+//   -t MS      minimum measuring time per benchmark (default 200)
+//   -s SEED    corpus seed (default 1)
+//   -f NAME    only run benchmarks whose name contains NAME
+//   -l LABEL   label stored in the JSON (e.g. the commit hash)
+// Corpora are generated from the seed, so runs with the same seed compare.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "alloc_count.h"
+#include "keyer.h"
+#include "play_queue.h"
+#include "morse_playmap.h"
+#include "koch_trainer.h"
+#include "echo_drill.h"
+#include "ui_frame.h"
+#include "goertzel_bank.h"
+#include "morse_render.h"
+#include "train_rng.h"
+
+static void usage()
+{
+  fprintf(stderr, "usage: morse_bench [-j] [-t ms] [-s seed] [-f name] [-l label]\n");
+  exit(2);
+}
+
+static TrainRng rng; // reproducible per seed
+
+static volatile uint32_t sink; // keeps results observable so nothing is optimised away
+
+// ================= Corpora =================
+static const char LETTERS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const char CHARSET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,?/=";
+// Six-element characters: the longest stage runs per character
+static const char PUNCT[] = ".,?'!)&:;-_\"@";
+
+struct Corpus
+{
+  std::vector<std::string> items;
+};
+
+// Words of 1..8 chars from set, single spaces, up to len chars
+static std::string randomText(const char *set, size_t setLen, size_t len)
+{
+  std::string s;
+  while (s.size() < len)
+  {
+    size_t word = 1 + rng.below(8);
+    for (size_t i = 0; i < word && s.size() < len; i++)
+      s += set[rng.below((uint32_t)setLen)];
+    if (s.size() < len)
+      s += ' ';
+  }
+  while (!s.empty() && s.back() == ' ')
+    s.pop_back();
+  return s;
+}
+
+static Corpus textCorpus(const char *set, size_t setLen, size_t len, size_t count)
+{
+  Corpus c;
+  for (size_t i = 0; i < count; i++)
+    c.items.push_back(randomText(set, setLen, len));
+  return c;
+}
+
+// Dictionary words; with `garble`, one letter each is swapped for another one
+// element away and marked as a zero-confidence guess, as the keyer would
+struct WordCorpus
+{
+  std::vector<std::string> words;
+  std::vector<std::vector<uint8_t>> confidence;
+};
+
+static WordCorpus wordCorpus(size_t count, bool garble)
+{
+  std::vector<std::string> dict;
+  std::string w;
+  for (const char *p = MORSE_DICT_WORDS;; p++)
+  {
+    if (*p && *p != ' ')
+      w += *p;
+    else if (!w.empty())
+    {
+      dict.push_back(w);
+      w.clear();
+    }
+    if (!*p)
+      break;
+  }
+  WordCorpus c;
+  while (c.words.size() < count)
+  {
+    std::string word = dict[rng.below((uint32_t)dict.size())];
+    std::vector<uint8_t> conf(word.size(), 100);
+    if (garble)
+    {
+      size_t at = rng.below((uint32_t)word.size());
+      std::string p = morseEncode(word[at]);
+      p[rng.below((uint32_t)p.size())] ^= '.' ^ '-';
+      char g = morseDecode(p.c_str());
+      if (g == '?' || morseDictLetterIndex(g) < 0)
+        continue;
+      word[at] = g;
+      conf[at] = 0;
+    }
+    c.words.push_back(word);
+    c.confidence.push_back(conf);
+  }
+  return c;
+}
+
+// Mostly table patterns, with a share of unknown ones (decoded as '?'),
+// which walk the whole table
+static Corpus patternCorpus(size_t count, uint32_t unknownPct)
+{
+  Corpus c;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (rng.below(100) < unknownPct)
+    {
+      std::string p;
+      size_t n = 1 + rng.below(7);
+      for (size_t k = 0; k < n; k++)
+        p += rng.below(2) ? '-' : '.';
+      c.items.push_back(p);
+    }
+    else
+      c.items.push_back(MORSE_TABLE[rng.below(MORSE_TABLE_LEN)].pattern);
+  }
+  return c;
+}
+
+// ================= drawUI() frame =================
+// uiCompose() (ui_frame.h) as drawUI() calls it; copying the lines to the
+// display buffer and the I2C transfer are not modelled
+static const uint16_t UNIT = 120;
+
+// Playback position as main.cpp keeps it: built at playback start, lines
+// re-cut only when the character being sent changes
+static MorsePlayMap<KEYER_TEXT_MAX + 8> playMap;
+static UiPlayLines playLines;
+
+static uint32_t frameChecksum(const UiFrame &f)
+{
+  uint32_t h = f.hiCol * 31u + f.hiLen;
+  for (size_t i = 0; i < UI_LINES; i++)
+    for (const char *p = f.line[i]; *p; p++)
+      h = h * 31 + (uint8_t)*p;
+  return h;
+}
+
+// Key a message into the keyer (letter gaps commit), leaving it in the text
+static void keyText(Keyer &keyer, const std::string &msg, uint32_t &t)
+{
+  for (char ch : msg)
+  {
+    if (ch == ' ')
+    {
+      t += 7 * UNIT;
+      continue;
+    }
+    for (const char *p = morseEncode(ch); *p; p++)
+    {
+      uint8_t key = *p == '.' ? TRACE_KEY_DOT : TRACE_KEY_DASH;
+      int8_t ev[3] = {0, 0, 0};
+      ev[key] = +1;
+      keyer.update(t, ev[0], ev[1], ev[2]);
+      t += *p == '.' ? UNIT : 3 * UNIT;
+      ev[key] = -1;
+      keyer.update(t, ev[0], ev[1], ev[2]);
+      t += UNIT;
+    }
+    t += 2 * UNIT;
+  }
+}
+
+// ================= Runner =================
+struct Result
+{
+  std::string name;
+  std::string corpus;
+  unsigned long long ops;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+static std::vector<Result> results;
+static double minTimeMs = 200;
+static const char *filter = nullptr;
+
+// fn(i) runs one operation on corpus item i and returns a value to sink.
+// Doubles the batch until one batch takes minTimeMs; that batch is reported.
+template <typename Fn>
+static void bench(const char *name, const char *corpus, size_t items, Fn fn)
+{
+  if (filter && !strstr(name, filter))
+    return;
+  uint32_t acc = 0;
+  for (size_t i = 0; i < items && i < 1000; i++) // warm-up
+    acc += fn(i);
+  unsigned long long batch = 64;
+  for (;;)
+  {
+    AllocStats a0 = allocStats();
+    auto t0 = std::chrono::steady_clock::now();
+    size_t idx = 0;
+    for (unsigned long long n = 0; n < batch; n++)
+    {
+      acc += fn(idx);
+      if (++idx == items)
+        idx = 0;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    AllocStats a1 = allocStats();
+    if (ns >= minTimeMs * 1e6 || batch >= (1ULL << 40))
+    {
+      results.push_back({name, corpus, batch, ns / batch, (double)(a1.count - a0.count) / batch,
+                         (double)(a1.bytes - a0.bytes) / batch});
+      break;
+    }
+    batch *= 2;
+  }
+  sink = acc;
+}
+
+int main(int argc, char **argv)
+{
+  bool json = false;
+  const char *label = "";
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    bool hasVal = i + 1 < argc;
+    if (!strcmp(a, "-j"))
+      json = true;
+    else if (!strcmp(a, "-t") && hasVal)
+      minTimeMs = atof(argv[++i]);
+    else if (!strcmp(a, "-s") && hasVal)
+      rng.seed((uint32_t)strtoul(argv[++i], nullptr, 10));
+    else if (!strcmp(a, "-f") && hasVal)
+      filter = argv[++i];
+    else if (!strcmp(a, "-l") && hasVal)
+      label = argv[++i];
+    else
+      usage();
+  }
+  if (minTimeMs <= 0)
+    usage();
+
+  // ---- corpora ----
+  const size_t N = 4096;
+  Corpus patterns = patternCorpus(N, 0);
+  Corpus patternsUnknown = patternCorpus(N, 30);
+  Corpus chars = textCorpus(CHARSET, sizeof(CHARSET) - 1, 1, N);
+  Corpus punctChars = textCorpus(PUNCT, sizeof(PUNCT) - 1, 1, N);
+  Corpus shortText = textCorpus(LETTERS, sizeof(LETTERS) - 1, 24, 256);
+  Corpus longText = textCorpus(CHARSET, sizeof(CHARSET) - 1, KEYER_TEXT_MAX, 256);
+  Corpus punctText = textCorpus(PUNCT, sizeof(PUNCT) - 1, KEYER_TEXT_MAX, 256);
+  WordCorpus dictWords = wordCorpus(N, false);
+  WordCorpus garbledWords = wordCorpus(N, true);
+  static char stageBuf[KEYER_TEXT_MAX * MORSE_STAGES_PER_CHAR + 1];
+
+  // ---- decode / encode ----
+  bench("decode", "table patterns", N, [&](size_t i) { return (uint32_t)morseDecode(patterns.items[i].c_str()); });
+  bench("decode", "30% unknown", N, [&](size_t i) { return (uint32_t)morseDecode(patternsUnknown.items[i].c_str()); });
+  bench("decode_nearest", "30% unknown", N,
+        [&](size_t i) { return (uint32_t)morseNearest(patternsUnknown.items[i].c_str()).ch; });
+  bench("decode_trie", "build alphabet", N, [&](size_t i) { return (uint32_t)morseTrieDecode(patterns.items[i].c_str()); });
+  const MorseCodec *volatile codecPtr = &morseCodec(MORSE_ALPHABET); // as swapped in at runtime
+  bench("decode_trie", "codec pointer", N, [&](size_t i) {
+    const MorseTrie &t = *codecPtr->trie;
+    MorseTrieNode node = MORSE_TRIE_ROOT;
+    for (const char *p = patterns.items[i].c_str(); *p && node; p++)
+      node = morseTrieNext(t, node, *p);
+    return (uint32_t)morseTrieChar(t, node);
+  });
+  bench("dict_lookup", "dictionary words", N, [&](size_t i) {
+    return (uint32_t)morseDictContains(dictWords.words[i].c_str(), dictWords.words[i].size());
+  });
+  bench("dict_correct", "one guessed letter", N, [&](size_t i) {
+    char fixed[MORSE_DICT_WORD_MAX + 1];
+    const std::string &w = garbledWords.words[i];
+    return (uint32_t)morseDictCorrect(w.c_str(), garbledWords.confidence[i].data(), w.size(), 4, fixed);
+  });
+  bench("encode", "letters, digits", N,
+        [&](size_t i) { return (uint32_t)morseEncode(chars.items[i][0])[0]; });
+  bench("encode", "punctuation", N,
+        [&](size_t i) { return (uint32_t)morseEncode(punctChars.items[i][0])[0]; });
+
+  // ---- stage builders ----
+  bench("stages_pattern", "table patterns", N, [&](size_t i) {
+    return (uint32_t)morseBuildStagesForPattern(patterns.items[i].c_str(), stageBuf, sizeof(stageBuf));
+  });
+  bench("stages_text", "24-char words", shortText.items.size(), [&](size_t i) {
+    return (uint32_t)morseBuildStagesFromText(shortText.items[i].c_str(), stageBuf, sizeof(stageBuf));
+  });
+  bench("stages_text", "120-char message", longText.items.size(), [&](size_t i) {
+    return (uint32_t)morseBuildStagesFromText(longText.items[i].c_str(), stageBuf, sizeof(stageBuf));
+  });
+  bench("stages_text", "120-char punctuation", punctText.items.size(), [&](size_t i) {
+    return (uint32_t)morseBuildStagesFromText(punctText.items[i].c_str(), stageBuf, sizeof(stageBuf));
+  });
+
+  // ---- playback: one op = one stage started at its deadline ----
+  {
+    static Keyer keyer;
+    keyer.configure(keyerTimingForUnit(UNIT), nullptr);
+    keyer.reset(0);
+    size_t len = morseBuildStagesFromText(longText.items[0].c_str(), stageBuf, sizeof(stageBuf));
+    keyer.startPlaybackStages(stageBuf, len, 0, TRACE_PLAY_TEXT);
+    bench("play_stage", "120-char message", 1, [&](size_t) {
+      uint32_t due = 0;
+      keyer.nextDeadline(due);
+      keyer.update(due, 0, 0, 0);
+      return (uint32_t)keyer.toneOn();
+    });
+  }
+
+  // ---- play map: built once per playback start, followed once per frame ----
+  {
+    size_t len = morseBuildStagesFromText(longText.items[0].c_str(), stageBuf, sizeof(stageBuf));
+    bench("play_map_build", "120-char message", 1, [&](size_t) {
+      playMap.build(stageBuf, len, MORSE_TRIE);
+      return (uint32_t)playMap.size();
+    });
+    size_t at = 0;
+    bench("play_map_follow", "120-char message", 1, [&](size_t) {
+      at = at + 1 < len ? at + 1 : 0; // one stage per frame, looping
+      return (uint32_t)playMap.follow(at);
+    });
+  }
+
+  // ---- Koch trainer: one op = draw a group and compile it for the queue ----
+  {
+    static KochTrainer koch;
+    koch.setLevel((uint8_t)KOCH_CHARS);
+    koch.start(1);
+    bench("koch_group", "all 41 characters", 1, [&](size_t) {
+      return (uint32_t)morseBuildStagesFromText(koch.nextGroup(), stageBuf, sizeof(stageBuf));
+    });
+  }
+
+  // ---- echo drill: one op = a weighted pick over all 41 characters and its
+  // single-character program ----
+  {
+    static EchoDrill echo;
+    echo.start(1, 0);
+    bench("echo_pick", "41 characters", 1, [&](size_t) {
+      char c = echo.next();
+      echo.played(0);
+      echo.keyDown(300);
+      echo.letter(c);
+      return (uint32_t)morseBuildStagesForPattern(morseEncode(c), stageBuf, sizeof(stageBuf));
+    });
+  }
+
+  // ---- play queue: one op = a memory message preempts the beacon at a letter
+  // boundary, is stopped, and the beacon resumes where it was ----
+  {
+    static Keyer keyer;
+    static PlayQueue<8> queue;
+    struct QueueListener : KeyerListener
+    {
+      void onPlayStop(uint8_t reason) override { queue.stopped(reason, keyer); }
+    };
+    static QueueListener listener;
+    static char beacon[512], memory[64];
+    keyer.configure(keyerTimingForUnit(UNIT), &listener);
+    keyer.reset(0);
+    size_t beaconLen = morseBuildStagesFromText(longText.items[0].c_str(), beacon, sizeof(beacon));
+    size_t memoryLen = morseBuildStagesFromText("CQ", memory, sizeof(memory));
+    uint32_t t = 0;
+    queue.push(beacon, beaconLen, PLAY_PRIO_BEACON, 0, TRACE_PLAY_BEACON);
+    queue.service(keyer, t, 0);
+    bench("play_queue", "preempt + resume", 1, [&](size_t) {
+      queue.push(memory, memoryLen, PLAY_PRIO_MEMORY, 0, TRACE_PLAY_MEMORY);
+      queue.service(keyer, t, 0); // beacon asked to yield
+      while (keyer.playing())     // ... and runs on to its letter boundary
+      {
+        keyer.nextDeadline(t);
+        keyer.update(t, 0, 0, 0);
+      }
+      queue.service(keyer, t, 0); // memory starts
+      queue.remove(memory, keyer);
+      queue.service(keyer, t, 0); // beacon resumes
+      return (uint32_t)keyer.playResumeIndex();
+    });
+  }
+
+  // ---- drawUI() frame: idle with a full text, Koch hint, while playing ----
+  {
+    static Keyer keyer;
+    static KochTrainer koch;
+    static UiFrame frame;
+    keyer.configure(keyerTimingForUnit(UNIT), nullptr);
+    keyer.reset(0);
+    koch.start(1);
+    uint32_t t = 1;
+    keyText(keyer, longText.items[1] + " " + longText.items[2], t); // past the cap: trimmed tail
+    UiContext ctx = {UNIT, false, false, nullptr, nullptr, &playLines};
+    bench("draw_ui", "idle, full text", 1, [&](size_t) {
+      uiCompose(frame, keyer, ctx);
+      return frameChecksum(frame);
+    });
+    UiContext kochCtx = {UNIT, false, false, &koch, nullptr, &playLines};
+    bench("draw_ui", "koch session", 1, [&](size_t) {
+      uiCompose(frame, keyer, kochCtx);
+      return frameChecksum(frame);
+    });
+    keyer.startPlayback(t);
+    playMap.build(keyer.playStages(), keyer.playLen(), MORSE_TRIE);
+    playLines.fresh = true;
+    bench("draw_ui", "playing", 1, [&](size_t) {
+      playLines.update(playMap, keyer.playIndex());
+      uiCompose(frame, keyer, ctx);
+      return frameChecksum(frame);
+    });
+  }
+
+  // ---- CW receiver: one op = one 128-sample block (16 ms at 8 kHz) through
+  // the bank and every channel's decoder; the firmware runs 16 bins ----
+  {
+    static const size_t RX_BLOCK = 128;
+    static MorseRenderer renderer;
+    static char stages[1024];
+    std::vector<float> audio;
+    size_t len = morseBuildStagesFromText("CQ CQ DE K1ABC K", stages, sizeof(stages));
+    renderer.configure(8000, 600.0f, 0.5f, 5.0f, morseTimingForUnit(60));
+    renderer.render(stages, len, 1, [&](const int16_t *pcm, size_t n) {
+      for (size_t i = 0; i < n; i++)
+        audio.push_back(pcm[i] * (1.0f / 32768.0f) + ((float)rng.below(1000) - 500.0f) * 1e-4f);
+    });
+    size_t blocks = audio.size() / RX_BLOCK;
+    static const size_t BIN_COUNTS[] = {8, 16, 32, 64};
+    static const char *const CORPUS[] = {"8 bins", "16 bins", "32 bins", "64 bins"};
+    static CwReceiver<64> rx;
+    uint32_t chars = 0;
+    rx.setSink([](uint8_t, char, void *ctx) { (*(uint32_t *)ctx)++; }, &chars);
+    for (size_t k = 0; k < 4; k++)
+    {
+      rx.configure(8000.0f, 400.0f, 1150.0f, BIN_COUNTS[k], RX_BLOCK, 20.0f);
+      bench("cw_rx_block", CORPUS[k], blocks, [&](size_t i) {
+        rx.feed(&audio[i * RX_BLOCK], RX_BLOCK);
+        return chars;
+      });
+    }
+  }
+
+  if (json)
+  {
+    printf("{\n  \"label\": \"%s\",\n  \"min_time_ms\": %.0f,\n  \"results\": [\n", label, minTimeMs);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      const Result &r = results[i];
+      printf("    {\"name\": \"%s\", \"corpus\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.2f, \"allocs_per_op\": %.4f, "
+             "\"bytes_per_op\": %.2f}%s\n",
+             r.name.c_str(), r.corpus.c_str(), r.ops, r.nsPerOp, r.allocsPerOp, r.bytesPerOp,
+             i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+  }
+  else
+  {
+    printf("%-16s %-22s %12s %10s %10s\n", "benchmark", "corpus", "ns/op", "allocs/op", "bytes/op");
+    for (const Result &r : results)
+      printf("%-16s %-22s %12.2f %10.4f %10.2f\n", r.name.c_str(), r.corpus.c_str(), r.nsPerOp, r.allocsPerOp,
+             r.bytesPerOp);
+  }
+  return 0;
+}
@@ -0,0 +1,337 @@
+// Host tool: drive the keyer over its serial protocol (serial_proto.h). Sends
+// one request frame, prints the reply, and with `watch` keeps printing the
+// subscribed event stream until interrupted. Serial text the firmware prints
+// in between (event lines, boot messages) is passed through to stderr.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/morse_ctl.cpp -o morse_ctl
+// Usage: morse_ctl [options] command [args]
+//   -p PORT    serial device (default /dev/ttyUSB0), 115200 8N1
+//   -t MS      reply timeout (default 1000)
+//   -w MS      wait this long after opening the port (boards that reset on open)
+//   -r PASSES  play: times to play the message, 0 = loop until stopped (default 1)
+//   -n         print the request frame in hex instead of sending it
+// Commands:
+//   ping | stats | stop | wpm N | pitch HZ | play TEXT...
+//   watch [chars] [keys] [play]   (default all three)
+//   echo                          echo drill latency per character, with histograms
+// Exits 1 on a timeout or a status other than OK.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include "morse_table.h"
+#include "serial_proto.h"
+#include "echo_drill.h"
+
+static void usage()
+{
+  fprintf(stderr, "usage: morse_ctl [-p port] [-t ms] [-w ms] [-r passes] [-n] "
+                  "ping|stats|stop|wpm N|pitch HZ|play TEXT...|watch [chars] [keys] [play]|echo\n");
+  exit(2);
+}
+
+static volatile sig_atomic_t interrupted = 0;
+static void onSignal(int) { interrupted = 1; }
+
+static uint32_t nowMs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000u + ts.tv_nsec / 1000000u);
+}
+
+static int openPort(const char *path)
+{
+  int fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+  {
+    perror(path);
+    exit(1);
+  }
+  termios tio;
+  if (tcgetattr(fd, &tio) != 0)
+  {
+    perror(path);
+    exit(1);
+  }
+  cfmakeraw(&tio);
+  cfsetispeed(&tio, B115200);
+  cfsetospeed(&tio, B115200);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 1; // read() returns after 100 ms of silence
+  tcsetattr(fd, TCSANOW, &tio);
+  return fd;
+}
+
+static const char *statusName(uint8_t s)
+{
+  static const char *const NAMES[] = {"OK", "UNKNOWN", "BAD_ARG", "FULL", "UNSUPPORTED"};
+  return s < sizeof(NAMES) / sizeof(NAMES[0]) ? NAMES[s] : "?";
+}
+
+static void printEvent(const uint8_t *p, size_t len)
+{
+  if (len < 7)
+    return;
+  uint32_t t = logGet32(p);
+  uint8_t type = p[4], arg = p[5];
+  static const char *const KEYS[] = {"DOT", "DASH", "OK"};
+  char label[6];
+  switch (type)
+  {
+  case TRACE_PRESS:
+  case TRACE_RELEASE:
+    printf("%10u %s %s\n", t, traceTypeName(type), arg < 3 ? KEYS[arg] : "?");
+    break;
+  case TRACE_COMMIT:
+    printf("%10u COMMIT '%s'\n", t, morseCharLabel((char)p[6], label));
+    break;
+  default:
+    printf("%10u %s\n", t, traceTypeName(type));
+    break;
+  }
+  fflush(stdout);
+}
+
+// Prints the tried characters of an ECHO reply; returns the index to ask for
+// next, or the total once everything has come
+static size_t printEcho(const uint8_t *p, size_t len)
+{
+  if (len < 2)
+    return 0;
+  size_t total = p[0], at = p[1];
+  if (at == 0)
+  {
+    printf("char  ok/tries  avg  min  max ms | latency bins from");
+    for (uint16_t edge : ECHO_BIN_MS)
+      printf(" %u", edge);
+    printf("\n");
+  }
+  char c, label[6];
+  EchoCharStats s;
+  for (size_t off = 2; echoDecodeStats(p + off, len - off, c, s); off += ECHO_RECORD_SIZE, at++)
+  {
+    if (s.tries == 0)
+      continue;
+    printf("%-5s %3u/%-5u %4u %4u %4u    |", morseCharLabel(c, label), s.correct, s.tries, s.avgMs, s.minMs,
+           s.maxMs);
+    for (uint16_t n : s.bins)
+      printf(" %u", n);
+    printf("\n");
+  }
+  return at < total ? at : total;
+}
+
+// Prints an ACK or STATS reply; true if it was OK
+static bool printReply(const ProtoReader &rd)
+{
+  const uint8_t *p = rd.payload();
+  size_t len = rd.payloadLen();
+  if (rd.type() == PROTO_STATS)
+  {
+    ProtoStats s;
+    if (!protoDecodeStats(p, len, s))
+      return false;
+    printf("uptime %u ms, unit %u ms (%u WPM), pitch %u Hz\n", s.uptimeMs, s.unitMs,
+           s.unitMs ? 1200u / s.unitMs : 0u, s.pitchHz);
+    printf("commits %u, key edges %u, %s, %u queued\n", s.commits, s.keyEdges, s.playing ? "playing" : "idle",
+           s.queued);
+    printf("frames ok %u, bad %u, dropped %u; free heap %u\n", s.framesOk, s.framesBad, s.framesDropped,
+           s.freeHeap);
+    return true;
+  }
+  if (rd.type() != PROTO_ACK || len < 3)
+    return false;
+  printf("%s (detail %u)\n", statusName(p[1]), p[2]);
+  return p[1] == PROTO_STATUS_OK;
+}
+
+int main(int argc, char **argv)
+{
+  const char *port = "/dev/ttyUSB0";
+  uint32_t timeoutMs = 1000, waitMs = 0;
+  uint8_t passes = 1;
+  bool dryRun = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:t:w:r:n")) != -1)
+  {
+    switch (opt)
+    {
+    case 'p':
+      port = optarg;
+      break;
+    case 't':
+      timeoutMs = (uint32_t)atoi(optarg);
+      break;
+    case 'w':
+      waitMs = (uint32_t)atoi(optarg);
+      break;
+    case 'r':
+      passes = (uint8_t)atoi(optarg);
+      break;
+    case 'n':
+      dryRun = true;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (optind >= argc)
+    usage();
+  const char *cmd = argv[optind++];
+  int nargs = argc - optind;
+  char **args = argv + optind;
+
+  uint8_t type, payload[PROTO_PAYLOAD_MAX];
+  size_t len = 0;
+  bool watch = false, echo = false;
+  if (!strcmp(cmd, "ping") && nargs == 0)
+    type = PROTO_PING;
+  else if (!strcmp(cmd, "stats") && nargs == 0)
+    type = PROTO_GET_STATS;
+  else if (!strcmp(cmd, "stop") && nargs == 0)
+    type = PROTO_STOP;
+  else if (!strcmp(cmd, "wpm") && nargs == 1)
+  {
+    type = PROTO_SET_WPM;
+    payload[len++] = (uint8_t)atoi(args[0]);
+  }
+  else if (!strcmp(cmd, "pitch") && nargs == 1)
+  {
+    type = PROTO_SET_PITCH;
+    logPut16(payload, (uint16_t)atoi(args[0]));
+    len = 2;
+  }
+  else if (!strcmp(cmd, "play") && nargs > 0)
+  {
+    type = PROTO_PLAY;
+    std::string text;
+    for (int i = 0; i < nargs; i++)
+      text += (i ? " " : "") + std::string(args[i]);
+    if (text.size() + 1 > PROTO_PAYLOAD_MAX)
+    {
+      fprintf(stderr, "morse_ctl: text longer than %zu bytes\n", PROTO_PAYLOAD_MAX - 1);
+      return 2;
+    }
+    payload[len++] = passes;
+    memcpy(payload + len, text.data(), text.size());
+    len += text.size();
+  }
+  else if (!strcmp(cmd, "watch"))
+  {
+    type = PROTO_SUBSCRIBE;
+    uint8_t mask = nargs ? 0 : PROTO_STREAM_CHARS | PROTO_STREAM_KEYS | PROTO_STREAM_PLAY;
+    for (int i = 0; i < nargs; i++)
+    {
+      if (!strcmp(args[i], "chars"))
+        mask |= PROTO_STREAM_CHARS;
+      else if (!strcmp(args[i], "keys"))
+        mask |= PROTO_STREAM_KEYS;
+      else if (!strcmp(args[i], "play"))
+        mask |= PROTO_STREAM_PLAY;
+      else
+        usage();
+    }
+    payload[len++] = mask;
+    watch = true;
+  }
+  else if (!strcmp(cmd, "echo") && nargs == 0)
+  {
+    type = PROTO_GET_ECHO;
+    payload[len++] = 0;
+    echo = true;
+  }
+  else
+    usage();
+
+  uint8_t seq = (uint8_t)(1 + nowMs() % 255);
+  uint8_t frame[PROTO_WIRE_MAX];
+  size_t n = protoEncodeFrame(type, seq, payload, len, frame);
+  if (dryRun)
+  {
+    for (size_t i = 0; i < n; i++)
+      printf("%02x%s", frame[i], i + 1 < n ? " " : "\n");
+    return 0;
+  }
+
+  int fd = openPort(port);
+  if (waitMs)
+    usleep(waitMs * 1000);
+  tcflush(fd, TCIFLUSH);
+  if (write(fd, frame, n) != (ssize_t)n)
+  {
+    perror(port);
+    return 1;
+  }
+  signal(SIGINT, onSignal);
+
+  ProtoReader rd;
+  bool replied = false, ok = false;
+  uint32_t start = nowMs();
+  while (!interrupted && (watch || !replied) && (replied || nowMs() - start < timeoutMs))
+  {
+    uint8_t buf[256];
+    ssize_t got = read(fd, buf, sizeof(buf));
+    if (got < 0 && errno != EINTR)
+    {
+      perror(port);
+      return 1;
+    }
+    for (ssize_t i = 0; i < got; i++)
+    {
+      ProtoFeed f = rd.feed(buf[i], nowMs());
+      if (f == PROTO_FEED_TEXT)
+        fputc(buf[i], stderr);
+      else if (f == PROTO_FEED_FRAME && rd.type() == PROTO_EVENT)
+        printEvent(rd.payload(), rd.payloadLen());
+      else if (f == PROTO_FEED_FRAME && rd.seq() == seq && !replied && echo && rd.type() == PROTO_ECHO)
+      {
+        // one page of characters per reply: ask for the next until done
+        size_t next = printEcho(rd.payload(), rd.payloadLen());
+        if (rd.payloadLen() < 2 || next >= rd.payload()[0] || next <= rd.payload()[1])
+        {
+          replied = true;
+          ok = next >= rd.payload()[0];
+          continue;
+        }
+        uint8_t first = (uint8_t)next;
+        seq = (uint8_t)(seq % 255 + 1);
+        n = protoEncodeFrame(PROTO_GET_ECHO, seq, &first, 1, frame);
+        if (write(fd, frame, n) != (ssize_t)n)
+        {
+          perror(port);
+          return 1;
+        }
+        start = nowMs();
+      }
+      else if (f == PROTO_FEED_FRAME && rd.seq() == seq && !replied)
+      {
+        replied = true;
+        ok = printReply(rd);
+      }
+    }
+  }
+  if (watch && replied)
+  {
+    // leave the device quiet for the next user of the port
+    const uint8_t none = 0;
+    n = protoEncodeFrame(PROTO_SUBSCRIBE, 0, &none, 1, frame);
+    if (write(fd, frame, n) != (ssize_t)n)
+      perror(port);
+  }
+  close(fd);
+  if (!replied)
+  {
+    fprintf(stderr, "morse_ctl: no reply\n");
+    return 1;
+  }
+  return ok ? 0 : 1;
+}
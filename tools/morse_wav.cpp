@@ -0,0 +1,142 @@
+// Host tool: render a message (or a raw stage program) to a WAV file using the
+// same stage builder and timing the firmware plays.
+//
+// Build: g++ -O2 -std=c++17 -Iinclude tools/morse_wav.cpp -o morse_wav
+// Usage: morse_wav [options] "TEXT"
+//   -o FILE    output WAV (default morse.wav, "-" = stdout)
+//   -i FILE    read message text from FILE instead of the argument
+//   -s         argument is a stage program ('.', '-', 'i', '|', '/'), not text
+//   -r RATE    sample rate in Hz (default 8000)
+//   -f HZ      pitch (default 700)
+//   -u MS      unit length in ms (default 120, the firmware default)
+//   -w WPM     unit from words per minute (1200 / WPM ms)
+//   -e MS      raised-cosine edge length (default 5, 0 = hard keying)
+//   -a AMP     amplitude 0..1 (default 0.8)
+//   -n LOOPS   repeat the message, separated by the loop gap (default 1)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+#include "morse_render.h"
+
+static void usage()
+{
+  fprintf(stderr, "usage: morse_wav [-o out.wav] [-i text.txt] [-s] [-r rate] [-f hz] [-u ms | -w wpm] [-e ms] [-a amp] [-n loops] [TEXT]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  const char *outPath = "morse.wav";
+  const char *inPath = nullptr;
+  bool rawStages = false;
+  uint32_t rate = 8000;
+  float pitch = 700.0f;
+  float unitMs = 120.0f;
+  float edgeMs = 5.0f;
+  float amp = 0.8f;
+  uint32_t loops = 1;
+  std::string text;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    bool hasVal = i + 1 < argc;
+    if (!strcmp(a, "-o") && hasVal)
+      outPath = argv[++i];
+    else if (!strcmp(a, "-i") && hasVal)
+      inPath = argv[++i];
+    else if (!strcmp(a, "-s"))
+      rawStages = true;
+    else if (!strcmp(a, "-r") && hasVal)
+      rate = (uint32_t)atoi(argv[++i]);
+    else if (!strcmp(a, "-f") && hasVal)
+      pitch = (float)atof(argv[++i]);
+    else if (!strcmp(a, "-u") && hasVal)
+      unitMs = (float)atof(argv[++i]);
+    else if (!strcmp(a, "-w") && hasVal)
+      unitMs = 1200.0f / (float)atof(argv[++i]);
+    else if (!strcmp(a, "-e") && hasVal)
+      edgeMs = (float)atof(argv[++i]);
+    else if (!strcmp(a, "-a") && hasVal)
+      amp = (float)atof(argv[++i]);
+    else if (!strcmp(a, "-n") && hasVal)
+      loops = (uint32_t)atoi(argv[++i]);
+    else if (a[0] == '-' && a[1] != '\0')
+      usage();
+    else
+    {
+      if (!text.empty())
+        text += ' ';
+      text += a;
+    }
+  }
+
+  if (inPath)
+  {
+    FILE *in = fopen(inPath, "rb");
+    if (!in)
+    {
+      perror(inPath);
+      return 1;
+    }
+    char buf[4096];
+    size_t got;
+    text.clear();
+    while ((got = fread(buf, 1, sizeof(buf), in)) > 0)
+      text.append(buf, got);
+    fclose(in);
+    for (char &c : text)
+      if (c == '\n' || c == '\r' || c == '\t')
+        c = ' ';
+  }
+  if (text.empty() || rate == 0 || unitMs < 1.0f || loops == 0)
+    usage();
+
+  std::string stages;
+  if (rawStages)
+    stages = text;
+  else
+  {
+    stages.resize(text.size() * MORSE_STAGES_PER_CHAR + 1);
+    stages.resize(morseBuildStagesFromText(text.c_str(), &stages[0], stages.size()));
+  }
+
+  FILE *out = strcmp(outPath, "-") ? fopen(outPath, "wb") : stdout;
+  if (!out)
+  {
+    perror(outPath);
+    return 1;
+  }
+  uint8_t hdr[44];
+  wavWriteHeader(hdr, rate, 0); // patched below once the length is known
+  fwrite(hdr, 1, sizeof(hdr), out);
+
+  static MorseRenderer renderer;
+  renderer.configure(rate, pitch, amp, edgeMs, morseTimingForUnit((uint16_t)(unitMs + 0.5f)));
+
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t samples = renderer.render(stages.data(), stages.size(), loops, [out](const int16_t *pcm, size_t n)
+                                     {
+    // WAV is little-endian; so is every host this tool targets
+    fwrite(pcm, sizeof(int16_t), n, out); });
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  uint64_t dataBytes = samples * 2;
+  if (dataBytes > 0xFFFFFFDBull)
+    fprintf(stderr, "warning: output exceeds the 4 GiB WAV limit\n");
+  if (out != stdout && fseek(out, 0, SEEK_SET) == 0)
+  {
+    wavWriteHeader(hdr, rate, (uint32_t)dataBytes);
+    fwrite(hdr, 1, sizeof(hdr), out);
+  }
+  if (out != stdout)
+    fclose(out);
+
+  double audioSecs = (double)samples / rate;
+  fprintf(stderr, "%zu stages, %.1f s audio, rendered in %.3f s (%.0fx realtime)\n",
+          stages.size(), audioSecs * 1.0, secs, secs > 0 ? audioSecs / secs : 0.0);
+  return 0;
+}